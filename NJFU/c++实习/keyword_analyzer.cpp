@@ -1,28 +1,1885 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <string_view>
 #include <map>
+#include <unordered_map>
 #include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <filesystem>
+#include <utility>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <cmath>
+#include <charconv>
 #include <ctime>
+#include <chrono>
 #include <sstream>
 #include <algorithm>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define KEYWORD_ANALYZER_X86 1
+#endif
 
 using namespace std;
 
+// õ C++ ֱ,  keywords.txt һ
+constexpr string_view builtinKeywords[] = {
+    "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor",
+    "bool", "break", "case", "catch", "char", "char8_t", "char16_t", "char32_t",
+    "class", "compl", "concept", "const", "consteval", "constexpr", "constinit", "const_cast",
+    "continue", "co_await", "co_return", "co_yield", "decltype", "default", "delete", "do",
+    "double", "dynamic_cast", "else", "enum", "explicit", "export", "extern", "false",
+    "float", "for", "friend", "goto", "if", "inline", "int", "long",
+    "mutable", "namespace", "new", "noexcept", "not", "not_eq", "nullptr", "operator",
+    "or", "or_eq", "private", "protected", "public", "reflexpr", "register", "reinterpret_cast",
+    "requires", "return", "short", "signed", "sizeof", "static", "static_assert", "static_cast",
+    "struct", "switch", "synchronized", "template", "this", "thread_local", "throw", "true",
+    "try", "typedef", "typeid", "typename", "union", "unsigned", "using", "virtual",
+    "void", "volatile", "wchar_t", "while", "xor", "xor_eq"
+};
+constexpr size_t BUILTIN_KEYWORD_NUM = sizeof(builtinKeywords) / sizeof(builtinKeywords[0]);
+
+// ñֵ/, ȲڷΧڵĵֱжΪǱ
+constexpr size_t keywordLengthBound(bool longest) {
+    size_t bound = builtinKeywords[0].size();
+    for (size_t i = 1; i < BUILTIN_KEYWORD_NUM; i++) {
+        size_t len = builtinKeywords[i].size();
+        if (longest ? len > bound : len < bound) bound = len;
+    }
+    return bound;
+}
+constexpr size_t KEYWORD_MIN_LEN = keywordLengthBound(false);
+constexpr size_t KEYWORD_MAX_LEN = keywordLengthBound(true);
+
+// ϣֻȡȡַмַĩַ, ر
+// (ñϻͬ), ӺȡλΪλ
+constexpr uint32_t keywordHash(string_view word, uint32_t seed) {
+    uint32_t key = (uint32_t)word.size()
+                 | (uint32_t)(unsigned char)word[0] << 8
+                 | (uint32_t)(unsigned char)word[word.size() / 2] << 16
+                 | (uint32_t)(unsigned char)word[word.size() - 1] << 24;
+    key ^= key >> 15;
+    key *= seed;
+    key ^= key >> 13;
+    return key * 0x9e3779b1u;
+}
+
+const int PERFECT_HASH_BITS = 10;
+const int PERFECT_HASH_SIZE = 1 << PERFECT_HASH_BITS;
+const uint8_t PERFECT_HASH_EMPTY = 0xff;
+
+struct PerfectHashTable {
+    uint32_t seed;
+    uint8_t slot[PERFECT_HASH_SIZE];  // λ -> builtinKeywords ±
+};
+
+// һʹñֻͻ
+constexpr PerfectHashTable buildPerfectHash() {
+    for (uint32_t attempt = 1; ; attempt++) {
+        uint32_t seed = (attempt * 2654435761u) | 1;
+        PerfectHashTable table{seed, {}};
+        for (int i = 0; i < PERFECT_HASH_SIZE; i++) {
+            table.slot[i] = PERFECT_HASH_EMPTY;
+        }
+        bool collision = false;
+        for (size_t i = 0; i < BUILTIN_KEYWORD_NUM && !collision; i++) {
+            uint32_t s = keywordHash(builtinKeywords[i], seed) >> (32 - PERFECT_HASH_BITS);
+            if (table.slot[s] != PERFECT_HASH_EMPTY) {
+                collision = true;
+            } else {
+                table.slot[s] = (uint8_t)i;
+            }
+        }
+        if (!collision) {
+            return table;
+        }
+    }
+}
+constexpr PerfectHashTable keywordPerfectHash = buildPerfectHash();
+static_assert(BUILTIN_KEYWORD_NUM < PERFECT_HASH_EMPTY, "too many builtin keywords");
+
+// ñֱв, ±, ʱ -1
+inline int findBuiltinKeyword(string_view word) {
+    if (word.size() < KEYWORD_MIN_LEN || word.size() > KEYWORD_MAX_LEN) {
+        return -1;
+    }
+    uint32_t s = keywordHash(word, keywordPerfectHash.seed) >> (32 - PERFECT_HASH_BITS);
+    int index = keywordPerfectHash.slot[s];
+    if (index == PERFECT_HASH_EMPTY || builtinKeywords[index] != word) {
+        return -1;
+    }
+    return index;
+}
+
+// ַ:  "C" locale µ isalnum(c) || c == '_' һ
+struct WordCharTable {
+    bool value[256];
+    constexpr WordCharTable() : value() {
+        for (int c = 0; c < 256; c++) {
+            value[c] = (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_';
+        }
+    }
+};
+constexpr WordCharTable wordChars;
+
+inline bool isWordChar(char c) {
+    return wordChars.value[(unsigned char)c];
+}
+
+// 64 ֽڿķ, ÿһλӦһֽ
+struct BlockMask {
+    uint64_t word;  // ַ
+    uint64_t newline;  // з
+};
+typedef BlockMask (*BlockScanner)(const char* block);
+
+// ֽڲʵ, ƽ̨
+inline BlockMask scanBlockScalar(const char* block) {
+    BlockMask mask = {0, 0};
+    for (int i = 0; i < 64; i++) {
+        mask.word |= (uint64_t)isWordChar(block[i]) << i;
+        mask.newline |= (uint64_t)(block[i] == '\n') << i;
+    }
+    return mask;
+}
+
+#ifdef KEYWORD_ANALYZER_X86
+// SSE4.2:  pcmpestrm Ƚһж 16 ֽǷ 0-9 A-Z a-z _ 
+__attribute__((target("sse4.2")))
+BlockMask scanBlockSse42(const char* block) {
+    const __m128i ranges = _mm_setr_epi8('0', '9', 'A', 'Z', 'a', 'z', '_', '_', 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i newline = _mm_set1_epi8('\n');
+    BlockMask mask = {0, 0};
+    for (int i = 0; i < 4; i++) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(block + 16 * i));
+        __m128i m = _mm_cmpestrm(ranges, 8, v, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_BIT_MASK);
+        mask.word |= (uint64_t)(uint16_t)_mm_cvtsi128_si32(m) << (16 * i);
+        mask.newline |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)) << (16 * i);
+    }
+    return mask;
+}
+
+// AVX2: һ 32 ֽ, ޷ж c - lo <= hi - lo
+__attribute__((target("avx2")))
+BlockMask scanBlockAvx2(const char* block) {
+    const __m256i digitLo = _mm256_set1_epi8('0'), digitSpan = _mm256_set1_epi8(9);
+    const __m256i alphaLo = _mm256_set1_epi8('a'), alphaSpan = _mm256_set1_epi8(25);
+    const __m256i lowerBit = _mm256_set1_epi8(0x20);
+    const __m256i underscore = _mm256_set1_epi8('_');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    BlockMask mask = {0, 0};
+    for (int i = 0; i < 2; i++) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(block + 32 * i));
+        __m256i digit = _mm256_sub_epi8(v, digitLo);
+        digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, digitSpan), digit);
+        __m256i alpha = _mm256_sub_epi8(_mm256_or_si256(v, lowerBit), alphaLo);
+        alpha = _mm256_cmpeq_epi8(_mm256_min_epu8(alpha, alphaSpan), alpha);
+        __m256i word = _mm256_or_si256(_mm256_or_si256(digit, alpha), _mm256_cmpeq_epi8(v, underscore));
+        mask.word |= (uint64_t)(uint32_t)_mm256_movemask_epi8(word) << (32 * i);
+        mask.newline |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline)) << (32 * i);
+    }
+    return mask;
+}
+#endif
+
+struct ScannerKernel {
+    const char* name;
+    BlockScanner scan;
+};
+
+// ǰ CPU õʵ, ԽԽ
+vector<ScannerKernel> availableScanners() {
+    vector<ScannerKernel> kernels;
+    kernels.push_back({"scalar", scanBlockScalar});
+#ifdef KEYWORD_ANALYZER_X86
+    if (__builtin_cpu_supports("sse4.2")) kernels.push_back({"sse4.2", scanBlockSse42});
+    if (__builtin_cpu_supports("avx2")) kernels.push_back({"avx2", scanBlockAvx2});
+#endif
+    return kernels;
+}
+
+// ʱѡһʵ
+inline BlockScanner bestScanner() {
+    static const BlockScanner best = availableScanners().back().scan;
+    return best;
+}
+
+// ȡ [begin, end) еĵʽ onWord, κζѷ, ( getline Ĵһ)
+// ÿη 64 ֽ, ʵֹλ/½صõ, ʿԿ
+template <typename F>
+int forEachWord(const char* begin, const char* end, F&& onWord, BlockScanner scanBlock = bestScanner()) {
+    int lines = 0;
+    const char* wordBegin = begin;
+    uint64_t carry = 0;  // һһֽǷǵַ
+    for (const char* base = begin; base < end; base += 64) {
+        BlockMask mask;
+        if (end - base >= 64) {
+            mask = scanBlock(base);
+        } else {
+            //  64 ֽڵĲֲ 0 (ǵַ)
+            char tail[64] = {0};
+            memcpy(tail, base, end - base);
+            mask = scanBlock(tail);
+        }
+        lines += __builtin_popcountll(mask.newline);
+
+        uint64_t previous = (mask.word << 1) | carry;
+        uint64_t starts = mask.word & ~previous;
+        uint64_t ends = ~mask.word & previous;
+        carry = mask.word >> 63;
+        for (uint64_t edges = starts | ends; edges != 0; edges &= edges - 1) {
+            int bit = __builtin_ctzll(edges);
+            if ((starts >> bit) & 1) {
+                wordBegin = base + bit;
+            } else {
+                onWord(string_view(wordBegin, base + bit - wordBegin));
+            }
+        }
+    }
+    if (carry) {
+        onWord(string_view(wordBegin, end - wordBegin));
+    }
+    if (begin < end && end[-1] != '\n') {
+        lines++;
+    }
+    return lines;
+}
+
+// ʷģʽеͳƵĸǺ
+struct LexerCounts {
+    long long comments = 0;  // ע
+    long long strings = 0;  // ַ(ԭʼַ)
+    long long chars = 0;  // ַ
+    long long numbers = 0;  // 
+    long long directives = 0;  // Ԥָ
+
+    void merge(const LexerCounts& other) {
+        comments += other.comments;
+        strings += other.strings;
+        chars += other.chars;
+        numbers += other.numbers;
+        directives += other.directives;
+    }
+};
+
+// ʷõַ
+enum LexCharClass : uint8_t {
+    LEX_OTHER, LEX_SPACE, LEX_NEWLINE, LEX_IDENT, LEX_DIGIT, LEX_DOT,
+    LEX_QUOTE, LEX_APOSTROPHE, LEX_SLASH, LEX_HASH, LEX_LESS, LEX_BACKSLASH
+};
+
+struct LexCharTable {
+    LexCharClass value[256];
+    constexpr LexCharTable() : value() {
+        for (int c = 0; c < 256; c++) {
+            LexCharClass cls = LEX_OTHER;
+            if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_') cls = LEX_IDENT;
+            else if (c >= '0' && c <= '9') cls = LEX_DIGIT;
+            else if (c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f') cls = LEX_SPACE;
+            else if (c == '\n') cls = LEX_NEWLINE;
+            else if (c == '.') cls = LEX_DOT;
+            else if (c == '"') cls = LEX_QUOTE;
+            else if (c == '\'') cls = LEX_APOSTROPHE;
+            else if (c == '/') cls = LEX_SLASH;
+            else if (c == '#') cls = LEX_HASH;
+            else if (c == '<') cls = LEX_LESS;
+            else if (c == '\\') cls = LEX_BACKSLASH;
+            value[c] = cls;
+        }
+    }
+};
+constexpr LexCharTable lexChars;
+
+// C++ ʷ: һɨ, עַ͡/ַ/ԭʼַ֡
+// Ԥָ#include ͷļ #error/#warning ı, ֻѴеıʶص.
+// ע͡ԭʼַе״̬ڶ, ԰бֶ߽
+class CppLexer {
+public:
+    enum State { CODE, LINE_COMMENT, BLOCK_COMMENT, STRING, CHAR, RAW_STRING, DIRECTIVE_TEXT };
+
+private:
+    enum DirectivePhase { NO_DIRECTIVE, DIRECTIVE_NAME, DIRECTIVE_HEADER };
+
+    State state;
+    DirectivePhase directive;
+    bool atLineStart;  // ǰеĿǰΪֹֻпհ, ʱ # ʼһԤָ
+    char rawDelimiter[16];  // ԭʼַ R"delim( ... )delim" ķָ
+    size_t rawDelimiterLength;
+
+    static bool isIdentChar(char c) {
+        LexCharClass cls = lexChars.value[(unsigned char)c];
+        return cls == LEX_IDENT || cls == LEX_DIGIT;
+    }
+
+    static int countNewlines(const char* begin, const char* end) {
+        return (int)std::count(begin, end, '\n');
+    }
+
+    // ַ/ַǰ׺ u8 u U L
+    static bool isEncodingPrefix(string_view word) {
+        return word == "u8" || word == "u" || word == "U" || word == "L";
+    }
+
+    // ԭʼַǰ׺ R u8R uR UR LR
+    static bool isRawPrefix(string_view word) {
+        return word == "R" || word == "u8R" || word == "uR" || word == "UR" || word == "LR";
+    }
+
+    // ȡԭʼַķָ, p ָͷ, ɹʱ '(' ֮λ
+    const char* beginRawString(const char* p, const char* end) {
+        const char* q = p + 1;
+        rawDelimiterLength = 0;
+        while (q < end && *q != '(' && rawDelimiterLength < sizeof(rawDelimiter)) {
+            char c = *q;
+            if (c == ' ' || c == ')' || c == '\\' || c == '\t' || c == '\n' || c == '"') {
+                return nullptr;
+            }
+            rawDelimiter[rawDelimiterLength++] = c;
+            q++;
+        }
+        if (q >= end || *q != '(') {
+            return nullptr;
+        }
+        state = RAW_STRING;
+        return q + 1;
+    }
+
+    // ûԶ׺( "abc"s, 'x'_c)ʶ
+    static const char* skipLiteralSuffix(const char* p, const char* end) {
+        if (p < end && lexChars.value[(unsigned char)*p] == LEX_IDENT) {
+            while (p < end && isIdentChar(*p)) p++;
+        }
+        return p;
+    }
+
+    // pp-number: ֻ . ͷ,  0x1F, 1e+5, 1'000, 12_km ʽ
+    static const char* skipNumber(const char* p, const char* end) {
+        p++;
+        while (p < end) {
+            char c = *p;
+            if (isIdentChar(c) || c == '.') {
+                if ((c == 'e' || c == 'E' || c == 'p' || c == 'P') && p + 1 < end && (p[1] == '+' || p[1] == '-')) {
+                    p++;
+                }
+                p++;
+            } else if (c == '\'' && p + 1 < end && isIdentChar(p[1])) {
+                p += 2;
+            } else {
+                break;
+            }
+        }
+        return p;
+    }
+
+public:
+    CppLexer() : state(CODE), directive(NO_DIRECTIVE), atLineStart(true), rawDelimiterLength(0) {}
+
+    State getState() const {
+        return state;
+    }
+
+    //  [begin, end), ʶ onWord, ( forEachWord Լһ)
+    template <typename F>
+    int lex(const char* begin, const char* end, LexerCounts& stats, F&& onWord) {
+        int lines = 0;
+        const char* p = begin;
+        while (p < end) {
+            switch (state) {
+            case BLOCK_COMMENT: {
+                const char* q = p;
+                while (true) {
+                    q = (const char*)memchr(q, '*', end - q);
+                    if (q == nullptr || q + 1 >= end) {
+                        lines += countNewlines(p, end);
+                        p = end;
+                        break;
+                    }
+                    if (q[1] == '/') {
+                        lines += countNewlines(p, q);
+                        p = q + 2;
+                        state = CODE;
+                        break;
+                    }
+                    q++;
+                }
+                break;
+            }
+            case LINE_COMMENT:
+            case DIRECTIVE_TEXT: {
+                // βн CODE ״̬, бʱעһ
+                const char* q = (const char*)memchr(p, '\n', end - p);
+                if (q == nullptr) {
+                    p = end;
+                    break;
+                }
+                const char* last = q > begin && q[-1] == '\r' ? q - 1 : q;
+                if (last > begin && last[-1] == '\\') {
+                    lines++;
+                    p = q + 1;
+                } else {
+                    p = q;
+                    state = CODE;
+                }
+                break;
+            }
+            case STRING:
+            case CHAR: {
+                char quote = state == STRING ? '"' : '\'';
+                while (p < end) {
+                    char c = *p;
+                    if (c == '\\') {
+                        if (p + 1 < end && p[1] == '\n') {
+                            lines++;
+                        } else if (p + 2 < end && p[1] == '\r' && p[2] == '\n') {
+                            lines++;
+                            p++;
+                        }
+                        p += 2;
+                    } else if (c == quote) {
+                        p = skipLiteralSuffix(p + 1, end);
+                        state = CODE;
+                        break;
+                    } else if (c == '\n') {
+                        state = CODE;  // δպϵβ
+                        break;
+                    } else {
+                        p++;
+                    }
+                }
+                if (p > end) p = end;
+                break;
+            }
+            case RAW_STRING: {
+                const char* q = p;
+                while (true) {
+                    q = (const char*)memchr(q, ')', end - q);
+                    if (q == nullptr) {
+                        lines += countNewlines(p, end);
+                        p = end;
+                        break;
+                    }
+                    if ((size_t)(end - q) > rawDelimiterLength + 1
+                        && memcmp(q + 1, rawDelimiter, rawDelimiterLength) == 0
+                        && q[1 + rawDelimiterLength] == '"') {
+                        lines += countNewlines(p, q);
+                        p = skipLiteralSuffix(q + 2 + rawDelimiterLength, end);
+                        state = CODE;
+                        break;
+                    }
+                    q++;
+                }
+                break;
+            }
+            case CODE:
+                while (p < end && state == CODE) {
+                    switch (lexChars.value[(unsigned char)*p]) {
+                    case LEX_SPACE:
+                        p++;
+                        break;
+                    case LEX_NEWLINE:
+                        lines++;
+                        atLineStart = true;
+                        directive = NO_DIRECTIVE;
+                        p++;
+                        break;
+                    case LEX_IDENT: {
+                        const char* wordBegin = p;
+                        while (p < end && isIdentChar(*p)) p++;
+                        string_view word(wordBegin, p - wordBegin);
+                        atLineStart = false;
+                        if (p < end && *p == '"' && isRawPrefix(word)) {
+                            const char* body = beginRawString(p, end);
+                            if (body != nullptr) {
+                                stats.strings++;
+                                p = body;
+                                break;
+                            }
+                        }
+                        if (p < end && (*p == '"' || *p == '\'') && isEncodingPrefix(word)) {
+                            break;  // ǰ׺
+                        }
+                        if (directive == DIRECTIVE_NAME) {
+                            directive = word == "include" || word == "include_next" || word == "import"
+                                ? DIRECTIVE_HEADER : NO_DIRECTIVE;
+                            if (word == "error" || word == "warning") {
+                                state = DIRECTIVE_TEXT;  // ı
+                            }
+                        } else {
+                            directive = NO_DIRECTIVE;
+                            onWord(word);
+                        }
+                        break;
+                    }
+                    case LEX_DIGIT:
+                        atLineStart = false;
+                        stats.numbers++;
+                        p = skipNumber(p, end);
+                        break;
+                    case LEX_DOT:
+                        atLineStart = false;
+                        if (p + 1 < end && lexChars.value[(unsigned char)p[1]] == LEX_DIGIT) {
+                            stats.numbers++;
+                            p = skipNumber(p, end);
+                        } else {
+                            p++;
+                        }
+                        break;
+                    case LEX_QUOTE:
+                        atLineStart = false;
+                        if (directive == DIRECTIVE_HEADER) {
+                            // #include "file.h" ͷļ
+                            const char* q = p + 1;
+                            while (q < end && *q != '"' && *q != '\n') q++;
+                            p = q < end && *q == '"' ? q + 1 : q;
+                            directive = NO_DIRECTIVE;
+                        } else {
+                            stats.strings++;
+                            state = STRING;
+                            p++;
+                        }
+                        break;
+                    case LEX_APOSTROPHE:
+                        atLineStart = false;
+                        stats.chars++;
+                        state = CHAR;
+                        p++;
+                        break;
+                    case LEX_SLASH:
+                        atLineStart = false;
+                        if (p + 1 < end && p[1] == '/') {
+                            stats.comments++;
+                            state = LINE_COMMENT;
+                            p += 2;
+                        } else if (p + 1 < end && p[1] == '*') {
+                            stats.comments++;
+                            state = BLOCK_COMMENT;
+                            p += 2;
+                        } else {
+                            p++;
+                        }
+                        break;
+                    case LEX_HASH:
+                        if (atLineStart) {
+                            stats.directives++;
+                            directive = DIRECTIVE_NAME;
+                        }
+                        atLineStart = false;
+                        p++;
+                        break;
+                    case LEX_LESS:
+                        atLineStart = false;
+                        if (directive == DIRECTIVE_HEADER) {
+                            // #include <file.h> ͷļ
+                            const char* q = p + 1;
+                            while (q < end && *q != '>' && *q != '\n') q++;
+                            p = q < end && *q == '>' ? q + 1 : q;
+                            directive = NO_DIRECTIVE;
+                        } else {
+                            p++;
+                        }
+                        break;
+                    case LEX_BACKSLASH:
+                        // б: Ԥָһ
+                        if (p + 1 < end && p[1] == '\n') {
+                            lines++;
+                            p += 2;
+                        } else if (p + 2 < end && p[1] == '\r' && p[2] == '\n') {
+                            lines++;
+                            p += 3;
+                        } else {
+                            atLineStart = false;
+                            p++;
+                        }
+                        break;
+                    default:
+                        atLineStart = false;
+                        p++;
+                        break;
+                    }
+                }
+                break;
+            }
+        }
+        if (begin < end && end[-1] != '\n') {
+            lines++;
+        }
+        return lines;
+    }
+};
+
+// ֻڴӳļ, ӳ󼴹رļ, ļͬʱӳҲľ
+class MappedFile {
+private:
+    char* addr;
+    size_t length;
+    bool mapped;
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+public:
+    // ֻӳͨļ, ܵ豸, ߰ȡ
+    explicit MappedFile(const string& filename) : addr(nullptr), length(0), mapped(false) {
+        struct stat st;
+        if (stat(filename.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+            return;
+        }
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        if (fstat(fd, &st) == 0) {
+            length = st.st_size;
+            if (length == 0) {
+                mapped = true;
+            } else {
+                void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED) {
+                    addr = (char*)p;
+                    mapped = true;
+                    madvise(addr, length, MADV_SEQUENTIAL);
+                } else {
+                    length = 0;
+                }
+            }
+        }
+        close(fd);
+    }
+
+    ~MappedFile() {
+        if (addr != nullptr) munmap(addr, length);
+    }
+
+    // ӳɹ(ļҲɹ)
+    bool isOpen() const {
+        return mapped;
+    }
+
+    const char* begin() const { return addr; }
+    const char* end() const { return addr + length; }
+    size_t size() const { return length; }
+};
+
+// ʹϣ: ÿζ 8 ֽ˷
+inline uint64_t hashWord(string_view word) {
+    const uint64_t m = 0x9e3779b97f4a7c15ull;
+    uint64_t h = word.size() * m;
+    size_t i = 0;
+    for (; i + 8 <= word.size(); i += 8) {
+        uint64_t v;
+        memcpy(&v, word.data() + i, 8);
+        h = (h ^ v) * m;
+        h ^= h >> 29;
+    }
+    if (i < word.size()) {
+        uint64_t v = 0;
+        memcpy(&v, word.data() + i, word.size() - i);
+        h = (h ^ v) * m;
+        h ^= h >> 29;
+    }
+    return h * m;
+}
+
+// ַڴ: ׷ӷ, ַƶҲͷ
+class StringArena {
+private:
+    static const size_t BLOCK_SIZE = 64 << 10;
+    vector<unique_ptr<char[]>> blocks;
+    char* current;
+    size_t remaining;
+    size_t allocated;
+
+public:
+    StringArena() : current(nullptr), remaining(0), allocated(0) {}
+
+    // һַ
+    string_view intern(string_view s) {
+        if (s.size() > remaining) {
+            size_t blockSize = max(BLOCK_SIZE, s.size());
+            blocks.emplace_back(new char[blockSize]);
+            current = blocks.back().get();
+            remaining = blockSize;
+            allocated += blockSize;
+        }
+        memcpy(current, s.data(), s.size());
+        string_view stored(current, s.size());
+        current += s.size();
+        remaining -= s.size();
+        return stored;
+    }
+
+    size_t memoryBytes() const {
+        return allocated;
+    }
+
+    // ͷȫַ
+    void clear() {
+        blocks.clear();
+        current = nullptr;
+        remaining = 0;
+        allocated = 0;
+    }
+};
+
+// ļеһ, error ֻǰ K ģʽ¿ܲΪ 0
+struct HistogramEntry {
+    string_view word;
+    long long count;
+    long long error;
+};
+
+// ʼ: Ŷַ + ̽, λ,  StringArena 
+// ֻʱһ
+class WordCounter {
+private:
+    struct Slot {
+        const char* key;  // Ϊձʾղ
+        uint32_t length;
+        uint32_t hashTag;  // ϣֵ 32 λ, Ƚַ֮ǰȱȽ
+        int count;
+    };
+    vector<Slot> slots;
+    size_t used;
+    StringArena arena;
+
+    void grow() {
+        vector<Slot> old(slots.size() * 2, Slot{nullptr, 0, 0, 0});
+        old.swap(slots);
+        size_t mask = slots.size() - 1;
+        for (size_t i = 0; i < old.size(); i++) {
+            if (old[i].key == nullptr) continue;
+            uint64_t h = hashWord(string_view(old[i].key, old[i].length));
+            size_t pos = h & mask;
+            while (slots[pos].key != nullptr) pos = (pos + 1) & mask;
+            slots[pos] = old[i];
+        }
+    }
+
+public:
+    WordCounter() : slots(1024, Slot{nullptr, 0, 0, 0}), used(0) {}
+
+    //  n, ֻеһγֵĵʲŻḴƵڴ
+    void add(string_view word, int n = 1) {
+        uint64_t h = hashWord(word);
+        uint32_t tag = (uint32_t)(h >> 32);
+        size_t mask = slots.size() - 1;
+        size_t pos = h & mask;
+        while (slots[pos].key != nullptr) {
+            Slot& slot = slots[pos];
+            if (slot.hashTag == tag && slot.length == word.size() && memcmp(slot.key, word.data(), word.size()) == 0) {
+                slot.count += n;
+                return;
+            }
+            pos = (pos + 1) & mask;
+        }
+        slots[pos] = Slot{arena.intern(word).data(), (uint32_t)word.size(), tag, n};
+        // װӳ 0.7 ʱ
+        if (++used * 10 > slots.size() * 7) {
+            grow();
+        }
+    }
+
+    // һűļӽ
+    void merge(const WordCounter& other) {
+        for (size_t i = 0; i < other.slots.size(); i++) {
+            if (other.slots[i].key != nullptr) {
+                add(string_view(other.slots[i].key, other.slots[i].length), other.slots[i].count);
+            }
+        }
+    }
+
+    size_t size() const {
+        return used;
+    }
+
+    // ˳ (, )
+    template <typename F>
+    void forEach(F&& f) const {
+        for (size_t i = 0; i < slots.size(); i++) {
+            if (slots[i].key != nullptr) {
+                f(string_view(slots[i].key, slots[i].length), slots[i].count);
+            }
+        }
+    }
+
+    // , ܴʱ˳
+    void clear() {
+        if (slots.size() > 4096) {
+            vector<Slot>(1024, Slot{nullptr, 0, 0, 0}).swap(slots);
+        } else {
+            fill(slots.begin(), slots.end(), Slot{nullptr, 0, 0, 0});
+        }
+        used = 0;
+        arena.clear();
+    }
+
+    // ֵźõȫ(ϲΪ 0 ĵʳ).
+    // Ȱǰ 8 ֽɵ, ǰ׺ͬűȽַ, 󲿷ֱȽϲ÷ڴ
+    vector<HistogramEntry> sorted() const {
+        struct Keyed {
+            uint64_t prefix;  // ƴɵǰ 8 ֽ, 㲹 0
+            uint32_t slot;
+        };
+        vector<Keyed> keyed;
+        keyed.reserve(used);
+        for (size_t i = 0; i < slots.size(); i++) {
+            if (slots[i].key != nullptr && slots[i].count != 0) {
+                uint64_t prefix = 0;
+                for (uint32_t k = 0; k < 8; k++) {
+                    prefix = (prefix << 8) | (k < slots[i].length ? (unsigned char)slots[i].key[k] : 0);
+                }
+                keyed.push_back(Keyed{prefix, (uint32_t)i});
+            }
+        }
+        sort(keyed.begin(), keyed.end(), [this](const Keyed& a, const Keyed& b) {
+            if (a.prefix != b.prefix) return a.prefix < b.prefix;
+            return string_view(slots[a.slot].key, slots[a.slot].length) < string_view(slots[b.slot].key, slots[b.slot].length);
+        });
+        vector<HistogramEntry> entries(keyed.size());
+        for (size_t i = 0; i < keyed.size(); i++) {
+            const Slot& slot = slots[keyed[i].slot];
+            entries[i] = HistogramEntry{string_view(slot.key, slot.length), slot.count, 0};
+        }
+        return entries;
+    }
+
+    size_t memoryBytes() const {
+        return slots.size() * sizeof(Slot) + arena.memoryBytes();
+    }
+};
+
+// Space-Saving 㷨н: ౣ capacity , ʱµʶСĵ,
+// ѱ浥ʵļµʵ. ÿʵĹֵСʵֵ, Ĳֲ  / capacity,
+//  capacity = 1 / epsilon ʱ epsilon * , ڴС޹
+class SpaceSaving {
+private:
+    struct Counter {
+        string word;
+        long long count;  // ֵ
+        long long error;  // ֵȥʵֵϽ
+        uint32_t slot;  //  index еλ
+    };
+    struct Slot {
+        int32_t counter;  // heap ±, -1 Ϊղ
+        uint32_t hashTag;  // ϣֵ 32 λ, Ƚַ֮ǰȱȽ
+    };
+    vector<Counter> heap;  //  count еС
+    vector<Slot> index;  // Ѱַϣ:  -> heap ±
+    size_t capacity;
+    long long total;  // ͳƵĵ
+
+    // ڵĲ, ʱӦĿղ
+    size_t findSlot(string_view word, uint64_t h) const {
+        uint32_t tag = (uint32_t)(h >> 32);
+        size_t mask = index.size() - 1;
+        size_t pos = h & mask;
+        while (index[pos].counter >= 0
+               && (index[pos].hashTag != tag || heap[index[pos].counter].word != word)) {
+            pos = (pos + 1) & mask;
+        }
+        return pos;
+    }
+
+    size_t findSlot(string_view word) const {
+        return findSlot(word, hashWord(word));
+    }
+
+    void place(size_t i, Counter&& counter) {
+        heap[i] = std::move(counter);
+        index[heap[i].slot].counter = (int32_t)i;
+    }
+
+    void siftUp(size_t i) {
+        Counter counter = std::move(heap[i]);
+        while (i > 0 && heap[(i - 1) / 2].count > counter.count) {
+            place(i, std::move(heap[(i - 1) / 2]));
+            i = (i - 1) / 2;
+        }
+        place(i, std::move(counter));
+    }
+
+    void siftDown(size_t i) {
+        // ǼӺԲӽڵ, ƶ
+        size_t first = i * 2 + 1;
+        if (first >= heap.size() || (heap[first].count >= heap[i].count
+                                     && (first + 1 >= heap.size() || heap[first + 1].count >= heap[i].count))) {
+            return;
+        }
+        Counter counter = std::move(heap[i]);
+        while (true) {
+            size_t child = i * 2 + 1;
+            if (child >= heap.size()) break;
+            if (child + 1 < heap.size() && heap[child + 1].count < heap[child].count) child++;
+            if (heap[child].count >= counter.count) break;
+            place(i, std::move(heap[child]));
+            i = child;
+        }
+        place(i, std::move(counter));
+    }
+
+    // ̽ɾ: Ѻͬһ̽ϵԪǰλ
+    void eraseSlot(size_t pos) {
+        size_t mask = index.size() - 1;
+        index[pos].counter = -1;
+        for (size_t next = (pos + 1) & mask; index[next].counter >= 0; next = (next + 1) & mask) {
+            size_t home = hashWord(heap[index[next].counter].word) & mask;
+            // home  (pos, next] ֮ʱ, ԪؿƵ pos
+            if (((next - home) & mask) >= ((next - pos) & mask)) {
+                index[pos] = index[next];
+                heap[index[pos].counter].slot = (uint32_t)pos;
+                index[next].counter = -1;
+                pos = next;
+            }
+        }
+    }
+
+    void rebuildIndex() {
+        fill(index.begin(), index.end(), Slot{-1, 0});
+        for (size_t i = 0; i < heap.size(); i++) {
+            uint64_t h = hashWord(heap[i].word);
+            size_t pos = findSlot(heap[i].word, h);
+            heap[i].slot = (uint32_t)pos;
+            index[pos] = Slot{(int32_t)i, (uint32_t)(h >> 32)};
+        }
+    }
+
+public:
+    explicit SpaceSaving(size_t n = 0) : capacity(0), total(0) {
+        setCapacity(n);
+    }
+
+    // , Ϊ 0 ʾʹ
+    void setCapacity(size_t n) {
+        capacity = n;
+        size_t slots = 16;
+        while (slots < capacity * 2) slots *= 2;
+        heap.clear();
+        heap.reserve(capacity);
+        index.assign(capacity > 0 ? slots : 0, Slot{-1, 0});
+        total = 0;
+    }
+
+    bool enabled() const {
+        return capacity > 0;
+    }
+
+    void clear() {
+        heap.clear();
+        fill(index.begin(), index.end(), Slot{-1, 0});
+        total = 0;
+    }
+
+    void add(string_view word, long long n = 1) {
+        total += n;
+        uint64_t h = hashWord(word);
+        size_t pos = findSlot(word, h);
+        if (index[pos].counter >= 0) {
+            size_t i = index[pos].counter;
+            heap[i].count += n;
+            siftDown(i);
+            return;
+        }
+        if (heap.size() < capacity) {
+            heap.push_back(Counter{string(word), n, 0, (uint32_t)pos});
+            index[pos] = Slot{(int32_t)(heap.size() - 1), (uint32_t)(h >> 32)};
+            siftUp(heap.size() - 1);
+            return;
+        }
+        // : Сĵ
+        eraseSlot(heap[0].slot);
+        pos = findSlot(word, h);
+        heap[0].word.assign(word.data(), word.size());
+        heap[0].error = heap[0].count;
+        heap[0].count += n;
+        heap[0].slot = (uint32_t)pos;
+        index[pos] = Slot{0, (uint32_t)(h >> 32)};
+        siftDown(0);
+    }
+
+    // ʱδ¼ĵʵܴﵽϽ, ҲйֵϽ
+    long long minCount() const {
+        return heap.size() < capacity || heap.empty() ? 0 : heap[0].count;
+    }
+
+    long long totalCount() const {
+        return total;
+    }
+
+    // ϲһű: һûм¼ĵʰ÷ minCount , ٱ capacity ,
+    // ϲԲ֮ / capacity
+    void merge(const SpaceSaving& other) {
+        if (other.total == 0) return;
+        long long minThis = minCount(), minOther = other.minCount();
+        vector<Counter> merged;
+        merged.reserve(heap.size() + other.heap.size());
+        // ȡֻڶԷеĵ, ֮󱾱ĵʻᱻ
+        for (size_t i = 0; i < other.heap.size(); i++) {
+            if (index.empty() || index[findSlot(other.heap[i].word)].counter < 0) {
+                const Counter& c = other.heap[i];
+                merged.push_back(Counter{c.word, c.count + minThis, c.error + minThis, 0});
+            }
+        }
+        for (size_t i = 0; i < heap.size(); i++) {
+            int32_t j = other.index.empty() ? -1 : other.index[other.findSlot(heap[i].word)].counter;
+            long long count = j >= 0 ? other.heap[j].count : minOther;
+            long long error = j >= 0 ? other.heap[j].error : minOther;
+            merged.push_back(Counter{std::move(heap[i].word), heap[i].count + count, heap[i].error + error, 0});
+        }
+        if (merged.size() > capacity) {
+            nth_element(merged.begin(), merged.begin() + capacity, merged.end(),
+                        [](const Counter& a, const Counter& b) { return a.count > b.count; });
+            merged.resize(capacity);
+        }
+        heap = std::move(merged);
+        make_heap(heap.begin(), heap.end(), [](const Counter& a, const Counter& b) { return a.count > b.count; });
+        rebuildIndex();
+        total += other.total;
+    }
+
+    //  k , ӴС, ֵͬ
+    vector<HistogramEntry> top(size_t k) const {
+        vector<HistogramEntry> entries;
+        for (size_t i = 0; i < heap.size(); i++) {
+            entries.push_back(HistogramEntry{heap[i].word, heap[i].count, heap[i].error});
+        }
+        sort(entries.begin(), entries.end(), [](const HistogramEntry& a, const HistogramEntry& b) {
+            return a.count != b.count ? a.count > b.count : a.word < b.word;
+        });
+        if (entries.size() > k) entries.resize(k);
+        return entries;
+    }
+
+    size_t memoryBytes() const {
+        size_t bytes = heap.capacity() * sizeof(Counter) + index.size() * sizeof(Slot);
+        for (size_t i = 0; i < heap.size(); i++) {
+            if (heap[i].word.capacity() > 15) bytes += heap[i].word.capacity() + 1;
+        }
+        return bytes;
+    }
+};
+
+// һ, зʱÿ̸߳һ, ϲ
+struct WordCounts {
+    vector<int> keywordCount;  // ּ, ± KeywordAnalyzer::keywords һ
+    WordCounter nonKeywordCount;  // Ǳּ
+    SpaceSaving topNonKeywords;  // ǰ K ģʽ´ nonKeywordCount н
+    int scanCount = 0;  // ɨ
+    LexerCounts lexerCounts;  // ʷģʽµעͺ
+
+    // ռ, ּΪ keywordNum  0
+    void clear(size_t keywordNum) {
+        keywordCount.assign(keywordNum, 0);
+        nonKeywordCount.clear();
+        topNonKeywords.clear();
+        scanCount = 0;
+        lexerCounts = LexerCounts();
+    }
+
+    void merge(const WordCounts& other) {
+        keywordCount.resize(max(keywordCount.size(), other.keywordCount.size()));
+        for (size_t i = 0; i < other.keywordCount.size(); i++) {
+            keywordCount[i] += other.keywordCount[i];
+        }
+        nonKeywordCount.merge(other.nonKeywordCount);
+        topNonKeywords.merge(other.topNonKeywords);
+        scanCount += other.scanCount;
+        lexerCounts.merge(other.lexerCounts);
+    }
+};
+
+// ȡ̳߳: ̵ֵ߳Ķ, ̴߳Լβȡ,
+// ԼĶпٴ̶߳еͷȡ
+class WorkStealingPool {
+private:
+    struct TaskQueue {
+        mutex lock;
+        deque<size_t> tasks;
+    };
+    vector<unique_ptr<TaskQueue>> queues;
+
+    bool popLocal(int worker, size_t& task) {
+        TaskQueue& q = *queues[worker];
+        lock_guard<mutex> guard(q.lock);
+        if (q.tasks.empty()) return false;
+        task = q.tasks.back();
+        q.tasks.pop_back();
+        return true;
+    }
+
+    bool steal(int worker, size_t& task) {
+        for (size_t i = 1; i < queues.size(); i++) {
+            TaskQueue& q = *queues[(worker + i) % queues.size()];
+            lock_guard<mutex> guard(q.lock);
+            if (!q.tasks.empty()) {
+                task = q.tasks.front();
+                q.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+public:
+    explicit WorkStealingPool(int threadNum) {
+        for (int i = 0; i < threadNum; i++) {
+            queues.emplace_back(new TaskQueue());
+        }
+    }
+
+    // ִбΪ 0..taskNum-1 , work(task, worker)  worker Ϊ̱߳
+    template <typename F>
+    void run(size_t taskNum, F&& work) {
+        for (size_t t = 0; t < taskNum; t++) {
+            queues[t % queues.size()]->tasks.push_back(t);
+        }
+        vector<thread> threads;
+        for (int w = 0; w < (int)queues.size(); w++) {
+            threads.emplace_back([this, &work, w]() {
+                size_t task;
+                while (popLocal(w, task) || steal(w, task)) {
+                    work(task, w);
+                }
+            });
+        }
+        for (size_t i = 0; i < threads.size(); i++) {
+            threads[i].join();
+        }
+    }
+};
+
+// Ŀ¼вԴļ׺
+const char* const SOURCE_EXTENSIONS[] = {".c", ".cc", ".cpp", ".cxx", ".c++", ".h", ".hh", ".hpp", ".hxx", ".inl", ".ipp", ".tcc"};
+
+// չ: ļԭ, Ŀ¼ݹ C/C++ Դļ(Ŀ¼), ֤˳ȶ
+vector<string> collectSourceFiles(const vector<string>& inputs) {
+    namespace fs = std::filesystem;
+    vector<string> files;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        error_code ec;
+        if (!fs::is_directory(inputs[i], ec)) {
+            files.push_back(inputs[i]);
+            continue;
+        }
+        vector<string> found;
+        fs::recursive_directory_iterator it(inputs[i], fs::directory_options::skip_permission_denied, ec), last;
+        for (; it != last; it.increment(ec)) {
+            string name = it->path().filename().string();
+            if (name.size() > 1 && name[0] == '.') {
+                if (it->is_directory(ec)) it.disable_recursion_pending();
+                continue;
+            }
+            if (!it->is_regular_file(ec)) continue;
+            string ext = it->path().extension().string();
+            for (size_t k = 0; k < sizeof(SOURCE_EXTENSIONS) / sizeof(SOURCE_EXTENSIONS[0]); k++) {
+                if (ext == SOURCE_EXTENSIONS[k]) {
+                    found.push_back(it->path().string());
+                    break;
+                }
+            }
+        }
+        sort(found.begin(), found.end());
+        files.insert(files.end(), found.begin(), found.end());
+    }
+    return files;
+}
+
+// зһ: ļ, ļԻнβһ
+struct ScanTask {
+    string path;
+    shared_ptr<MappedFile> file;  // пĴļɸ鹲ͬһӳ, Ϊʱɹ߳Լ
+    size_t begin, end;
+};
+
+const size_t CHUNK_SIZE = 16 << 20;  // ôСļп
+const size_t STREAM_CHUNK_SIZE = 1 << 20;  // ޷ӳÿζȡֽ
+
+// , ǰ, ڸ̸߳ؾ.
+// ʷģʽ¿ע͵״̬, ܴļм俪ʼ, ˲п
+vector<ScanTask> planScanTasks(const vector<string>& files, bool splitLargeFiles) {
+    vector<ScanTask> tasks;
+    for (size_t i = 0; i < files.size(); i++) {
+        struct stat st;
+        if (stat(files[i].c_str(), &st) != 0) {
+            cerr << "޷ļ: " << files[i] << endl;
+            continue;
+        }
+        if (!S_ISREG(st.st_mode) || (size_t)st.st_size <= CHUNK_SIZE || !splitLargeFiles) {
+            tasks.push_back({files[i], nullptr, 0, S_ISREG(st.st_mode) ? (size_t)st.st_size : 0});
+            continue;
+        }
+        shared_ptr<MappedFile> file = make_shared<MappedFile>(files[i]);
+        if (!file->isOpen()) {
+            // ӳʧʱп, ļΪһ, ɹ̰߳ȡ
+            tasks.push_back({files[i], nullptr, 0, (size_t)st.st_size});
+            continue;
+        }
+        size_t pos = 0;
+        while (pos < file->size()) {
+            size_t next = pos + CHUNK_SIZE;
+            if (next >= file->size()) {
+                next = file->size();
+            } else {
+                const char* newline = (const char*)memchr(file->begin() + next, '\n', file->size() - next);
+                next = newline != nullptr ? newline - file->begin() + 1 : file->size();
+            }
+            tasks.push_back({files[i], file, pos, next});
+            pos = next;
+        }
+    }
+    stable_sort(tasks.begin(), tasks.end(), [](const ScanTask& a, const ScanTask& b) {
+        return a.end - a.begin > b.end - b.begin;
+    });
+    return tasks;
+}
+
+// ļݹϣ: 4 ·е 8 ֽڳ˷, жļǷĶ
+inline uint64_t hashContent(const char* data, size_t size) {
+    const uint64_t m = 0x9e3779b97f4a7c15ull;
+    uint64_t lane[4] = {size, size ^ 0x243f6a8885a308d3ull, size ^ 0x13198a2e03707344ull, size ^ 0xa4093822299f31d0ull};
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        for (int k = 0; k < 4; k++) {
+            uint64_t v;
+            memcpy(&v, data + i + 8 * k, 8);
+            lane[k] = (lane[k] ^ v) * m;
+            lane[k] ^= lane[k] >> 31;
+        }
+    }
+    uint64_t h = lane[0] ^ (lane[1] * 3) ^ (lane[2] * 5) ^ (lane[3] * 7);
+    for (; i < size; i += 8) {
+        uint64_t v = 0;
+        memcpy(&v, data + i, min<size_t>(8, size - i));
+        h = (h ^ v) * m;
+        h ^= h >> 31;
+    }
+    return h * m;
+}
+
+// ļͷ, һηĻܼ¼(·Ϊ), ٺ recordNum ļ¼
+struct CacheFileHeader {
+    char magic[8];  // "KWCACHE"
+    uint32_t version;
+    uint32_t flags;  // CACHE_LEXER_MODE 
+    uint64_t keywordsHash;  // ֱĹϣ, ļĶʧЧ
+    uint32_t keywordNum;
+    uint32_t recordNum;
+};
+
+// ÿļһ¼, 8 ֽڶ, ֱӳڴ϶ȡ.
+// ¼ͷ֮ int32 ּ[keywordNum]·
+// identifierNum  {uint32 , uint32 , ַ}
+struct CacheRecordHeader {
+    uint32_t recordSize;  // ¼ֽ
+    uint32_t pathLength;
+    uint64_t fileSize;
+    int64_t mtime;  // ޸ʱ, 
+    uint64_t contentHash;
+    int64_t scanCount;
+    int64_t lexerCounts[5];
+    uint32_t keywordNum;
+    uint32_t identifierNum;
+};
+
+const char CACHE_MAGIC[8] = {'K', 'W', 'C', 'A', 'C', 'H', 'E', 0};
+const uint32_t CACHE_VERSION = 1;
+const uint32_t CACHE_LEXER_MODE = 1;
+
+inline int64_t modifyTimeNs(const struct stat& st) {
+    return (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+// : ·ÿļıֺͱʶֱͼ, ¼ļС޸ʱݹϣ.
+// С޸ʱ䶼ûʱֱʹû, ¼ݹϣ, ϣҲ˲·.
+// һһεĻܽ, ٴʱֻӻмȥĶļľֱͼֱͼ
+class AnalysisCache {
+private:
+    unique_ptr<MappedFile> file;
+    const char* totals;  // һεĻܼ¼
+    unordered_map<string_view, const char*> records;  // · -> ¼
+    CacheFileHeader expected;
+
+    static CacheRecordHeader readHeader(const char* record) {
+        CacheRecordHeader header;
+        memcpy(&header, record, sizeof(header));
+        return header;
+    }
+
+    //  p ļ¼Ƿ, ؼ¼, ʱ 0
+    size_t checkRecord(const char* p) const {
+        if ((size_t)(file->end() - p) < sizeof(CacheRecordHeader)) {
+            return 0;
+        }
+        CacheRecordHeader record = readHeader(p);
+        size_t pathOffset = sizeof(CacheRecordHeader) + record.keywordNum * sizeof(int32_t);
+        if (record.recordSize < pathOffset + record.pathLength || record.recordSize > (size_t)(file->end() - p)
+            || record.keywordNum != expected.keywordNum) {
+            return 0;
+        }
+        return record.recordSize;
+    }
+
+public:
+    AnalysisCache(uint64_t keywordsHash, uint32_t keywordNum, uint32_t flags) : totals(nullptr) {
+        memcpy(expected.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        expected.version = CACHE_VERSION;
+        expected.flags = flags;
+        expected.keywordsHash = keywordsHash;
+        expected.keywordNum = keywordNum;
+        expected.recordNum = 0;
+    }
+
+    // 뻺ļ, ļͷ뵱ǰֱģʽʱļ
+    void load(const string& path) {
+        file.reset(new MappedFile(path));
+        if (!file->isOpen() || file->size() < sizeof(CacheFileHeader)) {
+            return;
+        }
+        CacheFileHeader header;
+        memcpy(&header, file->begin(), sizeof(header));
+        if (memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.version != expected.version
+            || header.flags != expected.flags || header.keywordsHash != expected.keywordsHash
+            || header.keywordNum != expected.keywordNum) {
+            return;
+        }
+        const char* p = file->begin() + sizeof(CacheFileHeader);
+        size_t size = checkRecord(p);
+        if (size == 0) {
+            return;
+        }
+        totals = p;
+        p += size;
+        for (uint32_t i = 0; i < header.recordNum; i++) {
+            size = checkRecord(p);
+            if (size == 0) {
+                // ļ¼ʱܽҲ
+                totals = nullptr;
+                records.clear();
+                return;
+            }
+            CacheRecordHeader record = readHeader(p);
+            size_t pathOffset = sizeof(CacheRecordHeader) + record.keywordNum * sizeof(int32_t);
+            records[string_view(p + pathOffset, record.pathLength)] = p;
+            p += size;
+        }
+    }
+
+    // һεĻܽ, ЧʱΪ
+    const char* getTotals() const {
+        return totals;
+    }
+
+    // path һεļ¼, ûʱΪ
+    const char* find(const string& path) const {
+        auto it = records.find(path);
+        return it != records.end() ? it->second : nullptr;
+    }
+
+    // м¼·
+    vector<string_view> paths() const {
+        vector<string_view> result;
+        for (auto it = records.begin(); it != records.end(); ++it) {
+            result.push_back(it->first);
+        }
+        return result;
+    }
+
+    size_t size() const {
+        return records.size();
+    }
+
+    // ļǷδĶ, δĶʱѼ¼Ƶ out (޸ʱ).
+    // contentHash ΪʱֻȽϴС޸ʱ, һʱ߶ļݹϣжһ
+    static bool unchanged(const char* record, const struct stat& st, const uint64_t* contentHash, vector<char>& out) {
+        CacheRecordHeader header = readHeader(record);
+        if (header.fileSize != (uint64_t)st.st_size) {
+            return false;
+        }
+        if (contentHash == nullptr ? header.mtime != modifyTimeNs(st) : header.contentHash != *contentHash) {
+            return false;
+        }
+        out.assign(record, record + header.recordSize);
+        header.mtime = modifyTimeNs(st);
+        memcpy(out.data(), &header, sizeof(header));
+        return true;
+    }
+
+    // ѼлΪ¼, Ϊ 0 ıʶ
+    static vector<char> makeRecord(const string& path, uint64_t fileSize, int64_t mtime, uint64_t contentHash,
+                                   const WordCounts& counts) {
+        CacheRecordHeader header;
+        header.recordSize = 0;
+        header.pathLength = (uint32_t)path.size();
+        header.fileSize = fileSize;
+        header.mtime = mtime;
+        header.contentHash = contentHash;
+        header.scanCount = counts.scanCount;
+        header.lexerCounts[0] = counts.lexerCounts.comments;
+        header.lexerCounts[1] = counts.lexerCounts.strings;
+        header.lexerCounts[2] = counts.lexerCounts.chars;
+        header.lexerCounts[3] = counts.lexerCounts.numbers;
+        header.lexerCounts[4] = counts.lexerCounts.directives;
+        header.keywordNum = (uint32_t)counts.keywordCount.size();
+        header.identifierNum = 0;
+
+        vector<char> record(sizeof(header));
+        for (size_t i = 0; i < counts.keywordCount.size(); i++) {
+            int32_t count = counts.keywordCount[i];
+            record.insert(record.end(), (const char*)&count, (const char*)&count + sizeof(count));
+        }
+        record.insert(record.end(), path.begin(), path.end());
+        counts.nonKeywordCount.forEach([&record, &header](string_view word, int count) {
+            if (count == 0) return;
+            header.identifierNum++;
+            uint32_t entry[2] = {(uint32_t)count, (uint32_t)word.size()};
+            record.insert(record.end(), (const char*)entry, (const char*)entry + sizeof(entry));
+            record.insert(record.end(), word.begin(), word.end());
+        });
+        record.resize((record.size() + 7) & ~(size_t)7);
+        header.recordSize = (uint32_t)record.size();
+        memcpy(record.data(), &header, sizeof(header));
+        return record;
+    }
+
+    // Ѽ¼еļ sign (1  -1) ӵ counts 
+    static void mergeRecord(const char* record, WordCounts& counts, int sign = 1) {
+        CacheRecordHeader header = readHeader(record);
+        const char* p = record + sizeof(header);
+        counts.keywordCount.resize(max<size_t>(counts.keywordCount.size(), header.keywordNum));
+        for (uint32_t i = 0; i < header.keywordNum; i++, p += sizeof(int32_t)) {
+            int32_t count;
+            memcpy(&count, p, sizeof(count));
+            counts.keywordCount[i] += sign * count;
+        }
+        p += header.pathLength;
+        for (uint32_t i = 0; i < header.identifierNum; i++) {
+            uint32_t entry[2];
+            memcpy(entry, p, sizeof(entry));
+            counts.nonKeywordCount.add(string_view(p + sizeof(entry), entry[1]), sign * (int)entry[0]);
+            p += sizeof(entry) + entry[1];
+        }
+        counts.scanCount += sign * (int)header.scanCount;
+        counts.lexerCounts.comments += sign * header.lexerCounts[0];
+        counts.lexerCounts.strings += sign * header.lexerCounts[1];
+        counts.lexerCounts.chars += sign * header.lexerCounts[2];
+        counts.lexerCounts.numbers += sign * header.lexerCounts[3];
+        counts.lexerCounts.directives += sign * header.lexerCounts[4];
+    }
+
+    // дµĻļ: дʱļٸ, ;ʧܲƻɻ
+    void save(const string& path, const WordCounts& newTotals, const vector<vector<char>>& newRecords) {
+        CacheFileHeader header = expected;
+        for (size_t i = 0; i < newRecords.size(); i++) {
+            if (!newRecords[i].empty()) header.recordNum++;
+        }
+        vector<char> totalsRecord = makeRecord("", 0, 0, 0, newTotals);
+        string tempPath = path + ".tmp";
+        ofstream out(tempPath.c_str(), ios::binary);
+        out.write((const char*)&header, sizeof(header));
+        out.write(totalsRecord.data(), totalsRecord.size());
+        for (size_t i = 0; i < newRecords.size(); i++) {
+            out.write(newRecords[i].data(), newRecords[i].size());
+        }
+        out.close();
+        file.reset();
+        totals = nullptr;
+        records.clear();
+        if (!out || rename(tempPath.c_str(), path.c_str()) != 0) {
+            cerr << "޷д뻺ļ: " << path << endl;
+            remove(tempPath.c_str());
+        }
+    }
+};
+
+// ļʽ
+enum OutputFormat { FORMAT_TEXT, FORMAT_CSV, FORMAT_JSON, FORMAT_BINARY };
+
+// ȡʽ, ޷ʶʱ false
+bool parseOutputFormat(const string& name, OutputFormat& format) {
+    static const char* const names[] = {"text", "csv", "json", "binary"};
+    for (int i = 0; i < 4; i++) {
+        if (name == names[i]) {
+            format = (OutputFormat)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// ʽĬչ
+const char* outputExtension(OutputFormat format) {
+    static const char* const extensions[] = {".txt", ".csv", ".json", ".bin"};
+    return extensions[format];
+}
+
+// ֱͼļͷ,  entryNum  HistogramRecord, ٺеβӵַ.
+// ֶΰȻ, γֱ mmap 
+struct HistogramFileHeader {
+    char magic[8];  // "KWHIST"
+    uint32_t version;
+    uint32_t flags;  // HISTOGRAM_BY_COUNT: ӴС, 򰴵ֵ
+    uint64_t entryNum;
+    uint64_t stringBytes;
+};
+
+struct HistogramRecord {
+    uint32_t offset;  // ַеƫ
+    uint32_t length;
+    int64_t count;
+    int64_t error;
+};
+
+const uint32_t HISTOGRAM_VERSION = 1;
+const uint32_t HISTOGRAM_BY_COUNT = 1;
+
+// : ȸʽ 1 MB Ļ, ˲ŵһ write
+class BufferedWriter {
+private:
+    int fd;
+    vector<char> buffer;
+    size_t used;
+    bool failed;
+
+public:
+    explicit BufferedWriter(const string& path) : buffer(1 << 20), used(0), failed(false) {
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        failed = fd < 0;
+    }
+
+    ~BufferedWriter() {
+        close();
+    }
+
+    void write(const char* data, size_t size) {
+        if (used + size > buffer.size()) {
+            flush();
+            if (size > buffer.size()) {
+                writeAll(data, size);
+                return;
+            }
+        }
+        memcpy(buffer.data() + used, data, size);
+        used += size;
+    }
+
+    void write(string_view text) {
+        write(text.data(), text.size());
+    }
+
+    // ֱӸʽ
+    void writeInt(long long value) {
+        if (used + 24 > buffer.size()) flush();
+        used = std::to_chars(buffer.data() + used, buffer.data() + buffer.size(), value).ptr - buffer.data();
+    }
+
+    void flush() {
+        writeAll(buffer.data(), used);
+        used = 0;
+    }
+
+    // дʣݲر, Ƿȫдɹ
+    bool close() {
+        if (fd >= 0) {
+            flush();
+            failed |= ::close(fd) != 0;
+            fd = -1;
+        }
+        return !failed;
+    }
+
+private:
+    void writeAll(const char* data, size_t size) {
+        while (size > 0 && !failed) {
+            ssize_t n = ::write(fd, data, size);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                failed = true;
+                break;
+            }
+            data += n;
+            size -= n;
+        }
+    }
+};
+
+// ָʽдһֱͼ. ıʽһ title, ÿ ": ";
+// ֻĸֺ», CSV  JSON Ҫת
+bool writeHistogram(const string& path, OutputFormat format, string_view title,
+                    const vector<HistogramEntry>& entries, bool byCount) {
+    BufferedWriter out(path);
+    switch (format) {
+    case FORMAT_TEXT:
+        out.write(title);
+        out.write("\n");
+        for (size_t i = 0; i < entries.size(); i++) {
+            out.write(entries[i].word);
+            out.write(": ");
+            out.writeInt(entries[i].count);
+            if (entries[i].error > 0) {
+                out.write(" ( <= ");
+                out.writeInt(entries[i].error);
+                out.write(")");
+            }
+            out.write("\n");
+        }
+        break;
+    case FORMAT_CSV:
+        out.write(byCount ? "word,count,error\n" : "word,count\n");
+        for (size_t i = 0; i < entries.size(); i++) {
+            out.write(entries[i].word);
+            out.write(",");
+            out.writeInt(entries[i].count);
+            if (byCount) {
+                out.write(",");
+                out.writeInt(entries[i].error);
+            }
+            out.write("\n");
+        }
+        break;
+    case FORMAT_JSON:
+        out.write("[");
+        for (size_t i = 0; i < entries.size(); i++) {
+            out.write(i == 0 ? "\n{\"word\":\"" : ",\n{\"word\":\"");
+            out.write(entries[i].word);
+            out.write("\",\"count\":");
+            out.writeInt(entries[i].count);
+            if (byCount) {
+                out.write(",\"error\":");
+                out.writeInt(entries[i].error);
+            }
+            out.write("}");
+        }
+        out.write("\n]\n");
+        break;
+    case FORMAT_BINARY: {
+        HistogramFileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "KWHIST", 6);
+        header.version = HISTOGRAM_VERSION;
+        header.flags = byCount ? HISTOGRAM_BY_COUNT : 0;
+        header.entryNum = entries.size();
+        for (size_t i = 0; i < entries.size(); i++) {
+            header.stringBytes += entries[i].word.size();
+        }
+        out.write((const char*)&header, sizeof(header));
+        uint32_t offset = 0;
+        for (size_t i = 0; i < entries.size(); i++) {
+            HistogramRecord record = {offset, (uint32_t)entries[i].word.size(), entries[i].count, entries[i].error};
+            out.write((const char*)&record, sizeof(record));
+            offset += record.length;
+        }
+        for (size_t i = 0; i < entries.size(); i++) {
+            out.write(entries[i].word);
+        }
+        break;
+    }
+    }
+    return out.close();
+}
+
+// İٷλ(ȷ)
+double percentile(const vector<double>& sorted, double q) {
+    if (sorted.empty()) return 0;
+    size_t rank = (size_t)ceil(q * sorted.size());
+    return sorted[min(sorted.size(), max<size_t>(rank, 1)) - 1];
+}
+
 class KeywordAnalyzer {
 private:
     vector<string> keywords;  // 汣
-    map<string, int> keywordCount;  // ּ
-    map<string, int> nonKeywordCount;  // Ǳּ
-    int scanCount;  // ɨ
+    WordCounts counts;  // 
+    bool lexerMode;  // ʷģʽ: ͳעͺеĵ
+    string cachePath;  // ļ, Ϊʱʹû
+    size_t cacheHits;  // һηֱʹûļ
+    size_t topK;  //  0 ʱִֻ topK Ǳ, ڴн
+    size_t topCapacity;  // ǰ K ģʽ¼
+    OutputFormat outputFormat;  // ļʽ
+    string keywordOutput;  // ֽļ, ΪʱʽȡĬļ
+    string nonKeywordOutput;  // Ǳֽļ
+    bool useBuiltinTable;  // ļñһʱʹñϣ
+    int builtinToKeyword[BUILTIN_KEYWORD_NUM];  // ñ± -> keywords ±
+    unordered_map<string_view, int> keywordIndex;  // Զ屣ļʱڽĹϣ
+
+    // ұ,  keywords еһγֵ±, Ǳʱ -1
+    int keywordId(string_view word) const {
+        if (useBuiltinTable) {
+            int index = findBuiltinKeyword(word);
+            return index >= 0 ? builtinToKeyword[index] : -1;
+        }
+        auto it = keywordIndex.find(word);
+        return it != keywordIndex.end() ? it->second : -1;
+    }
 
     // жַǷΪ
-    bool isKeyword(const string& word) {
-        return find(keywords.begin(), keywords.end(), word) != keywords.end();
+    bool isKeyword(string_view word) const {
+        return keywordId(word) >= 0;
+    }
+
+    // Ѽصıѡҷʽ
+    void buildKeywordIndex() {
+        keywordIndex.clear();
+        for (size_t i = 0; i < keywords.size(); i++) {
+            keywordIndex.emplace(keywords[i], (int)i);
+        }
+        useBuiltinTable = keywordIndex.size() == BUILTIN_KEYWORD_NUM;
+        for (auto it = keywordIndex.begin(); it != keywordIndex.end() && useBuiltinTable; ++it) {
+            int index = findBuiltinKeyword(it->first);
+            useBuiltinTable = index >= 0;
+            if (useBuiltinTable) builtinToKeyword[index] = it->second;
+        }
+    }
+
+    // ͳһ
+    void addWord(WordCounts& target, string_view word) const {
+        int id = keywordId(word);
+        if (id >= 0) {
+            target.keywordCount[id]++;
+        } else if (topK > 0) {
+            target.topNonKeywords.add(word);
+        } else {
+            target.nonKeywordCount.add(word);
+        }
+    }
+
+    // ͳһڴеĵ
+    void countBuffer(WordCounts& target, const char* begin, const char* end) const {
+        auto onWord = [this, &target](string_view word) {
+            addWord(target, word);
+        };
+        if (lexerMode) {
+            CppLexer lexer;
+            target.scanCount += lexer.lex(begin, end, target.lexerCounts, onWord);
+        } else {
+            target.scanCount += forEachWord(begin, end, onWord);
+        }
+    }
+
+    // ֿȡ޷ӳ(ܵ׼). ÿصһΪֹ, ʣµİһ,
+    // ʷ״̬ڿ֮, ˽ļһηͬ. ڴֻȡڿСһ
+    void countStream(WordCounts& target, int fd) const {
+        vector<char> buffer(STREAM_CHUNK_SIZE);
+        size_t pending = 0;  // ͷһ
+        CppLexer lexer;
+        auto onWord = [this, &target](string_view word) {
+            addWord(target, word);
+        };
+        auto countLines = [&](const char* begin, const char* end) {
+            if (lexerMode) {
+                target.scanCount += lexer.lex(begin, end, target.lexerCounts, onWord);
+            } else {
+                target.scanCount += forEachWord(begin, end, onWord);
+            }
+        };
+        while (true) {
+            if (pending == buffer.size()) {
+                buffer.resize(buffer.size() * 2);  // һбȻ
+            }
+            ssize_t n = read(fd, buffer.data() + pending, buffer.size() - pending);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            char* begin = buffer.data();
+            char* filled = begin + pending + n;
+            char* lineEnd = filled;
+            while (lineEnd > begin + pending && lineEnd[-1] != '\n') lineEnd--;
+            if (lineEnd == begin + pending) {
+                pending += n;
+                continue;
+            }
+            countLines(begin, lineEnd);
+            pending = filled - lineEnd;
+            memmove(begin, lineEnd, pending);
+        }
+        countLines(buffer.data(), buffer.data() + pending);
+    }
+
+    // ͳ޷ӳļ, "-" ʾ׼
+    void countUnmapped(WordCounts& target, const string& filename) const {
+        if (filename == "-") {
+            countStream(target, STDIN_FILENO);
+            return;
+        }
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd >= 0) {
+            countStream(target, fd);
+            close(fd);
+        }
+    }
+
+    // ִһ
+    void runTask(const ScanTask& task, WordCounts& target) const {
+        if (task.file != nullptr) {
+            countBuffer(target, task.file->begin() + task.begin, task.file->begin() + task.end);
+            return;
+        }
+        MappedFile mapped(task.path);
+        if (mapped.isOpen()) {
+            countBuffer(target, mapped.begin(), mapped.end());
+        } else {
+            countUnmapped(target, task.path);
+        }
+    }
+
+    // ִһļ. һεĻʱ target ֻۼƱ仯:
+    // δĶļʲô, Ķļȥֱͼֱͼ; ûлʱۼȫֱͼ.
+    // ܵȷͨļ޷ӳļûм¼,  uncached, 뱣Ļ, ÿжͳ
+    void runCachedTask(const ScanTask& task, const AnalysisCache& cache, vector<char>& record,
+                       WordCounts& scratch, WordCounts& target, WordCounts& uncached, size_t& hits) const {
+        struct stat st;
+        const char* old = cache.find(task.path);
+        bool haveTotals = cache.getTotals() != nullptr;
+        if (stat(task.path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+            if (old != nullptr && haveTotals) AnalysisCache::mergeRecord(old, target, -1);
+            runTask(task, uncached);
+            return;
+        }
+        if (old != nullptr && AnalysisCache::unchanged(old, st, nullptr, record)) {
+            if (!haveTotals) AnalysisCache::mergeRecord(old, target);
+            hits++;
+            return;
+        }
+        MappedFile mapped(task.path);
+        if (!mapped.isOpen()) {
+            if (old != nullptr && haveTotals) AnalysisCache::mergeRecord(old, target, -1);
+            runTask(task, uncached);
+            return;
+        }
+        uint64_t contentHash = hashContent(mapped.begin(), mapped.size());
+        if (old != nullptr && AnalysisCache::unchanged(old, st, &contentHash, record)) {
+            if (!haveTotals) AnalysisCache::mergeRecord(old, target);
+            hits++;
+            return;
+        }
+        scratch.clear(keywords.size());
+        countBuffer(scratch, mapped.begin(), mapped.end());
+        record = AnalysisCache::makeRecord(task.path, st.st_size, modifyTimeNs(st), contentHash, scratch);
+        target.merge(scratch);
+        if (old != nullptr && haveTotals) AnalysisCache::mergeRecord(old, target, -1);
+    }
+
+    // Чȡڱֱ
+    uint64_t keywordsHash() const {
+        string all;
+        for (size_t i = 0; i < keywords.size(); i++) {
+            all += keywords[i];
+            all += '\n';
+        }
+        return hashContent(all.data(), all.size());
     }
 
     // ַȡ
-    vector<string> extractWords(const string& line) {
+    static vector<string> extractWords(const string& line) {
         vector<string> words;
         string word;
         for (size_t i = 0; i < line.length(); i++) {
@@ -42,7 +1899,37 @@ private:
 
 public:
     KeywordAnalyzer() {
-        scanCount = 0;
+        lexerMode = false;
+        cacheHits = 0;
+        topK = 0;
+        topCapacity = 0;
+        outputFormat = FORMAT_TEXT;
+        useBuiltinTable = false;
+    }
+
+    // ʷģʽ
+    void setLexerMode(bool enabled) {
+        lexerMode = enabled;
+    }
+
+    // ļ, ֻ analyzeFiles Ч
+    void setCachePath(const string& path) {
+        cachePath = path;
+    }
+
+    // ֻͳƳִ k Ǳ,  epsilon * Ǳ.
+    // Ϊ max(k, 1 / epsilon), С޹; Ȼȷ
+    void setTopK(size_t k, double epsilon) {
+        topK = k;
+        topCapacity = k > 0 ? max(k, (size_t)ceil(1.0 / epsilon)) : 0;
+        counts.topNonKeywords.setCapacity(topCapacity);
+    }
+
+    // ýļʽ·, ·Ϊʱʹ keyword_data / non_keyword_data Ӹʽչ
+    void setOutput(OutputFormat format, const string& keywordPath, const string& nonKeywordPath) {
+        outputFormat = format;
+        keywordOutput = keywordPath;
+        nonKeywordOutput = nonKeywordPath;
     }
 
     // ļر
@@ -51,62 +1938,581 @@ public:
         string keyword;
         while (file >> keyword) {
             keywords.push_back(keyword);
-            keywordCount[keyword] = 0;
         }
         file.close();
+        counts.keywordCount.resize(keywords.size());
+        buildKeywordIndex();
     }
 
-    // Դļ
+    // Դļ: ڴӳļֱг, ޷ӳʱ(ܵ"-" ʾı׼)ֿȡ
     void analyzeFile(const string& filename) {
-        ifstream file(filename.c_str());
-        string line;
-        scanCount = 0;
+        counts.scanCount = 0;
+        MappedFile mapped(filename);
+        if (mapped.isOpen()) {
+            countBuffer(counts, mapped.begin(), mapped.end());
+            return;
+        }
+        countUnmapped(counts, filename);
+    }
 
-        while (getline(file, line)) {
-            scanCount++;
-            vector<string> words = extractWords(line);
-            
-            for (size_t i = 0; i < words.size(); i++) {
-                if (isKeyword(words[i])) {
-                    keywordCount[words[i]]++;
-                } else {
-                    nonKeywordCount[words[i]]++;
+    // зļĿ¼, ÿ߳дԼļ, ȫɺٺϲ
+    // ʹûʱļ, ÿļֱͼ¼
+    void analyzeFiles(const vector<string>& inputs, int threadNum) {
+        bool useCache = !cachePath.empty();
+        vector<ScanTask> tasks = planScanTasks(collectSourceFiles(inputs), !lexerMode && !useCache);
+        threadNum = max(1, min(threadNum, (int)tasks.size()));
+        vector<WordCounts> local(threadNum), scratch(threadNum), uncached(threadNum);
+        vector<size_t> hits(threadNum, 0);
+        for (int i = 0; i < threadNum; i++) {
+            local[i].keywordCount.resize(keywords.size());
+            local[i].topNonKeywords.setCapacity(topCapacity);
+            uncached[i].keywordCount.resize(keywords.size());
+            uncached[i].topNonKeywords.setCapacity(topCapacity);
+        }
+
+        AnalysisCache cache(keywordsHash(), (uint32_t)keywords.size(), lexerMode ? CACHE_LEXER_MODE : 0);
+        vector<vector<char>> records(useCache ? tasks.size() : 0);
+        if (useCache) {
+            cache.load(cachePath);
+        }
+
+        WorkStealingPool pool(threadNum);
+        pool.run(tasks.size(), [&](size_t task, int worker) {
+            if (useCache) {
+                runCachedTask(tasks[task], cache, records[task], scratch[worker], local[worker], uncached[worker],
+                              hits[worker]);
+            } else {
+                runTask(tasks[task], local[worker]);
+            }
+        });
+        counts.scanCount = 0;
+        cacheHits = 0;
+        for (int i = 0; i < threadNum; i++) {
+            counts.merge(local[i]);
+            cacheHits += hits[i];
+        }
+        if (!useCache) {
+            return;
+        }
+
+        // һεĻܳ, ټȥβٷļ
+        bool removed = false;
+        if (cache.getTotals() != nullptr) {
+            AnalysisCache::mergeRecord(cache.getTotals(), counts);
+            unordered_map<string_view, bool> current;
+            for (size_t i = 0; i < tasks.size(); i++) {
+                current[tasks[i].path] = true;
+            }
+            vector<string_view> oldPaths = cache.paths();
+            for (size_t i = 0; i < oldPaths.size(); i++) {
+                if (current.find(oldPaths[i]) == current.end()) {
+                    AnalysisCache::mergeRecord(cache.find(string(oldPaths[i])), counts, -1);
+                    removed = true;
                 }
             }
         }
-        file.close();
+        // ļδĶʱд
+        if (cacheHits != tasks.size() || removed || cache.getTotals() == nullptr) {
+            cache.save(cachePath, counts, records);
+        }
+        // ûм¼벻ڱĻ, ֮żӵν
+        for (int i = 0; i < threadNum; i++) {
+            counts.merge(uncached[i]);
+        }
+    }
+
+    // õĸʽдһֱͼ, ʧʱʾ
+    void writeOutput(const string& path, const char* defaultName, string_view title,
+                     const vector<HistogramEntry>& entries, bool byCount) const {
+        string target = !path.empty() ? path : string(defaultName) + outputExtension(outputFormat);
+        if (!writeHistogram(target, outputFormat, title, entries, byCount)) {
+            cout << "޷дļ: " << target << endl;
+        }
     }
 
     // ͳƽļ
     void writeResults() {
-        // ͳ
-        ofstream keywordFile("keyword_data.txt");
-        keywordFile << "ͳƣ\n";
-        for (map<string, int>::iterator it = keywordCount.begin(); it != keywordCount.end(); ++it) {
-            if (it->second > 0) {
-                keywordFile << it->first << ": " << it->second << "\n";
+        // ͳ, ֵ
+        vector<HistogramEntry> keywordEntries;
+        for (size_t i = 0; i < keywords.size(); i++) {
+            if (counts.keywordCount[i] > 0) {
+                keywordEntries.push_back(HistogramEntry{keywords[i], counts.keywordCount[i], 0});
             }
         }
-        keywordFile.close();
+        sort(keywordEntries.begin(), keywordEntries.end(), [](const HistogramEntry& a, const HistogramEntry& b) {
+            return a.word != b.word ? a.word < b.word : a.count < b.count;
+        });
+        writeOutput(keywordOutput, "keyword_data", "ͳƣ", keywordEntries, false);
 
-        // Ǳͳ
-        ofstream nonKeywordFile("non_keyword_data.txt");
-        nonKeywordFile << "Ǳͳƣ\n";
-        for (map<string, int>::iterator it = nonKeywordCount.begin(); it != nonKeywordCount.end(); ++it) {
-            nonKeywordFile << it->first << ": " << it->second << "\n";
+        // ǰ K ģʽ: ӴС, ֵƫʱעϽ
+        if (topK > 0) {
+            string title = "Ǳͳƣǰ " + to_string(topK) + " ";
+            writeOutput(nonKeywordOutput, "non_keyword_data", title, counts.topNonKeywords.top(topK), true);
+            return;
         }
-        nonKeywordFile.close();
+
+        // Ǳͳ, ֻһ
+        writeOutput(nonKeywordOutput, "non_keyword_data", "Ǳͳƣ", counts.nonKeywordCount.sorted(), false);
+    }
+
+    // ȡǰ K ģʽ·ǱֵͼϽ
+    long long getNonKeywordTotal() const {
+        return counts.topNonKeywords.totalCount();
+    }
+
+    long long getTopKErrorBound() const {
+        return counts.topNonKeywords.minCount();
     }
 
     // ȡɨ
     int getScanCount() const {
-        return scanCount;
+        return counts.scanCount;
+    }
+
+    // ȡһηֱʹûļ
+    size_t getCacheHits() const {
+        return cacheHits;
+    }
+
+    // ȡʷģʽµעͺ
+    const LexerCounts& getLexerCounts() const {
+        return counts.lexerCounts;
+    }
+
+    // ֽ׶λ׼: ÿμʱ (ļӳϲҳ)з(ֻȡ)
+    // з+, ׶ȡ֮. Ԥ warmup , ͳ repeat ֵİٷλ
+    void benchmarkPhases(const string& filename, int warmup, int repeat) {
+        const int PHASE_NUM = 4;
+        const char* const phaseNames[PHASE_NUM] = {"", "з", "", ""};
+        vector<double> samples[PHASE_NUM];
+        vector<double> fullSamples;  // з+
+        size_t bytes = 0, tokens = 0;
+        for (int r = 0; r < warmup + repeat; r++) {
+            auto t0 = std::chrono::steady_clock::now();
+            keywords.clear();
+            loadKeywords("keywords.txt");
+            MappedFile mapped(filename);
+            if (!mapped.isOpen()) {
+                cout << "޷ȡ: " << filename << endl;
+                return;
+            }
+            // ǰҳ, Ľ׶βȱҳʱ
+            unsigned char touched = 0;
+            for (size_t i = 0; i < mapped.size(); i += 4096) touched ^= (unsigned char)mapped.begin()[i];
+            asm volatile("" : : "r"(touched));
+            auto t1 = std::chrono::steady_clock::now();
+
+            tokens = 0;
+            auto onWord = [&tokens](string_view) {
+                tokens++;
+            };
+            if (lexerMode) {
+                CppLexer lexer;
+                LexerCounts ignored;
+                lexer.lex(mapped.begin(), mapped.end(), ignored, onWord);
+            } else {
+                forEachWord(mapped.begin(), mapped.end(), onWord);
+            }
+            auto t2 = std::chrono::steady_clock::now();
+
+            counts.clear(keywords.size());
+            countBuffer(counts, mapped.begin(), mapped.end());
+            auto t3 = std::chrono::steady_clock::now();
+
+            writeResults();
+            auto t4 = std::chrono::steady_clock::now();
+
+            bytes = mapped.size();
+            if (r < warmup) continue;
+            double load = std::chrono::duration<double>(t1 - t0).count();
+            double tokenize = std::chrono::duration<double>(t2 - t1).count();
+            double full = std::chrono::duration<double>(t3 - t2).count();
+            samples[0].push_back(load);
+            samples[1].push_back(tokenize);
+            samples[2].push_back(full - tokenize);
+            samples[3].push_back(std::chrono::duration<double>(t4 - t3).count());
+            fullSamples.push_back(full);
+        }
+        if (repeat <= 0) return;
+
+        cout << ": " << filename << ", " << bytes / 1e6 << " MB,  " << tokens
+             << (lexerMode ? " (ʷģʽ)" : "") << ", Ԥ " << warmup << " , ͳ " << repeat << " " << endl;
+        cout << "׶\tС\tp50\tp90\tp99\t ()" << endl;
+        for (int k = 0; k < PHASE_NUM; k++) {
+            sort(samples[k].begin(), samples[k].end());
+            cout << phaseNames[k] << "\t" << samples[k].front() * 1e3 << "\t" << percentile(samples[k], 0.5) * 1e3
+                 << "\t" << percentile(samples[k], 0.9) * 1e3 << "\t" << percentile(samples[k], 0.99) * 1e3
+                 << "\t" << samples[k].back() * 1e3 << endl;
+        }
+        // λ
+        sort(fullSamples.begin(), fullSamples.end());
+        double tokenizeSeconds = percentile(samples[1], 0.5), fullSeconds = percentile(fullSamples, 0.5);
+        cout << "з: " << bytes / tokenizeSeconds / 1e6 << " MB/s, " << tokens / tokenizeSeconds / 1e6 << " M/" << endl;
+        cout << "з+: " << bytes / fullSeconds / 1e6 << " MB/s, " << tokens / fullSeconds / 1e6 << " M/" << endl;
+    }
+
+    // ֲ΢׼: ԱԭԲ뵱ǰҷʽÿʺʱ
+    void benchmarkLookup(const string& filename) {
+        ifstream file(filename.c_str());
+        string line;
+        vector<string> words;
+        while (getline(file, line)) {
+            vector<string> lineWords = extractWords(line);
+            words.insert(words.end(), lineWords.begin(), lineWords.end());
+        }
+        file.close();
+        if (words.empty()) {
+            cout << "Ϊ: " << filename << endl;
+            return;
+        }
+
+        const int ROUNDS = 5;
+        size_t linearHits = 0, tableHits = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        for (int r = 0; r < ROUNDS; r++) {
+            for (size_t i = 0; i < words.size(); i++) {
+                linearHits += find(keywords.begin(), keywords.end(), words[i]) != keywords.end();
+            }
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        for (int r = 0; r < ROUNDS; r++) {
+            for (size_t i = 0; i < words.size(); i++) {
+                tableHits += isKeyword(words[i]);
+            }
+        }
+        auto t2 = std::chrono::steady_clock::now();
+
+        double lookups = (double)words.size() * ROUNDS;
+        double linearNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / lookups;
+        double tableNs = std::chrono::duration<double, std::nano>(t2 - t1).count() / lookups;
+        cout << ": " << words.size() << ", : " << tableHits / ROUNDS << endl;
+        cout << "Բ: " << linearNs << " ns/" << endl;
+        cout << (useBuiltinTable ? "ϣ" : "ڹϣ") << ": " << tableNs << " ns/" << endl;
+        if (linearHits != tableHits) {
+            cout << "ҽһ!" << endl;
+        }
     }
 };
 
-int main() {
+// ȷԵĺϳ C++ : Լ bytes ֽ, ʶ distinct а Zipf ֲѡȡ,
+// Լ keywordPercent% ĵǱ, עַ͡. ͬɵļȫͬ
+bool generateCorpus(const string& filename, size_t bytes, size_t distinct, double keywordPercent, uint64_t seed) {
+    uint64_t state = seed;
+    // splitmix64
+    auto next = [&state]() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    };
+    auto uniform = [&next]() {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    };
+
+    // žҺת 36 ,  2~12 
+    auto identifier = [](size_t id, string& out) {
+        uint64_t x = (id + 1) * 0x9e3779b97f4a7c15ull;
+        out += "abcdefghijklmnopqrstuvwxyz_"[x % 27];
+        x /= 27;
+        for (size_t n = id % 11; n > 0; n--, x /= 37) {
+            out += "abcdefghijklmnopqrstuvwxyz0123456789_"[x % 37];
+        }
+        static const char digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+        for (size_t v = id; ; v /= 36) {
+            out += digits[v % 36];
+            if (v < 36) break;
+        }
+    };
+    static const char* const operators[] = {" = ", " + ", " - ", " * ", " < ", " == ", "(", ")", ", ", "->", ".", "::", " && ", "[", "]"};
+    const size_t operatorNum = sizeof(operators) / sizeof(operators[0]);
+
+    ofstream out(filename.c_str(), ios::binary);
+    if (!out) return false;
+    string buffer;
+    size_t written = 0;
+    while (written < bytes) {
+        string line(next() % 4 * 4, ' ');
+        double kind = uniform();
+        size_t words = 3 + next() % 8;
+        if (kind < 0.08) {
+            line += "// ";
+        } else if (kind < 0.10) {
+            line += "#define ";
+        }
+        for (size_t w = 0; w < words; w++) {
+            if (w > 0) {
+                line += kind < 0.08 ? " " : operators[next() % operatorNum];
+            }
+            double r = uniform();
+            if (r * 100 < keywordPercent) {
+                line += builtinKeywords[next() % BUILTIN_KEYWORD_NUM];
+            } else if (kind >= 0.08 && next() % 16 == 0) {
+                // : ַֻ, ַеĵڴʷģʽ²
+                if (next() % 2) {
+                    line += to_string(next() % 100000);
+                } else {
+                    line += "\"";
+                    identifier(next() % max<size_t>(distinct, 1), line);
+                    line += " text\"";
+                }
+            } else {
+                //  Zipf: ±ȡ distinct^u - 1, С±ֵö
+                identifier((size_t)pow((double)max<size_t>(distinct, 1), uniform()) - 1, line);
+            }
+        }
+        line += kind < 0.10 ? "\n" : ";\n";
+        buffer += line;
+        written += line.size();
+        if (buffer.size() >= (1 << 20)) {
+            out.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+    out.write(buffer.data(), buffer.size());
+    return (bool)out;
+}
+
+// ɨ׼: ֻзֵʲ, Ƚϸʵ
+void benchmarkScanners(const string& filename) {
+    MappedFile mapped(filename);
+    if (!mapped.isOpen() || mapped.begin() == mapped.end()) {
+        cout << "޷ȡ: " << filename << endl;
+        return;
+    }
+    const int ROUNDS = 10;
+    double bytes = (double)(mapped.end() - mapped.begin()) * ROUNDS;
+    vector<ScannerKernel> kernels = availableScanners();
+    size_t expectedWords = 0;
+    for (size_t k = 0; k < kernels.size(); k++) {
+        size_t words = 0, wordBytes = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        for (int r = 0; r < ROUNDS; r++) {
+            forEachWord(mapped.begin(), mapped.end(), [&](string_view word) {
+                words++;
+                wordBytes += word.size();
+            }, kernels[k].scan);
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(t1 - t0).count();
+        cout << kernels[k].name << ": " << bytes / seconds / 1e9 << " GB/s,  " << words / ROUNDS << endl;
+        if (k == 0) {
+            expectedWords = words + wordBytes;
+        } else if (words + wordBytes != expectedWords) {
+            cout << kernels[k].name << " зֽ scalar һ!" << endl;
+        }
+    }
+}
+
+// ǰѷĶڴֽ( mmap Ĵ),  glibc , ƽ̨ 0
+size_t heapBytesInUse() {
+#ifdef __GLIBC__
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+// ׼: distinct ͬʶ, ÿƽ 4 , Ƚ std::map  WordCounter ٶȺڴ
+void benchmarkCounters(size_t distinct) {
+    // ɲظıʶ,  3~18 ֮仯
+    string storage;
+    vector<size_t> offsets;
+    for (size_t i = 0; i < distinct; i++) {
+        offsets.push_back(storage.size());
+        storage += "id_";
+        uint64_t x = (i + 1) * 0x9e3779b97f4a7c15ull;
+        for (size_t n = i % 16; n > 0; n--, x /= 37) {
+            storage += "abcdefghijklmnopqrstuvwxyz0123456789_"[x % 37];
+        }
+        storage += to_string(i);
+    }
+    offsets.push_back(storage.size());
+    vector<string_view> words;
+    for (size_t i = 0; i < distinct; i++) {
+        words.emplace_back(storage.data() + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+    // ̶ӵĵ: ȸһ,  3 * distinct 
+    vector<uint32_t> stream;
+    for (size_t i = 0; i < distinct; i++) stream.push_back((uint32_t)i);
+    uint64_t state = 12345;
+    for (size_t i = 0; i < 3 * distinct; i++) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        stream.push_back((uint32_t)((state >> 33) % distinct));
+    }
+
+    size_t before = heapBytesInUse();
+    auto t0 = std::chrono::steady_clock::now();
+    {
+        map<string, int, less<>> counts;
+        for (size_t i = 0; i < stream.size(); i++) {
+            string_view word = words[stream[i]];
+            auto it = counts.find(word);
+            if (it != counts.end()) {
+                it->second++;
+            } else {
+                counts.emplace(string(word), 1);
+            }
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(t1 - t0).count();
+        cout << "std::map: " << stream.size() / seconds / 1e6 << " M/, ڴ "
+             << (heapBytesInUse() - before) / 1e6 << " MB" << endl;
+    }
+
+    before = heapBytesInUse();
+    auto t2 = std::chrono::steady_clock::now();
+    {
+        WordCounter counts;
+        for (size_t i = 0; i < stream.size(); i++) {
+            counts.add(words[stream[i]]);
+        }
+        auto t3 = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(t3 - t2).count();
+        cout << "WordCounter: " << stream.size() / seconds / 1e6 << " M/, ڴ "
+             << (heapBytesInUse() - before) / 1e6 << " MB ( + ڴ " << counts.memoryBytes() / 1e6 << " MB)" << endl;
+        auto t4 = std::chrono::steady_clock::now();
+        vector<HistogramEntry> entries = counts.sorted();
+        auto t5 = std::chrono::steady_clock::now();
+        cout << "ǰ " << entries.size() << " : " << std::chrono::duration<double>(t5 - t4).count() << " " << endl;
+    }
+}
+
+// ̼߳ٱȻ׼: ߳ 1  maxThreads, ÿ·ͬһ
+void benchmarkThreads(const vector<string>& inputs, int maxThreads, bool lexerMode) {
+    vector<string> files = collectSourceFiles(inputs);
+    double bytes = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        struct stat st;
+        if (stat(files[i].c_str(), &st) == 0) bytes += st.st_size;
+    }
+    cout << "ļ: " << files.size() << ", ܴС: " << bytes / 1e6 << " MB, CPU : " << thread::hardware_concurrency() << endl;
+
+    vector<int> threadNums;
+    for (int t = 1; t < maxThreads; t *= 2) threadNums.push_back(t);
+    threadNums.push_back(maxThreads);
+    double baseline = 0;
+    for (size_t i = 0; i < threadNums.size(); i++) {
+        KeywordAnalyzer analyzer;
+        analyzer.loadKeywords("keywords.txt");
+        analyzer.setLexerMode(lexerMode);
+        auto t0 = std::chrono::steady_clock::now();
+        analyzer.analyzeFiles(files, threadNums[i]);
+        auto t1 = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(t1 - t0).count();
+        if (i == 0) baseline = seconds;
+        cout << "߳ " << threadNums[i] << ": " << seconds << " , " << bytes / seconds / 1e6
+             << " MB/s, ٱ " << baseline / seconds << endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
     KeywordAnalyzer analyzer;
-    
+
+    // ֲ΢׼: keyword_analyzer --bench-lookup <ļ>
+    if (argc == 3 && string(argv[1]) == "--bench-lookup") {
+        analyzer.loadKeywords("keywords.txt");
+        analyzer.benchmarkLookup(argv[2]);
+        return 0;
+    }
+
+    // ɨ׼: keyword_analyzer --bench-scan <ļ>
+    if (argc == 3 && string(argv[1]) == "--bench-scan") {
+        benchmarkScanners(argv[2]);
+        return 0;
+    }
+
+    // ׼: keyword_analyzer --bench-counter <ͬʶ>
+    if (argc == 3 && string(argv[1]) == "--bench-counter") {
+        benchmarkCounters(max(1L, atol(argv[2])));
+        return 0;
+    }
+
+    // ɺϳ: keyword_analyzer --gen-corpus <ļ> <ֽ> <ͬʶ> <ְٷֱ> []
+    if ((argc == 6 || argc == 7) && string(argv[1]) == "--gen-corpus") {
+        uint64_t seed = argc == 7 ? strtoull(argv[6], nullptr, 10) : 1;
+        if (!generateCorpus(argv[2], strtoull(argv[3], nullptr, 10), strtoull(argv[4], nullptr, 10), atof(argv[5]), seed)) {
+            cout << "޷д: " << argv[2] << endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // keyword_analyzer [-j ߳] [--lexer] [--cache ļ] [--top K [--epsilon e]] [--bench-threads]
+    // [--bench [--warmup N] [--repeat N]] [--format text|csv|json|binary] [--keyword-out ļ] [--non-keyword-out ļ]
+    // [ļĿ¼...], ʱ source.cpp, "-" ʾ׼
+    vector<string> inputs;
+    int threadNum = max(1, (int)thread::hardware_concurrency());
+    bool benchThreads = false;
+    bool benchPhases = false;
+    int warmup = 2, repeat = 10;
+    bool lexerMode = false;
+    string cachePath;
+    size_t topK = 0;
+    double epsilon = 1e-4;
+    OutputFormat outputFormat = FORMAT_TEXT;
+    string keywordOutput, nonKeywordOutput;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-j" && i + 1 < argc) {
+            threadNum = max(1, atoi(argv[++i]));
+        } else if (arg == "--bench-threads") {
+            benchThreads = true;
+        } else if (arg == "--bench") {
+            benchPhases = true;
+        } else if (arg == "--warmup" && i + 1 < argc) {
+            warmup = max(0, atoi(argv[++i]));
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            repeat = max(1, atoi(argv[++i]));
+        } else if (arg == "--lexer") {
+            lexerMode = true;
+        } else if (arg == "--cache" && i + 1 < argc) {
+            cachePath = argv[++i];
+        } else if (arg == "--top" && i + 1 < argc) {
+            topK = max(1L, atol(argv[++i]));
+        } else if (arg == "--epsilon" && i + 1 < argc) {
+            epsilon = atof(argv[++i]);
+        } else if (arg == "--format" && i + 1 < argc) {
+            if (!parseOutputFormat(argv[++i], outputFormat)) {
+                cout << "δ֪ʽ: " << argv[i] << " (ѡ text, csv, json, binary)" << endl;
+                return 1;
+            }
+        } else if (arg == "--keyword-out" && i + 1 < argc) {
+            keywordOutput = argv[++i];
+        } else if (arg == "--non-keyword-out" && i + 1 < argc) {
+            nonKeywordOutput = argv[++i];
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+    if (benchThreads) {
+        benchmarkThreads(inputs, threadNum, lexerMode);
+        return 0;
+    }
+    if (topK > 0 && !cachePath.empty()) {
+        cout << "--top  --cache ͬʱʹ: Ҫֱͼ" << endl;
+        return 1;
+    }
+    if (!(epsilon > 0 && epsilon < 1)) {
+        cout << "--epsilon Ӧ 0  1 ֮" << endl;
+        return 1;
+    }
+    analyzer.setLexerMode(lexerMode);
+    analyzer.setCachePath(cachePath);
+    analyzer.setTopK(topK, epsilon);
+    analyzer.setOutput(outputFormat, keywordOutput, nonKeywordOutput);
+    if (benchPhases) {
+        analyzer.benchmarkPhases(inputs.empty() ? "source.cpp" : inputs[0], warmup, repeat);
+        return 0;
+    }
+    if (inputs.size() > 1 && find(inputs.begin(), inputs.end(), "-") != inputs.end()) {
+        cout << "\"-\" (׼) ֻΪΨһ, ļĿ¼һ" << endl;
+        return 1;
+    }
+    if (!cachePath.empty() && inputs.empty()) {
+        inputs.push_back("source.cpp");
+    }
+
     // ¼ʼʱ
     clock_t start = clock();
 
@@ -114,7 +2520,13 @@ int main() {
     analyzer.loadKeywords("keywords.txt");
 
     // Դļ
-    analyzer.analyzeFile("source.cpp");
+    if (inputs.empty()) {
+        analyzer.analyzeFile("source.cpp");
+    } else if (inputs.size() == 1 && inputs[0] == "-") {
+        analyzer.analyzeFile("-");
+    } else {
+        analyzer.analyzeFiles(inputs, threadNum);
+    }
 
     // 
     analyzer.writeResults();
@@ -126,6 +2538,21 @@ int main() {
     // ɨϢ
     cout << "ɨ: " << analyzer.getScanCount() << endl;
     cout << "ɨʱ: " << duration << " " << endl;
+    if (!cachePath.empty()) {
+        cout << ": " << analyzer.getCacheHits() << " ļ" << endl;
+    }
+    if (topK > 0) {
+        cout << "Ǳ: " << analyzer.getNonKeywordTotal()
+             << ", Ͻ: " << analyzer.getTopKErrorBound() << endl;
+    }
+    if (lexerMode) {
+        const LexerCounts& lexerCounts = analyzer.getLexerCounts();
+        cout << "ע: " << lexerCounts.comments << endl;
+        cout << "ַ: " << lexerCounts.strings << endl;
+        cout << "ַ: " << lexerCounts.chars << endl;
+        cout << ": " << lexerCounts.numbers << endl;
+        cout << "Ԥָ: " << lexerCounts.directives << endl;
+    }
 
     return 0;
 }
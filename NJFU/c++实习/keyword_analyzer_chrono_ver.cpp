@@ -1,29 +1,1885 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <string_view>
 #include <map>
+#include <unordered_map>
 #include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <filesystem>
+#include <utility>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <cmath>
+#include <charconv>
 #include <chrono>
 #include <sstream>
 #include <algorithm>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define KEYWORD_ANALYZER_X86 1
+#endif
 
 using namespace std;
 using namespace std::chrono;
 
+// 内置的 C++ 保留字表, 与 keywords.txt 内容一致
+constexpr string_view builtinKeywords[] = {
+    "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor",
+    "bool", "break", "case", "catch", "char", "char8_t", "char16_t", "char32_t",
+    "class", "compl", "concept", "const", "consteval", "constexpr", "constinit", "const_cast",
+    "continue", "co_await", "co_return", "co_yield", "decltype", "default", "delete", "do",
+    "double", "dynamic_cast", "else", "enum", "explicit", "export", "extern", "false",
+    "float", "for", "friend", "goto", "if", "inline", "int", "long",
+    "mutable", "namespace", "new", "noexcept", "not", "not_eq", "nullptr", "operator",
+    "or", "or_eq", "private", "protected", "public", "reflexpr", "register", "reinterpret_cast",
+    "requires", "return", "short", "signed", "sizeof", "static", "static_assert", "static_cast",
+    "struct", "switch", "synchronized", "template", "this", "thread_local", "throw", "true",
+    "try", "typedef", "typeid", "typename", "union", "unsigned", "using", "virtual",
+    "void", "volatile", "wchar_t", "while", "xor", "xor_eq"
+};
+constexpr size_t BUILTIN_KEYWORD_NUM = sizeof(builtinKeywords) / sizeof(builtinKeywords[0]);
+
+// 内置保留字的最短/最长长度, 长度不在范围内的单词直接判定为非保留字
+constexpr size_t keywordLengthBound(bool longest) {
+    size_t bound = builtinKeywords[0].size();
+    for (size_t i = 1; i < BUILTIN_KEYWORD_NUM; i++) {
+        size_t len = builtinKeywords[i].size();
+        if (longest ? len > bound : len < bound) bound = len;
+    }
+    return bound;
+}
+constexpr size_t KEYWORD_MIN_LEN = keywordLengthBound(false);
+constexpr size_t KEYWORD_MAX_LEN = keywordLengthBound(true);
+
+// 完美哈希只取长度、首字符、中间字符和末字符, 不必遍历整个单词
+// (内置保留字在这四项上互不相同), 乘以种子后取高位作为槽位
+constexpr uint32_t keywordHash(string_view word, uint32_t seed) {
+    uint32_t key = (uint32_t)word.size()
+                 | (uint32_t)(unsigned char)word[0] << 8
+                 | (uint32_t)(unsigned char)word[word.size() / 2] << 16
+                 | (uint32_t)(unsigned char)word[word.size() - 1] << 24;
+    key ^= key >> 15;
+    key *= seed;
+    key ^= key >> 13;
+    return key * 0x9e3779b1u;
+}
+
+const int PERFECT_HASH_BITS = 10;
+const int PERFECT_HASH_SIZE = 1 << PERFECT_HASH_BITS;
+const uint8_t PERFECT_HASH_EMPTY = 0xff;
+
+struct PerfectHashTable {
+    uint32_t seed;
+    uint8_t slot[PERFECT_HASH_SIZE];  // 槽位 -> builtinKeywords 下标
+};
+
+// 编译期搜索一个使所有内置保留字互不冲突的种子
+constexpr PerfectHashTable buildPerfectHash() {
+    for (uint32_t attempt = 1; ; attempt++) {
+        uint32_t seed = (attempt * 2654435761u) | 1;
+        PerfectHashTable table{seed, {}};
+        for (int i = 0; i < PERFECT_HASH_SIZE; i++) {
+            table.slot[i] = PERFECT_HASH_EMPTY;
+        }
+        bool collision = false;
+        for (size_t i = 0; i < BUILTIN_KEYWORD_NUM && !collision; i++) {
+            uint32_t s = keywordHash(builtinKeywords[i], seed) >> (32 - PERFECT_HASH_BITS);
+            if (table.slot[s] != PERFECT_HASH_EMPTY) {
+                collision = true;
+            } else {
+                table.slot[s] = (uint8_t)i;
+            }
+        }
+        if (!collision) {
+            return table;
+        }
+    }
+}
+constexpr PerfectHashTable keywordPerfectHash = buildPerfectHash();
+static_assert(BUILTIN_KEYWORD_NUM < PERFECT_HASH_EMPTY, "too many builtin keywords");
+
+// 在内置保留字表中查找, 返回下标, 不存在时返回 -1
+inline int findBuiltinKeyword(string_view word) {
+    if (word.size() < KEYWORD_MIN_LEN || word.size() > KEYWORD_MAX_LEN) {
+        return -1;
+    }
+    uint32_t s = keywordHash(word, keywordPerfectHash.seed) >> (32 - PERFECT_HASH_BITS);
+    int index = keywordPerfectHash.slot[s];
+    if (index == PERFECT_HASH_EMPTY || builtinKeywords[index] != word) {
+        return -1;
+    }
+    return index;
+}
+
+// 单词字符表: 与 "C" locale 下的 isalnum(c) || c == '_' 一致
+struct WordCharTable {
+    bool value[256];
+    constexpr WordCharTable() : value() {
+        for (int c = 0; c < 256; c++) {
+            value[c] = (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_';
+        }
+    }
+};
+constexpr WordCharTable wordChars;
+
+inline bool isWordChar(char c) {
+    return wordChars.value[(unsigned char)c];
+}
+
+// 64 字节块的分类结果, 每一位对应块内一个字节
+struct BlockMask {
+    uint64_t word;  // 单词字符
+    uint64_t newline;  // 换行符
+};
+typedef BlockMask (*BlockScanner)(const char* block);
+
+// 逐字节查表的实现, 所有平台可用
+inline BlockMask scanBlockScalar(const char* block) {
+    BlockMask mask = {0, 0};
+    for (int i = 0; i < 64; i++) {
+        mask.word |= (uint64_t)isWordChar(block[i]) << i;
+        mask.newline |= (uint64_t)(block[i] == '\n') << i;
+    }
+    return mask;
+}
+
+#ifdef KEYWORD_ANALYZER_X86
+// SSE4.2: 用 pcmpestrm 的区间比较一次判断 16 个字节是否落在 0-9 A-Z a-z _ 中
+__attribute__((target("sse4.2")))
+BlockMask scanBlockSse42(const char* block) {
+    const __m128i ranges = _mm_setr_epi8('0', '9', 'A', 'Z', 'a', 'z', '_', '_', 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i newline = _mm_set1_epi8('\n');
+    BlockMask mask = {0, 0};
+    for (int i = 0; i < 4; i++) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(block + 16 * i));
+        __m128i m = _mm_cmpestrm(ranges, 8, v, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_BIT_MASK);
+        mask.word |= (uint64_t)(uint16_t)_mm_cvtsi128_si32(m) << (16 * i);
+        mask.newline |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)) << (16 * i);
+    }
+    return mask;
+}
+
+// AVX2: 一次 32 个字节, 用无符号区间判断 c - lo <= hi - lo
+__attribute__((target("avx2")))
+BlockMask scanBlockAvx2(const char* block) {
+    const __m256i digitLo = _mm256_set1_epi8('0'), digitSpan = _mm256_set1_epi8(9);
+    const __m256i alphaLo = _mm256_set1_epi8('a'), alphaSpan = _mm256_set1_epi8(25);
+    const __m256i lowerBit = _mm256_set1_epi8(0x20);
+    const __m256i underscore = _mm256_set1_epi8('_');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    BlockMask mask = {0, 0};
+    for (int i = 0; i < 2; i++) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(block + 32 * i));
+        __m256i digit = _mm256_sub_epi8(v, digitLo);
+        digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, digitSpan), digit);
+        __m256i alpha = _mm256_sub_epi8(_mm256_or_si256(v, lowerBit), alphaLo);
+        alpha = _mm256_cmpeq_epi8(_mm256_min_epu8(alpha, alphaSpan), alpha);
+        __m256i word = _mm256_or_si256(_mm256_or_si256(digit, alpha), _mm256_cmpeq_epi8(v, underscore));
+        mask.word |= (uint64_t)(uint32_t)_mm256_movemask_epi8(word) << (32 * i);
+        mask.newline |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline)) << (32 * i);
+    }
+    return mask;
+}
+#endif
+
+struct ScannerKernel {
+    const char* name;
+    BlockScanner scan;
+};
+
+// 当前 CPU 可用的实现, 越靠后越快
+vector<ScannerKernel> availableScanners() {
+    vector<ScannerKernel> kernels;
+    kernels.push_back({"scalar", scanBlockScalar});
+#ifdef KEYWORD_ANALYZER_X86
+    if (__builtin_cpu_supports("sse4.2")) kernels.push_back({"sse4.2", scanBlockSse42});
+    if (__builtin_cpu_supports("avx2")) kernels.push_back({"avx2", scanBlockAvx2});
+#endif
+    return kernels;
+}
+
+// 启动时选定一次最快的实现
+inline BlockScanner bestScanner() {
+    static const BlockScanner best = availableScanners().back().scan;
+    return best;
+}
+
+// 依次取出 [begin, end) 中的单词交给 onWord, 不做任何堆分配, 返回行数(与 getline 的次数一致)
+// 每次分类 64 个字节, 单词的起止位置由掩码的上升沿/下降沿得到, 单词可以跨块
+template <typename F>
+int forEachWord(const char* begin, const char* end, F&& onWord, BlockScanner scanBlock = bestScanner()) {
+    int lines = 0;
+    const char* wordBegin = begin;
+    uint64_t carry = 0;  // 上一块的最后一个字节是否是单词字符
+    for (const char* base = begin; base < end; base += 64) {
+        BlockMask mask;
+        if (end - base >= 64) {
+            mask = scanBlock(base);
+        } else {
+            // 最后不足 64 字节的部分补 0 (非单词字符)
+            char tail[64] = {0};
+            memcpy(tail, base, end - base);
+            mask = scanBlock(tail);
+        }
+        lines += __builtin_popcountll(mask.newline);
+
+        uint64_t previous = (mask.word << 1) | carry;
+        uint64_t starts = mask.word & ~previous;
+        uint64_t ends = ~mask.word & previous;
+        carry = mask.word >> 63;
+        for (uint64_t edges = starts | ends; edges != 0; edges &= edges - 1) {
+            int bit = __builtin_ctzll(edges);
+            if ((starts >> bit) & 1) {
+                wordBegin = base + bit;
+            } else {
+                onWord(string_view(wordBegin, base + bit - wordBegin));
+            }
+        }
+    }
+    if (carry) {
+        onWord(string_view(wordBegin, end - wordBegin));
+    }
+    if (begin < end && end[-1] != '\n') {
+        lines++;
+    }
+    return lines;
+}
+
+// 词法分析模式中单独统计的各类记号
+struct LexerCounts {
+    long long comments = 0;  // 注释
+    long long strings = 0;  // 字符串字面量(含原始字符串)
+    long long chars = 0;  // 字符字面量
+    long long numbers = 0;  // 数字字面量
+    long long directives = 0;  // 预处理指令
+
+    void merge(const LexerCounts& other) {
+        comments += other.comments;
+        strings += other.strings;
+        chars += other.chars;
+        numbers += other.numbers;
+        directives += other.directives;
+    }
+};
+
+// 词法分析用的字符分类
+enum LexCharClass : uint8_t {
+    LEX_OTHER, LEX_SPACE, LEX_NEWLINE, LEX_IDENT, LEX_DIGIT, LEX_DOT,
+    LEX_QUOTE, LEX_APOSTROPHE, LEX_SLASH, LEX_HASH, LEX_LESS, LEX_BACKSLASH
+};
+
+struct LexCharTable {
+    LexCharClass value[256];
+    constexpr LexCharTable() : value() {
+        for (int c = 0; c < 256; c++) {
+            LexCharClass cls = LEX_OTHER;
+            if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_') cls = LEX_IDENT;
+            else if (c >= '0' && c <= '9') cls = LEX_DIGIT;
+            else if (c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f') cls = LEX_SPACE;
+            else if (c == '\n') cls = LEX_NEWLINE;
+            else if (c == '.') cls = LEX_DOT;
+            else if (c == '"') cls = LEX_QUOTE;
+            else if (c == '\'') cls = LEX_APOSTROPHE;
+            else if (c == '/') cls = LEX_SLASH;
+            else if (c == '#') cls = LEX_HASH;
+            else if (c == '<') cls = LEX_LESS;
+            else if (c == '\\') cls = LEX_BACKSLASH;
+            value[c] = cls;
+        }
+    }
+};
+constexpr LexCharTable lexChars;
+
+// C++ 词法分析器: 一遍扫描, 跳过注释、字符串/字符/原始字符串字面量、数字、
+// 预处理指令名、#include 的头文件名和 #error/#warning 的文本, 只把代码中的标识符交给回调.
+// 块注释、原始字符串和续行的状态保存在对象里, 输入可以按行边界分多次送入
+class CppLexer {
+public:
+    enum State { CODE, LINE_COMMENT, BLOCK_COMMENT, STRING, CHAR, RAW_STRING, DIRECTIVE_TEXT };
+
+private:
+    enum DirectivePhase { NO_DIRECTIVE, DIRECTIVE_NAME, DIRECTIVE_HEADER };
+
+    State state;
+    DirectivePhase directive;
+    bool atLineStart;  // 当前行到目前为止只有空白, 此时的 # 开始一条预处理指令
+    char rawDelimiter[16];  // 原始字符串 R"delim( ... )delim" 的分隔符
+    size_t rawDelimiterLength;
+
+    static bool isIdentChar(char c) {
+        LexCharClass cls = lexChars.value[(unsigned char)c];
+        return cls == LEX_IDENT || cls == LEX_DIGIT;
+    }
+
+    static int countNewlines(const char* begin, const char* end) {
+        return (int)std::count(begin, end, '\n');
+    }
+
+    // 字符串/字符字面量前缀 u8 u U L
+    static bool isEncodingPrefix(string_view word) {
+        return word == "u8" || word == "u" || word == "U" || word == "L";
+    }
+
+    // 原始字符串前缀 R u8R uR UR LR
+    static bool isRawPrefix(string_view word) {
+        return word == "R" || word == "u8R" || word == "uR" || word == "UR" || word == "LR";
+    }
+
+    // 读取原始字符串的分隔符, p 指向开头的引号, 成功时返回 '(' 之后的位置
+    const char* beginRawString(const char* p, const char* end) {
+        const char* q = p + 1;
+        rawDelimiterLength = 0;
+        while (q < end && *q != '(' && rawDelimiterLength < sizeof(rawDelimiter)) {
+            char c = *q;
+            if (c == ' ' || c == ')' || c == '\\' || c == '\t' || c == '\n' || c == '"') {
+                return nullptr;
+            }
+            rawDelimiter[rawDelimiterLength++] = c;
+            q++;
+        }
+        if (q >= end || *q != '(') {
+            return nullptr;
+        }
+        state = RAW_STRING;
+        return q + 1;
+    }
+
+    // 字面量后紧跟的用户自定义后缀(如 "abc"s, 'x'_c)不算标识符
+    static const char* skipLiteralSuffix(const char* p, const char* end) {
+        if (p < end && lexChars.value[(unsigned char)*p] == LEX_IDENT) {
+            while (p < end && isIdentChar(*p)) p++;
+        }
+        return p;
+    }
+
+    // pp-number: 数字或 .数字 开头, 包括 0x1F, 1e+5, 1'000, 12_km 等形式
+    static const char* skipNumber(const char* p, const char* end) {
+        p++;
+        while (p < end) {
+            char c = *p;
+            if (isIdentChar(c) || c == '.') {
+                if ((c == 'e' || c == 'E' || c == 'p' || c == 'P') && p + 1 < end && (p[1] == '+' || p[1] == '-')) {
+                    p++;
+                }
+                p++;
+            } else if (c == '\'' && p + 1 < end && isIdentChar(p[1])) {
+                p += 2;
+            } else {
+                break;
+            }
+        }
+        return p;
+    }
+
+public:
+    CppLexer() : state(CODE), directive(NO_DIRECTIVE), atLineStart(true), rawDelimiterLength(0) {}
+
+    State getState() const {
+        return state;
+    }
+
+    // 分析 [begin, end), 标识符交给 onWord, 返回行数(与 forEachWord 的约定一致)
+    template <typename F>
+    int lex(const char* begin, const char* end, LexerCounts& stats, F&& onWord) {
+        int lines = 0;
+        const char* p = begin;
+        while (p < end) {
+            switch (state) {
+            case BLOCK_COMMENT: {
+                const char* q = p;
+                while (true) {
+                    q = (const char*)memchr(q, '*', end - q);
+                    if (q == nullptr || q + 1 >= end) {
+                        lines += countNewlines(p, end);
+                        p = end;
+                        break;
+                    }
+                    if (q[1] == '/') {
+                        lines += countNewlines(p, q);
+                        p = q + 2;
+                        state = CODE;
+                        break;
+                    }
+                    q++;
+                }
+                break;
+            }
+            case LINE_COMMENT:
+            case DIRECTIVE_TEXT: {
+                // 行尾换行交给 CODE 状态处理, 反斜杠续行时注释延续到下一行
+                const char* q = (const char*)memchr(p, '\n', end - p);
+                if (q == nullptr) {
+                    p = end;
+                    break;
+                }
+                const char* last = q > begin && q[-1] == '\r' ? q - 1 : q;
+                if (last > begin && last[-1] == '\\') {
+                    lines++;
+                    p = q + 1;
+                } else {
+                    p = q;
+                    state = CODE;
+                }
+                break;
+            }
+            case STRING:
+            case CHAR: {
+                char quote = state == STRING ? '"' : '\'';
+                while (p < end) {
+                    char c = *p;
+                    if (c == '\\') {
+                        if (p + 1 < end && p[1] == '\n') {
+                            lines++;
+                        } else if (p + 2 < end && p[1] == '\r' && p[2] == '\n') {
+                            lines++;
+                            p++;
+                        }
+                        p += 2;
+                    } else if (c == quote) {
+                        p = skipLiteralSuffix(p + 1, end);
+                        state = CODE;
+                        break;
+                    } else if (c == '\n') {
+                        state = CODE;  // 未闭合的字面量在行尾结束
+                        break;
+                    } else {
+                        p++;
+                    }
+                }
+                if (p > end) p = end;
+                break;
+            }
+            case RAW_STRING: {
+                const char* q = p;
+                while (true) {
+                    q = (const char*)memchr(q, ')', end - q);
+                    if (q == nullptr) {
+                        lines += countNewlines(p, end);
+                        p = end;
+                        break;
+                    }
+                    if ((size_t)(end - q) > rawDelimiterLength + 1
+                        && memcmp(q + 1, rawDelimiter, rawDelimiterLength) == 0
+                        && q[1 + rawDelimiterLength] == '"') {
+                        lines += countNewlines(p, q);
+                        p = skipLiteralSuffix(q + 2 + rawDelimiterLength, end);
+                        state = CODE;
+                        break;
+                    }
+                    q++;
+                }
+                break;
+            }
+            case CODE:
+                while (p < end && state == CODE) {
+                    switch (lexChars.value[(unsigned char)*p]) {
+                    case LEX_SPACE:
+                        p++;
+                        break;
+                    case LEX_NEWLINE:
+                        lines++;
+                        atLineStart = true;
+                        directive = NO_DIRECTIVE;
+                        p++;
+                        break;
+                    case LEX_IDENT: {
+                        const char* wordBegin = p;
+                        while (p < end && isIdentChar(*p)) p++;
+                        string_view word(wordBegin, p - wordBegin);
+                        atLineStart = false;
+                        if (p < end && *p == '"' && isRawPrefix(word)) {
+                            const char* body = beginRawString(p, end);
+                            if (body != nullptr) {
+                                stats.strings++;
+                                p = body;
+                                break;
+                            }
+                        }
+                        if (p < end && (*p == '"' || *p == '\'') && isEncodingPrefix(word)) {
+                            break;  // 前缀属于随后的字面量
+                        }
+                        if (directive == DIRECTIVE_NAME) {
+                            directive = word == "include" || word == "include_next" || word == "import"
+                                ? DIRECTIVE_HEADER : NO_DIRECTIVE;
+                            if (word == "error" || word == "warning") {
+                                state = DIRECTIVE_TEXT;  // 其后是任意文本
+                            }
+                        } else {
+                            directive = NO_DIRECTIVE;
+                            onWord(word);
+                        }
+                        break;
+                    }
+                    case LEX_DIGIT:
+                        atLineStart = false;
+                        stats.numbers++;
+                        p = skipNumber(p, end);
+                        break;
+                    case LEX_DOT:
+                        atLineStart = false;
+                        if (p + 1 < end && lexChars.value[(unsigned char)p[1]] == LEX_DIGIT) {
+                            stats.numbers++;
+                            p = skipNumber(p, end);
+                        } else {
+                            p++;
+                        }
+                        break;
+                    case LEX_QUOTE:
+                        atLineStart = false;
+                        if (directive == DIRECTIVE_HEADER) {
+                            // #include "file.h" 的头文件名
+                            const char* q = p + 1;
+                            while (q < end && *q != '"' && *q != '\n') q++;
+                            p = q < end && *q == '"' ? q + 1 : q;
+                            directive = NO_DIRECTIVE;
+                        } else {
+                            stats.strings++;
+                            state = STRING;
+                            p++;
+                        }
+                        break;
+                    case LEX_APOSTROPHE:
+                        atLineStart = false;
+                        stats.chars++;
+                        state = CHAR;
+                        p++;
+                        break;
+                    case LEX_SLASH:
+                        atLineStart = false;
+                        if (p + 1 < end && p[1] == '/') {
+                            stats.comments++;
+                            state = LINE_COMMENT;
+                            p += 2;
+                        } else if (p + 1 < end && p[1] == '*') {
+                            stats.comments++;
+                            state = BLOCK_COMMENT;
+                            p += 2;
+                        } else {
+                            p++;
+                        }
+                        break;
+                    case LEX_HASH:
+                        if (atLineStart) {
+                            stats.directives++;
+                            directive = DIRECTIVE_NAME;
+                        }
+                        atLineStart = false;
+                        p++;
+                        break;
+                    case LEX_LESS:
+                        atLineStart = false;
+                        if (directive == DIRECTIVE_HEADER) {
+                            // #include <file.h> 的头文件名
+                            const char* q = p + 1;
+                            while (q < end && *q != '>' && *q != '\n') q++;
+                            p = q < end && *q == '>' ? q + 1 : q;
+                            directive = NO_DIRECTIVE;
+                        } else {
+                            p++;
+                        }
+                        break;
+                    case LEX_BACKSLASH:
+                        // 反斜杠续行: 预处理指令延续到下一行
+                        if (p + 1 < end && p[1] == '\n') {
+                            lines++;
+                            p += 2;
+                        } else if (p + 2 < end && p[1] == '\r' && p[2] == '\n') {
+                            lines++;
+                            p += 3;
+                        } else {
+                            atLineStart = false;
+                            p++;
+                        }
+                        break;
+                    default:
+                        atLineStart = false;
+                        p++;
+                        break;
+                    }
+                }
+                break;
+            }
+        }
+        if (begin < end && end[-1] != '\n') {
+            lines++;
+        }
+        return lines;
+    }
+};
+
+// 只读内存映射的文件, 映射后即关闭文件描述符, 大量文件同时映射也不会耗尽描述符
+class MappedFile {
+private:
+    char* addr;
+    size_t length;
+    bool mapped;
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+public:
+    // 只映射普通文件, 管道等设备不打开, 留给调用者按流读取
+    explicit MappedFile(const string& filename) : addr(nullptr), length(0), mapped(false) {
+        struct stat st;
+        if (stat(filename.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+            return;
+        }
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        if (fstat(fd, &st) == 0) {
+            length = st.st_size;
+            if (length == 0) {
+                mapped = true;
+            } else {
+                void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED) {
+                    addr = (char*)p;
+                    mapped = true;
+                    madvise(addr, length, MADV_SEQUENTIAL);
+                } else {
+                    length = 0;
+                }
+            }
+        }
+        close(fd);
+    }
+
+    ~MappedFile() {
+        if (addr != nullptr) munmap(addr, length);
+    }
+
+    // 映射成功(空文件也算成功)
+    bool isOpen() const {
+        return mapped;
+    }
+
+    const char* begin() const { return addr; }
+    const char* end() const { return addr + length; }
+    size_t size() const { return length; }
+};
+
+// 单词哈希: 每次读入 8 个字节做乘法混合
+inline uint64_t hashWord(string_view word) {
+    const uint64_t m = 0x9e3779b97f4a7c15ull;
+    uint64_t h = word.size() * m;
+    size_t i = 0;
+    for (; i + 8 <= word.size(); i += 8) {
+        uint64_t v;
+        memcpy(&v, word.data() + i, 8);
+        h = (h ^ v) * m;
+        h ^= h >> 29;
+    }
+    if (i < word.size()) {
+        uint64_t v = 0;
+        memcpy(&v, word.data() + i, word.size() - i);
+        h = (h ^ v) * m;
+        h ^= h >> 29;
+    }
+    return h * m;
+}
+
+// 字符串内存池: 按块追加分配, 存入的字符串不会移动也不单独释放
+class StringArena {
+private:
+    static const size_t BLOCK_SIZE = 64 << 10;
+    vector<unique_ptr<char[]>> blocks;
+    char* current;
+    size_t remaining;
+    size_t allocated;
+
+public:
+    StringArena() : current(nullptr), remaining(0), allocated(0) {}
+
+    // 复制一份字符串到池中
+    string_view intern(string_view s) {
+        if (s.size() > remaining) {
+            size_t blockSize = max(BLOCK_SIZE, s.size());
+            blocks.emplace_back(new char[blockSize]);
+            current = blocks.back().get();
+            remaining = blockSize;
+            allocated += blockSize;
+        }
+        memcpy(current, s.data(), s.size());
+        string_view stored(current, s.size());
+        current += s.size();
+        remaining -= s.size();
+        return stored;
+    }
+
+    size_t memoryBytes() const {
+        return allocated;
+    }
+
+    // 释放全部字符串
+    void clear() {
+        blocks.clear();
+        current = nullptr;
+        remaining = 0;
+        allocated = 0;
+    }
+};
+
+// 结果文件中的一项, error 只在前 K 模式下可能不为 0
+struct HistogramEntry {
+    string_view word;
+    long long count;
+    long long error;
+};
+
+// 单词计数表: 开放定址 + 线性探测, 槽位连续存放, 键放在 StringArena 中
+// 只在输出时排序一次
+class WordCounter {
+private:
+    struct Slot {
+        const char* key;  // 为空表示空槽
+        uint32_t length;
+        uint32_t hashTag;  // 哈希值高 32 位, 比较字符串之前先比较它
+        int count;
+    };
+    vector<Slot> slots;
+    size_t used;
+    StringArena arena;
+
+    void grow() {
+        vector<Slot> old(slots.size() * 2, Slot{nullptr, 0, 0, 0});
+        old.swap(slots);
+        size_t mask = slots.size() - 1;
+        for (size_t i = 0; i < old.size(); i++) {
+            if (old[i].key == nullptr) continue;
+            uint64_t h = hashWord(string_view(old[i].key, old[i].length));
+            size_t pos = h & mask;
+            while (slots[pos].key != nullptr) pos = (pos + 1) & mask;
+            slots[pos] = old[i];
+        }
+    }
+
+public:
+    WordCounter() : slots(1024, Slot{nullptr, 0, 0, 0}), used(0) {}
+
+    // 计数增加 n, 只有第一次出现的单词才会复制到内存池
+    void add(string_view word, int n = 1) {
+        uint64_t h = hashWord(word);
+        uint32_t tag = (uint32_t)(h >> 32);
+        size_t mask = slots.size() - 1;
+        size_t pos = h & mask;
+        while (slots[pos].key != nullptr) {
+            Slot& slot = slots[pos];
+            if (slot.hashTag == tag && slot.length == word.size() && memcmp(slot.key, word.data(), word.size()) == 0) {
+                slot.count += n;
+                return;
+            }
+            pos = (pos + 1) & mask;
+        }
+        slots[pos] = Slot{arena.intern(word).data(), (uint32_t)word.size(), tag, n};
+        // 装载因子超过 0.7 时扩容
+        if (++used * 10 > slots.size() * 7) {
+            grow();
+        }
+    }
+
+    // 把另一张表的计数加进来
+    void merge(const WordCounter& other) {
+        for (size_t i = 0; i < other.slots.size(); i++) {
+            if (other.slots[i].key != nullptr) {
+                add(string_view(other.slots[i].key, other.slots[i].length), other.slots[i].count);
+            }
+        }
+    }
+
+    size_t size() const {
+        return used;
+    }
+
+    // 按表中顺序遍历 (单词, 计数)
+    template <typename F>
+    void forEach(F&& f) const {
+        for (size_t i = 0; i < slots.size(); i++) {
+            if (slots[i].key != nullptr) {
+                f(string_view(slots[i].key, slots[i].length), slots[i].count);
+            }
+        }
+    }
+
+    // 清空, 表很大时顺便收缩
+    void clear() {
+        if (slots.size() > 4096) {
+            vector<Slot>(1024, Slot{nullptr, 0, 0, 0}).swap(slots);
+        } else {
+            fill(slots.begin(), slots.end(), Slot{nullptr, 0, 0, 0});
+        }
+        used = 0;
+        arena.clear();
+    }
+
+    // 按单词字典序排好的全部计数(增量合并后计数为 0 的单词除外).
+    // 先按单词前 8 个字节组成的整数排序, 前缀相同才比较整个字符串, 大部分比较不用访问内存池
+    vector<HistogramEntry> sorted() const {
+        struct Keyed {
+            uint64_t prefix;  // 按大端序拼成的前 8 个字节, 不足补 0
+            uint32_t slot;
+        };
+        vector<Keyed> keyed;
+        keyed.reserve(used);
+        for (size_t i = 0; i < slots.size(); i++) {
+            if (slots[i].key != nullptr && slots[i].count != 0) {
+                uint64_t prefix = 0;
+                for (uint32_t k = 0; k < 8; k++) {
+                    prefix = (prefix << 8) | (k < slots[i].length ? (unsigned char)slots[i].key[k] : 0);
+                }
+                keyed.push_back(Keyed{prefix, (uint32_t)i});
+            }
+        }
+        sort(keyed.begin(), keyed.end(), [this](const Keyed& a, const Keyed& b) {
+            if (a.prefix != b.prefix) return a.prefix < b.prefix;
+            return string_view(slots[a.slot].key, slots[a.slot].length) < string_view(slots[b.slot].key, slots[b.slot].length);
+        });
+        vector<HistogramEntry> entries(keyed.size());
+        for (size_t i = 0; i < keyed.size(); i++) {
+            const Slot& slot = slots[keyed[i].slot];
+            entries[i] = HistogramEntry{string_view(slot.key, slot.length), slot.count, 0};
+        }
+        return entries;
+    }
+
+    size_t memoryBytes() const {
+        return slots.size() * sizeof(Slot) + arena.memoryBytes();
+    }
+};
+
+// Space-Saving 算法的有界计数表: 最多保存 capacity 个单词, 表满时新单词顶替计数最小的单词,
+// 并把被顶替单词的计数记作新单词的误差. 每个单词的估计值不小于真实值, 多出的部分不超过 总数 / capacity,
+// 因此 capacity = 1 / epsilon 时误差不超过 epsilon * 总数, 内存与输入大小无关
+class SpaceSaving {
+private:
+    struct Counter {
+        string word;
+        long long count;  // 估计值
+        long long error;  // 估计值减去真实值的上界
+        uint32_t slot;  // 在 index 中的位置
+    };
+    struct Slot {
+        int32_t counter;  // heap 下标, -1 为空槽
+        uint32_t hashTag;  // 哈希值高 32 位, 比较字符串之前先比较它
+    };
+    vector<Counter> heap;  // 按 count 排列的最小堆
+    vector<Slot> index;  // 开放寻址哈希表: 单词 -> heap 下标
+    size_t capacity;
+    long long total;  // 已统计的单词总数
+
+    // 单词所在的槽, 不存在时返回应插入的空槽
+    size_t findSlot(string_view word, uint64_t h) const {
+        uint32_t tag = (uint32_t)(h >> 32);
+        size_t mask = index.size() - 1;
+        size_t pos = h & mask;
+        while (index[pos].counter >= 0
+               && (index[pos].hashTag != tag || heap[index[pos].counter].word != word)) {
+            pos = (pos + 1) & mask;
+        }
+        return pos;
+    }
+
+    size_t findSlot(string_view word) const {
+        return findSlot(word, hashWord(word));
+    }
+
+    void place(size_t i, Counter&& counter) {
+        heap[i] = std::move(counter);
+        index[heap[i].slot].counter = (int32_t)i;
+    }
+
+    void siftUp(size_t i) {
+        Counter counter = std::move(heap[i]);
+        while (i > 0 && heap[(i - 1) / 2].count > counter.count) {
+            place(i, std::move(heap[(i - 1) / 2]));
+            i = (i - 1) / 2;
+        }
+        place(i, std::move(counter));
+    }
+
+    void siftDown(size_t i) {
+        // 常见情况是计数增加后仍不大于子节点, 不必移动
+        size_t first = i * 2 + 1;
+        if (first >= heap.size() || (heap[first].count >= heap[i].count
+                                     && (first + 1 >= heap.size() || heap[first + 1].count >= heap[i].count))) {
+            return;
+        }
+        Counter counter = std::move(heap[i]);
+        while (true) {
+            size_t child = i * 2 + 1;
+            if (child >= heap.size()) break;
+            if (child + 1 < heap.size() && heap[child + 1].count < heap[child].count) child++;
+            if (heap[child].count >= counter.count) break;
+            place(i, std::move(heap[child]));
+            i = child;
+        }
+        place(i, std::move(counter));
+    }
+
+    // 线性探测表的删除: 把后面同一探测链上的元素前移填补空位
+    void eraseSlot(size_t pos) {
+        size_t mask = index.size() - 1;
+        index[pos].counter = -1;
+        for (size_t next = (pos + 1) & mask; index[next].counter >= 0; next = (next + 1) & mask) {
+            size_t home = hashWord(heap[index[next].counter].word) & mask;
+            // home 不在 (pos, next] 之间时, 元素可以移到 pos
+            if (((next - home) & mask) >= ((next - pos) & mask)) {
+                index[pos] = index[next];
+                heap[index[pos].counter].slot = (uint32_t)pos;
+                index[next].counter = -1;
+                pos = next;
+            }
+        }
+    }
+
+    void rebuildIndex() {
+        fill(index.begin(), index.end(), Slot{-1, 0});
+        for (size_t i = 0; i < heap.size(); i++) {
+            uint64_t h = hashWord(heap[i].word);
+            size_t pos = findSlot(heap[i].word, h);
+            heap[i].slot = (uint32_t)pos;
+            index[pos] = Slot{(int32_t)i, (uint32_t)(h >> 32)};
+        }
+    }
+
+public:
+    explicit SpaceSaving(size_t n = 0) : capacity(0), total(0) {
+        setCapacity(n);
+    }
+
+    // 设置容量并清空, 容量为 0 表示不使用
+    void setCapacity(size_t n) {
+        capacity = n;
+        size_t slots = 16;
+        while (slots < capacity * 2) slots *= 2;
+        heap.clear();
+        heap.reserve(capacity);
+        index.assign(capacity > 0 ? slots : 0, Slot{-1, 0});
+        total = 0;
+    }
+
+    bool enabled() const {
+        return capacity > 0;
+    }
+
+    void clear() {
+        heap.clear();
+        fill(index.begin(), index.end(), Slot{-1, 0});
+        total = 0;
+    }
+
+    void add(string_view word, long long n = 1) {
+        total += n;
+        uint64_t h = hashWord(word);
+        size_t pos = findSlot(word, h);
+        if (index[pos].counter >= 0) {
+            size_t i = index[pos].counter;
+            heap[i].count += n;
+            siftDown(i);
+            return;
+        }
+        if (heap.size() < capacity) {
+            heap.push_back(Counter{string(word), n, 0, (uint32_t)pos});
+            index[pos] = Slot{(int32_t)(heap.size() - 1), (uint32_t)(h >> 32)};
+            siftUp(heap.size() - 1);
+            return;
+        }
+        // 表满: 顶替计数最小的单词
+        eraseSlot(heap[0].slot);
+        pos = findSlot(word, h);
+        heap[0].word.assign(word.data(), word.size());
+        heap[0].error = heap[0].count;
+        heap[0].count += n;
+        heap[0].slot = (uint32_t)pos;
+        index[pos] = Slot{0, (uint32_t)(h >> 32)};
+        siftDown(0);
+    }
+
+    // 表满时未被记录的单词真实计数可能达到的上界, 也是所有估计值误差的上界
+    long long minCount() const {
+        return heap.size() < capacity || heap.empty() ? 0 : heap[0].count;
+    }
+
+    long long totalCount() const {
+        return total;
+    }
+
+    // 合并另一张表: 一方没有记录的单词按该方的 minCount 计入, 再保留计数最大的 capacity 个,
+    // 合并后误差仍不超过两边总数之和 / capacity
+    void merge(const SpaceSaving& other) {
+        if (other.total == 0) return;
+        long long minThis = minCount(), minOther = other.minCount();
+        vector<Counter> merged;
+        merged.reserve(heap.size() + other.heap.size());
+        // 先取出只在对方表中的单词, 之后本表的单词会被移走
+        for (size_t i = 0; i < other.heap.size(); i++) {
+            if (index.empty() || index[findSlot(other.heap[i].word)].counter < 0) {
+                const Counter& c = other.heap[i];
+                merged.push_back(Counter{c.word, c.count + minThis, c.error + minThis, 0});
+            }
+        }
+        for (size_t i = 0; i < heap.size(); i++) {
+            int32_t j = other.index.empty() ? -1 : other.index[other.findSlot(heap[i].word)].counter;
+            long long count = j >= 0 ? other.heap[j].count : minOther;
+            long long error = j >= 0 ? other.heap[j].error : minOther;
+            merged.push_back(Counter{std::move(heap[i].word), heap[i].count + count, heap[i].error + error, 0});
+        }
+        if (merged.size() > capacity) {
+            nth_element(merged.begin(), merged.begin() + capacity, merged.end(),
+                        [](const Counter& a, const Counter& b) { return a.count > b.count; });
+            merged.resize(capacity);
+        }
+        heap = std::move(merged);
+        make_heap(heap.begin(), heap.end(), [](const Counter& a, const Counter& b) { return a.count > b.count; });
+        rebuildIndex();
+        total += other.total;
+    }
+
+    // 计数最大的 k 个单词, 按计数从大到小, 计数相同按字典序
+    vector<HistogramEntry> top(size_t k) const {
+        vector<HistogramEntry> entries;
+        for (size_t i = 0; i < heap.size(); i++) {
+            entries.push_back(HistogramEntry{heap[i].word, heap[i].count, heap[i].error});
+        }
+        sort(entries.begin(), entries.end(), [](const HistogramEntry& a, const HistogramEntry& b) {
+            return a.count != b.count ? a.count > b.count : a.word < b.word;
+        });
+        if (entries.size() > k) entries.resize(k);
+        return entries;
+    }
+
+    size_t memoryBytes() const {
+        size_t bytes = heap.capacity() * sizeof(Counter) + index.size() * sizeof(Slot);
+        for (size_t i = 0; i < heap.size(); i++) {
+            if (heap[i].word.capacity() > 15) bytes += heap[i].word.capacity() + 1;
+        }
+        return bytes;
+    }
+};
+
+// 一组计数结果, 并行分析时每个工作线程各持有一份, 结束后合并
+struct WordCounts {
+    vector<int> keywordCount;  // 保留字计数, 下标与 KeywordAnalyzer::keywords 一致
+    WordCounter nonKeywordCount;  // 非保留字计数
+    SpaceSaving topNonKeywords;  // 前 K 模式下代替 nonKeywordCount 的有界计数表
+    int scanCount = 0;  // 扫描次数
+    LexerCounts lexerCounts;  // 词法分析模式下的注释和字面量计数
+
+    // 清空计数, 保留字计数置为 keywordNum 个 0
+    void clear(size_t keywordNum) {
+        keywordCount.assign(keywordNum, 0);
+        nonKeywordCount.clear();
+        topNonKeywords.clear();
+        scanCount = 0;
+        lexerCounts = LexerCounts();
+    }
+
+    void merge(const WordCounts& other) {
+        keywordCount.resize(max(keywordCount.size(), other.keywordCount.size()));
+        for (size_t i = 0; i < other.keywordCount.size(); i++) {
+            keywordCount[i] += other.keywordCount[i];
+        }
+        nonKeywordCount.merge(other.nonKeywordCount);
+        topNonKeywords.merge(other.topNonKeywords);
+        scanCount += other.scanCount;
+        lexerCounts.merge(other.lexerCounts);
+    }
+};
+
+// 工作窃取线程池: 任务先轮流分到各线程的队列, 线程从自己队列尾部取任务,
+// 自己的队列空了再从其他线程队列的头部窃取
+class WorkStealingPool {
+private:
+    struct TaskQueue {
+        mutex lock;
+        deque<size_t> tasks;
+    };
+    vector<unique_ptr<TaskQueue>> queues;
+
+    bool popLocal(int worker, size_t& task) {
+        TaskQueue& q = *queues[worker];
+        lock_guard<mutex> guard(q.lock);
+        if (q.tasks.empty()) return false;
+        task = q.tasks.back();
+        q.tasks.pop_back();
+        return true;
+    }
+
+    bool steal(int worker, size_t& task) {
+        for (size_t i = 1; i < queues.size(); i++) {
+            TaskQueue& q = *queues[(worker + i) % queues.size()];
+            lock_guard<mutex> guard(q.lock);
+            if (!q.tasks.empty()) {
+                task = q.tasks.front();
+                q.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+public:
+    explicit WorkStealingPool(int threadNum) {
+        for (int i = 0; i < threadNum; i++) {
+            queues.emplace_back(new TaskQueue());
+        }
+    }
+
+    // 执行编号为 0..taskNum-1 的任务, work(task, worker) 中 worker 为线程编号
+    template <typename F>
+    void run(size_t taskNum, F&& work) {
+        for (size_t t = 0; t < taskNum; t++) {
+            queues[t % queues.size()]->tasks.push_back(t);
+        }
+        vector<thread> threads;
+        for (int w = 0; w < (int)queues.size(); w++) {
+            threads.emplace_back([this, &work, w]() {
+                size_t task;
+                while (popLocal(w, task) || steal(w, task)) {
+                    work(task, w);
+                }
+            });
+        }
+        for (size_t i = 0; i < threads.size(); i++) {
+            threads[i].join();
+        }
+    }
+};
+
+// 目录中参与分析的源文件后缀
+const char* const SOURCE_EXTENSIONS[] = {".c", ".cc", ".cpp", ".cxx", ".c++", ".h", ".hh", ".hpp", ".hxx", ".inl", ".ipp", ".tcc"};
+
+// 展开输入: 文件原样保留, 目录递归查找 C/C++ 源文件(跳过隐藏目录), 结果排序保证顺序稳定
+vector<string> collectSourceFiles(const vector<string>& inputs) {
+    namespace fs = std::filesystem;
+    vector<string> files;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        error_code ec;
+        if (!fs::is_directory(inputs[i], ec)) {
+            files.push_back(inputs[i]);
+            continue;
+        }
+        vector<string> found;
+        fs::recursive_directory_iterator it(inputs[i], fs::directory_options::skip_permission_denied, ec), last;
+        for (; it != last; it.increment(ec)) {
+            string name = it->path().filename().string();
+            if (name.size() > 1 && name[0] == '.') {
+                if (it->is_directory(ec)) it.disable_recursion_pending();
+                continue;
+            }
+            if (!it->is_regular_file(ec)) continue;
+            string ext = it->path().extension().string();
+            for (size_t k = 0; k < sizeof(SOURCE_EXTENSIONS) / sizeof(SOURCE_EXTENSIONS[0]); k++) {
+                if (ext == SOURCE_EXTENSIONS[k]) {
+                    found.push_back(it->path().string());
+                    break;
+                }
+            }
+        }
+        sort(found.begin(), found.end());
+        files.insert(files.end(), found.begin(), found.end());
+    }
+    return files;
+}
+
+// 并行分析的一个任务: 整个文件, 或大文件中以换行结尾的一段
+struct ScanTask {
+    string path;
+    shared_ptr<MappedFile> file;  // 切块的大文件由各块共享同一个映射, 为空时由工作线程自己打开
+    size_t begin, end;
+};
+
+const size_t CHUNK_SIZE = 16 << 20;  // 超过该大小的文件切块
+const size_t STREAM_CHUNK_SIZE = 1 << 20;  // 无法映射的输入每次读取的字节数
+
+// 生成任务, 大任务排在前面, 便于各线程负载均衡.
+// 词法分析模式下块注释等状态跨行, 不能从文件中间开始分析, 因此不切块
+vector<ScanTask> planScanTasks(const vector<string>& files, bool splitLargeFiles) {
+    vector<ScanTask> tasks;
+    for (size_t i = 0; i < files.size(); i++) {
+        struct stat st;
+        if (stat(files[i].c_str(), &st) != 0) {
+            cerr << "无法打开文件: " << files[i] << endl;
+            continue;
+        }
+        if (!S_ISREG(st.st_mode) || (size_t)st.st_size <= CHUNK_SIZE || !splitLargeFiles) {
+            tasks.push_back({files[i], nullptr, 0, S_ISREG(st.st_mode) ? (size_t)st.st_size : 0});
+            continue;
+        }
+        shared_ptr<MappedFile> file = make_shared<MappedFile>(files[i]);
+        if (!file->isOpen()) {
+            // 映射失败时不切块, 整个文件作为一个任务, 由工作线程按流读取
+            tasks.push_back({files[i], nullptr, 0, (size_t)st.st_size});
+            continue;
+        }
+        size_t pos = 0;
+        while (pos < file->size()) {
+            size_t next = pos + CHUNK_SIZE;
+            if (next >= file->size()) {
+                next = file->size();
+            } else {
+                const char* newline = (const char*)memchr(file->begin() + next, '\n', file->size() - next);
+                next = newline != nullptr ? newline - file->begin() + 1 : file->size();
+            }
+            tasks.push_back({files[i], file, pos, next});
+            pos = next;
+        }
+    }
+    stable_sort(tasks.begin(), tasks.end(), [](const ScanTask& a, const ScanTask& b) {
+        return a.end - a.begin > b.end - b.begin;
+    });
+    return tasks;
+}
+
+// 文件内容哈希: 4 路并行的 8 字节乘法混合, 用于判断文件是否改动
+inline uint64_t hashContent(const char* data, size_t size) {
+    const uint64_t m = 0x9e3779b97f4a7c15ull;
+    uint64_t lane[4] = {size, size ^ 0x243f6a8885a308d3ull, size ^ 0x13198a2e03707344ull, size ^ 0xa4093822299f31d0ull};
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        for (int k = 0; k < 4; k++) {
+            uint64_t v;
+            memcpy(&v, data + i + 8 * k, 8);
+            lane[k] = (lane[k] ^ v) * m;
+            lane[k] ^= lane[k] >> 31;
+        }
+    }
+    uint64_t h = lane[0] ^ (lane[1] * 3) ^ (lane[2] * 5) ^ (lane[3] * 7);
+    for (; i < size; i += 8) {
+        uint64_t v = 0;
+        memcpy(&v, data + i, min<size_t>(8, size - i));
+        h = (h ^ v) * m;
+        h ^= h >> 31;
+    }
+    return h * m;
+}
+
+// 增量分析缓存文件头, 其后是上一次分析的汇总记录(路径为空), 再后是 recordNum 条文件记录
+struct CacheFileHeader {
+    char magic[8];  // "KWCACHE"
+    uint32_t version;
+    uint32_t flags;  // CACHE_LEXER_MODE 等
+    uint64_t keywordsHash;  // 保留字表的哈希, 保留字文件改动后整个缓存失效
+    uint32_t keywordNum;
+    uint32_t recordNum;
+};
+
+// 每个文件一条记录, 8 字节对齐, 可以直接在映射的内存上读取.
+// 记录头之后依次是 int32 保留字计数[keywordNum]、路径、
+// identifierNum 个 {uint32 计数, uint32 长度, 字符}
+struct CacheRecordHeader {
+    uint32_t recordSize;  // 整条记录的字节数
+    uint32_t pathLength;
+    uint64_t fileSize;
+    int64_t mtime;  // 修改时间, 纳秒
+    uint64_t contentHash;
+    int64_t scanCount;
+    int64_t lexerCounts[5];
+    uint32_t keywordNum;
+    uint32_t identifierNum;
+};
+
+const char CACHE_MAGIC[8] = {'K', 'W', 'C', 'A', 'C', 'H', 'E', 0};
+const uint32_t CACHE_VERSION = 1;
+const uint32_t CACHE_LEXER_MODE = 1;
+
+inline int64_t modifyTimeNs(const struct stat& st) {
+    return (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+// 增量分析缓存: 按路径保存每个文件的保留字和标识符直方图, 并记录文件大小、修改时间和内容哈希.
+// 大小和修改时间都没变时直接使用缓存, 否则重新计算内容哈希, 哈希也变了才重新分析.
+// 另存一份上一次的汇总结果, 再次运行时只需从汇总中减去改动文件的旧直方图、加上新直方图
+class AnalysisCache {
+private:
+    unique_ptr<MappedFile> file;
+    const char* totals;  // 上一次的汇总记录
+    unordered_map<string_view, const char*> records;  // 路径 -> 记录
+    CacheFileHeader expected;
+
+    static CacheRecordHeader readHeader(const char* record) {
+        CacheRecordHeader header;
+        memcpy(&header, record, sizeof(header));
+        return header;
+    }
+
+    // 检查 p 处的记录是否完整, 返回记录长度, 不完整时返回 0
+    size_t checkRecord(const char* p) const {
+        if ((size_t)(file->end() - p) < sizeof(CacheRecordHeader)) {
+            return 0;
+        }
+        CacheRecordHeader record = readHeader(p);
+        size_t pathOffset = sizeof(CacheRecordHeader) + record.keywordNum * sizeof(int32_t);
+        if (record.recordSize < pathOffset + record.pathLength || record.recordSize > (size_t)(file->end() - p)
+            || record.keywordNum != expected.keywordNum) {
+            return 0;
+        }
+        return record.recordSize;
+    }
+
+public:
+    AnalysisCache(uint64_t keywordsHash, uint32_t keywordNum, uint32_t flags) : totals(nullptr) {
+        memcpy(expected.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        expected.version = CACHE_VERSION;
+        expected.flags = flags;
+        expected.keywordsHash = keywordsHash;
+        expected.keywordNum = keywordNum;
+        expected.recordNum = 0;
+    }
+
+    // 读入缓存文件, 文件头与当前保留字表或模式不符时忽略整个文件
+    void load(const string& path) {
+        file.reset(new MappedFile(path));
+        if (!file->isOpen() || file->size() < sizeof(CacheFileHeader)) {
+            return;
+        }
+        CacheFileHeader header;
+        memcpy(&header, file->begin(), sizeof(header));
+        if (memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.version != expected.version
+            || header.flags != expected.flags || header.keywordsHash != expected.keywordsHash
+            || header.keywordNum != expected.keywordNum) {
+            return;
+        }
+        const char* p = file->begin() + sizeof(CacheFileHeader);
+        size_t size = checkRecord(p);
+        if (size == 0) {
+            return;
+        }
+        totals = p;
+        p += size;
+        for (uint32_t i = 0; i < header.recordNum; i++) {
+            size = checkRecord(p);
+            if (size == 0) {
+                // 文件记录不完整时汇总结果也不可信
+                totals = nullptr;
+                records.clear();
+                return;
+            }
+            CacheRecordHeader record = readHeader(p);
+            size_t pathOffset = sizeof(CacheRecordHeader) + record.keywordNum * sizeof(int32_t);
+            records[string_view(p + pathOffset, record.pathLength)] = p;
+            p += size;
+        }
+    }
+
+    // 上一次的汇总结果, 缓存无效时为空
+    const char* getTotals() const {
+        return totals;
+    }
+
+    // path 上一次的记录, 没有时为空
+    const char* find(const string& path) const {
+        auto it = records.find(path);
+        return it != records.end() ? it->second : nullptr;
+    }
+
+    // 所有记录的路径
+    vector<string_view> paths() const {
+        vector<string_view> result;
+        for (auto it = records.begin(); it != records.end(); ++it) {
+            result.push_back(it->first);
+        }
+        return result;
+    }
+
+    size_t size() const {
+        return records.size();
+    }
+
+    // 文件是否未改动, 未改动时把记录复制到 out (更新修改时间).
+    // contentHash 为空时只比较大小和修改时间, 不一致时调用者读入文件后带上内容哈希再判断一次
+    static bool unchanged(const char* record, const struct stat& st, const uint64_t* contentHash, vector<char>& out) {
+        CacheRecordHeader header = readHeader(record);
+        if (header.fileSize != (uint64_t)st.st_size) {
+            return false;
+        }
+        if (contentHash == nullptr ? header.mtime != modifyTimeNs(st) : header.contentHash != *contentHash) {
+            return false;
+        }
+        out.assign(record, record + header.recordSize);
+        header.mtime = modifyTimeNs(st);
+        memcpy(out.data(), &header, sizeof(header));
+        return true;
+    }
+
+    // 把计数序列化为缓存记录, 计数为 0 的标识符不保存
+    static vector<char> makeRecord(const string& path, uint64_t fileSize, int64_t mtime, uint64_t contentHash,
+                                   const WordCounts& counts) {
+        CacheRecordHeader header;
+        header.recordSize = 0;
+        header.pathLength = (uint32_t)path.size();
+        header.fileSize = fileSize;
+        header.mtime = mtime;
+        header.contentHash = contentHash;
+        header.scanCount = counts.scanCount;
+        header.lexerCounts[0] = counts.lexerCounts.comments;
+        header.lexerCounts[1] = counts.lexerCounts.strings;
+        header.lexerCounts[2] = counts.lexerCounts.chars;
+        header.lexerCounts[3] = counts.lexerCounts.numbers;
+        header.lexerCounts[4] = counts.lexerCounts.directives;
+        header.keywordNum = (uint32_t)counts.keywordCount.size();
+        header.identifierNum = 0;
+
+        vector<char> record(sizeof(header));
+        for (size_t i = 0; i < counts.keywordCount.size(); i++) {
+            int32_t count = counts.keywordCount[i];
+            record.insert(record.end(), (const char*)&count, (const char*)&count + sizeof(count));
+        }
+        record.insert(record.end(), path.begin(), path.end());
+        counts.nonKeywordCount.forEach([&record, &header](string_view word, int count) {
+            if (count == 0) return;
+            header.identifierNum++;
+            uint32_t entry[2] = {(uint32_t)count, (uint32_t)word.size()};
+            record.insert(record.end(), (const char*)entry, (const char*)entry + sizeof(entry));
+            record.insert(record.end(), word.begin(), word.end());
+        });
+        record.resize((record.size() + 7) & ~(size_t)7);
+        header.recordSize = (uint32_t)record.size();
+        memcpy(record.data(), &header, sizeof(header));
+        return record;
+    }
+
+    // 把记录中的计数乘以 sign (1 或 -1) 后加到 counts 中
+    static void mergeRecord(const char* record, WordCounts& counts, int sign = 1) {
+        CacheRecordHeader header = readHeader(record);
+        const char* p = record + sizeof(header);
+        counts.keywordCount.resize(max<size_t>(counts.keywordCount.size(), header.keywordNum));
+        for (uint32_t i = 0; i < header.keywordNum; i++, p += sizeof(int32_t)) {
+            int32_t count;
+            memcpy(&count, p, sizeof(count));
+            counts.keywordCount[i] += sign * count;
+        }
+        p += header.pathLength;
+        for (uint32_t i = 0; i < header.identifierNum; i++) {
+            uint32_t entry[2];
+            memcpy(entry, p, sizeof(entry));
+            counts.nonKeywordCount.add(string_view(p + sizeof(entry), entry[1]), sign * (int)entry[0]);
+            p += sizeof(entry) + entry[1];
+        }
+        counts.scanCount += sign * (int)header.scanCount;
+        counts.lexerCounts.comments += sign * header.lexerCounts[0];
+        counts.lexerCounts.strings += sign * header.lexerCounts[1];
+        counts.lexerCounts.chars += sign * header.lexerCounts[2];
+        counts.lexerCounts.numbers += sign * header.lexerCounts[3];
+        counts.lexerCounts.directives += sign * header.lexerCounts[4];
+    }
+
+    // 写出新的缓存文件: 先写临时文件再改名, 中途失败不会破坏旧缓存
+    void save(const string& path, const WordCounts& newTotals, const vector<vector<char>>& newRecords) {
+        CacheFileHeader header = expected;
+        for (size_t i = 0; i < newRecords.size(); i++) {
+            if (!newRecords[i].empty()) header.recordNum++;
+        }
+        vector<char> totalsRecord = makeRecord("", 0, 0, 0, newTotals);
+        string tempPath = path + ".tmp";
+        ofstream out(tempPath.c_str(), ios::binary);
+        out.write((const char*)&header, sizeof(header));
+        out.write(totalsRecord.data(), totalsRecord.size());
+        for (size_t i = 0; i < newRecords.size(); i++) {
+            out.write(newRecords[i].data(), newRecords[i].size());
+        }
+        out.close();
+        file.reset();
+        totals = nullptr;
+        records.clear();
+        if (!out || rename(tempPath.c_str(), path.c_str()) != 0) {
+            cerr << "无法写入缓存文件: " << path << endl;
+            remove(tempPath.c_str());
+        }
+    }
+};
+
+// 结果文件格式
+enum OutputFormat { FORMAT_TEXT, FORMAT_CSV, FORMAT_JSON, FORMAT_BINARY };
+
+// 按名字取格式, 无法识别时返回 false
+bool parseOutputFormat(const string& name, OutputFormat& format) {
+    static const char* const names[] = {"text", "csv", "json", "binary"};
+    for (int i = 0; i < 4; i++) {
+        if (name == names[i]) {
+            format = (OutputFormat)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// 各格式的默认扩展名
+const char* outputExtension(OutputFormat format) {
+    static const char* const extensions[] = {".txt", ".csv", ".json", ".bin"};
+    return extensions[format];
+}
+
+// 二进制直方图文件头, 其后是 entryNum 个 HistogramRecord, 再后是所有单词首尾相接的字符串区.
+// 所有字段按自然对齐, 下游程序可以直接 mmap 后按数组访问
+struct HistogramFileHeader {
+    char magic[8];  // "KWHIST"
+    uint32_t version;
+    uint32_t flags;  // HISTOGRAM_BY_COUNT: 按计数从大到小排列, 否则按单词字典序
+    uint64_t entryNum;
+    uint64_t stringBytes;
+};
+
+struct HistogramRecord {
+    uint32_t offset;  // 单词在字符串区中的偏移
+    uint32_t length;
+    int64_t count;
+    int64_t error;
+};
+
+const uint32_t HISTOGRAM_VERSION = 1;
+const uint32_t HISTOGRAM_BY_COUNT = 1;
+
+// 带缓冲的输出: 内容先格式化到 1 MB 的缓冲区, 满了才调用一次 write
+class BufferedWriter {
+private:
+    int fd;
+    vector<char> buffer;
+    size_t used;
+    bool failed;
+
+public:
+    explicit BufferedWriter(const string& path) : buffer(1 << 20), used(0), failed(false) {
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        failed = fd < 0;
+    }
+
+    ~BufferedWriter() {
+        close();
+    }
+
+    void write(const char* data, size_t size) {
+        if (used + size > buffer.size()) {
+            flush();
+            if (size > buffer.size()) {
+                writeAll(data, size);
+                return;
+            }
+        }
+        memcpy(buffer.data() + used, data, size);
+        used += size;
+    }
+
+    void write(string_view text) {
+        write(text.data(), text.size());
+    }
+
+    // 整数直接格式化进缓冲区
+    void writeInt(long long value) {
+        if (used + 24 > buffer.size()) flush();
+        used = std::to_chars(buffer.data() + used, buffer.data() + buffer.size(), value).ptr - buffer.data();
+    }
+
+    void flush() {
+        writeAll(buffer.data(), used);
+        used = 0;
+    }
+
+    // 写完剩余内容并关闭, 返回是否全部写成功
+    bool close() {
+        if (fd >= 0) {
+            flush();
+            failed |= ::close(fd) != 0;
+            fd = -1;
+        }
+        return !failed;
+    }
+
+private:
+    void writeAll(const char* data, size_t size) {
+        while (size > 0 && !failed) {
+            ssize_t n = ::write(fd, data, size);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                failed = true;
+                break;
+            }
+            data += n;
+            size -= n;
+        }
+    }
+};
+
+// 按指定格式写出一张直方图. 文本格式第一行是 title, 每行 "单词: 计数";
+// 单词只含字母、数字和下划线, CSV 和 JSON 不需要转义
+bool writeHistogram(const string& path, OutputFormat format, string_view title,
+                    const vector<HistogramEntry>& entries, bool byCount) {
+    BufferedWriter out(path);
+    switch (format) {
+    case FORMAT_TEXT:
+        out.write(title);
+        out.write("\n");
+        for (size_t i = 0; i < entries.size(); i++) {
+            out.write(entries[i].word);
+            out.write(": ");
+            out.writeInt(entries[i].count);
+            if (entries[i].error > 0) {
+                out.write(" (误差 <= ");
+                out.writeInt(entries[i].error);
+                out.write(")");
+            }
+            out.write("\n");
+        }
+        break;
+    case FORMAT_CSV:
+        out.write(byCount ? "word,count,error\n" : "word,count\n");
+        for (size_t i = 0; i < entries.size(); i++) {
+            out.write(entries[i].word);
+            out.write(",");
+            out.writeInt(entries[i].count);
+            if (byCount) {
+                out.write(",");
+                out.writeInt(entries[i].error);
+            }
+            out.write("\n");
+        }
+        break;
+    case FORMAT_JSON:
+        out.write("[");
+        for (size_t i = 0; i < entries.size(); i++) {
+            out.write(i == 0 ? "\n{\"word\":\"" : ",\n{\"word\":\"");
+            out.write(entries[i].word);
+            out.write("\",\"count\":");
+            out.writeInt(entries[i].count);
+            if (byCount) {
+                out.write(",\"error\":");
+                out.writeInt(entries[i].error);
+            }
+            out.write("}");
+        }
+        out.write("\n]\n");
+        break;
+    case FORMAT_BINARY: {
+        HistogramFileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "KWHIST", 6);
+        header.version = HISTOGRAM_VERSION;
+        header.flags = byCount ? HISTOGRAM_BY_COUNT : 0;
+        header.entryNum = entries.size();
+        for (size_t i = 0; i < entries.size(); i++) {
+            header.stringBytes += entries[i].word.size();
+        }
+        out.write((const char*)&header, sizeof(header));
+        uint32_t offset = 0;
+        for (size_t i = 0; i < entries.size(); i++) {
+            HistogramRecord record = {offset, (uint32_t)entries[i].word.size(), entries[i].count, entries[i].error};
+            out.write((const char*)&record, sizeof(record));
+            offset += record.length;
+        }
+        for (size_t i = 0; i < entries.size(); i++) {
+            out.write(entries[i].word);
+        }
+        break;
+    }
+    }
+    return out.close();
+}
+
+// 有序样本的百分位数(最近秩法)
+double percentile(const vector<double>& sorted, double q) {
+    if (sorted.empty()) return 0;
+    size_t rank = (size_t)ceil(q * sorted.size());
+    return sorted[min(sorted.size(), max<size_t>(rank, 1)) - 1];
+}
+
 class KeywordAnalyzer {
 private:
     vector<string> keywords;  // 保存保留字
-    map<string, int> keywordCount;  // 保留字计数
-    map<string, int> nonKeywordCount;  // 非保留字计数
-    int scanCount;  // 扫描次数
+    WordCounts counts;  // 计数结果
+    bool lexerMode;  // 词法分析模式: 不统计注释和字面量中的单词
+    string cachePath;  // 增量分析缓存文件, 为空时不使用缓存
+    size_t cacheHits;  // 上一次分析中直接使用缓存的文件数
+    size_t topK;  // 大于 0 时只输出出现次数最多的 topK 个非保留字, 内存有界
+    size_t topCapacity;  // 前 K 模式下计数表的容量
+    OutputFormat outputFormat;  // 结果文件格式
+    string keywordOutput;  // 保留字结果文件, 为空时按格式取默认文件名
+    string nonKeywordOutput;  // 非保留字结果文件
+    bool useBuiltinTable;  // 保留字文件与内置表一致时使用编译期完美哈希
+    int builtinToKeyword[BUILTIN_KEYWORD_NUM];  // 内置表下标 -> keywords 下标
+    unordered_map<string_view, int> keywordIndex;  // 自定义保留字文件时运行期建立的哈希表
+
+    // 查找保留字, 返回在 keywords 中第一次出现的下标, 不是保留字时返回 -1
+    int keywordId(string_view word) const {
+        if (useBuiltinTable) {
+            int index = findBuiltinKeyword(word);
+            return index >= 0 ? builtinToKeyword[index] : -1;
+        }
+        auto it = keywordIndex.find(word);
+        return it != keywordIndex.end() ? it->second : -1;
+    }
 
     // 判断字符串是否为保留字
-    bool isKeyword(const string& word) {
-        return find(keywords.begin(), keywords.end(), word) != keywords.end();
+    bool isKeyword(string_view word) const {
+        return keywordId(word) >= 0;
+    }
+
+    // 根据已加载的保留字选择查找方式
+    void buildKeywordIndex() {
+        keywordIndex.clear();
+        for (size_t i = 0; i < keywords.size(); i++) {
+            keywordIndex.emplace(keywords[i], (int)i);
+        }
+        useBuiltinTable = keywordIndex.size() == BUILTIN_KEYWORD_NUM;
+        for (auto it = keywordIndex.begin(); it != keywordIndex.end() && useBuiltinTable; ++it) {
+            int index = findBuiltinKeyword(it->first);
+            useBuiltinTable = index >= 0;
+            if (useBuiltinTable) builtinToKeyword[index] = it->second;
+        }
+    }
+
+    // 统计一个单词
+    void addWord(WordCounts& target, string_view word) const {
+        int id = keywordId(word);
+        if (id >= 0) {
+            target.keywordCount[id]++;
+        } else if (topK > 0) {
+            target.topNonKeywords.add(word);
+        } else {
+            target.nonKeywordCount.add(word);
+        }
+    }
+
+    // 统计一段内存中的单词
+    void countBuffer(WordCounts& target, const char* begin, const char* end) const {
+        auto onWord = [this, &target](string_view word) {
+            addWord(target, word);
+        };
+        if (lexerMode) {
+            CppLexer lexer;
+            target.scanCount += lexer.lex(begin, end, target.lexerCounts, onWord);
+        } else {
+            target.scanCount += forEachWord(begin, end, onWord);
+        }
+    }
+
+    // 分块读取无法映射的输入(管道、标准输入等). 每块截到最后一个换行为止, 剩下的半行留到下一块,
+    // 词法分析器的状态在块之间延续, 因此结果与整个文件一次分析相同. 内存只取决于块大小和最长的一行
+    void countStream(WordCounts& target, int fd) const {
+        vector<char> buffer(STREAM_CHUNK_SIZE);
+        size_t pending = 0;  // 缓冲区开头不完整的一行
+        CppLexer lexer;
+        auto onWord = [this, &target](string_view word) {
+            addWord(target, word);
+        };
+        auto countLines = [&](const char* begin, const char* end) {
+            if (lexerMode) {
+                target.scanCount += lexer.lex(begin, end, target.lexerCounts, onWord);
+            } else {
+                target.scanCount += forEachWord(begin, end, onWord);
+            }
+        };
+        while (true) {
+            if (pending == buffer.size()) {
+                buffer.resize(buffer.size() * 2);  // 一行比缓冲区还长
+            }
+            ssize_t n = read(fd, buffer.data() + pending, buffer.size() - pending);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            char* begin = buffer.data();
+            char* filled = begin + pending + n;
+            char* lineEnd = filled;
+            while (lineEnd > begin + pending && lineEnd[-1] != '\n') lineEnd--;
+            if (lineEnd == begin + pending) {
+                pending += n;
+                continue;
+            }
+            countLines(begin, lineEnd);
+            pending = filled - lineEnd;
+            memmove(begin, lineEnd, pending);
+        }
+        countLines(buffer.data(), buffer.data() + pending);
+    }
+
+    // 统计无法映射的文件, "-" 表示标准输入
+    void countUnmapped(WordCounts& target, const string& filename) const {
+        if (filename == "-") {
+            countStream(target, STDIN_FILENO);
+            return;
+        }
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd >= 0) {
+            countStream(target, fd);
+            close(fd);
+        }
+    }
+
+    // 执行一个并行任务
+    void runTask(const ScanTask& task, WordCounts& target) const {
+        if (task.file != nullptr) {
+            countBuffer(target, task.file->begin() + task.begin, task.file->begin() + task.end);
+            return;
+        }
+        MappedFile mapped(task.path);
+        if (mapped.isOpen()) {
+            countBuffer(target, mapped.begin(), mapped.end());
+        } else {
+            countUnmapped(target, task.path);
+        }
+    }
+
+    // 带缓存执行一个整文件任务. 有上一次的汇总时 target 只累计变化量:
+    // 未改动的文件什么都不做, 改动的文件减去旧直方图、加上新直方图; 没有汇总时累计全部直方图.
+    // 管道等非普通文件和无法映射的文件没有记录, 计入 uncached, 不进入保存的汇总, 每次运行都重新统计
+    void runCachedTask(const ScanTask& task, const AnalysisCache& cache, vector<char>& record,
+                       WordCounts& scratch, WordCounts& target, WordCounts& uncached, size_t& hits) const {
+        struct stat st;
+        const char* old = cache.find(task.path);
+        bool haveTotals = cache.getTotals() != nullptr;
+        if (stat(task.path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+            if (old != nullptr && haveTotals) AnalysisCache::mergeRecord(old, target, -1);
+            runTask(task, uncached);
+            return;
+        }
+        if (old != nullptr && AnalysisCache::unchanged(old, st, nullptr, record)) {
+            if (!haveTotals) AnalysisCache::mergeRecord(old, target);
+            hits++;
+            return;
+        }
+        MappedFile mapped(task.path);
+        if (!mapped.isOpen()) {
+            if (old != nullptr && haveTotals) AnalysisCache::mergeRecord(old, target, -1);
+            runTask(task, uncached);
+            return;
+        }
+        uint64_t contentHash = hashContent(mapped.begin(), mapped.size());
+        if (old != nullptr && AnalysisCache::unchanged(old, st, &contentHash, record)) {
+            if (!haveTotals) AnalysisCache::mergeRecord(old, target);
+            hits++;
+            return;
+        }
+        scratch.clear(keywords.size());
+        countBuffer(scratch, mapped.begin(), mapped.end());
+        record = AnalysisCache::makeRecord(task.path, st.st_size, modifyTimeNs(st), contentHash, scratch);
+        target.merge(scratch);
+        if (old != nullptr && haveTotals) AnalysisCache::mergeRecord(old, target, -1);
+    }
+
+    // 缓存的有效性取决于保留字表
+    uint64_t keywordsHash() const {
+        string all;
+        for (size_t i = 0; i < keywords.size(); i++) {
+            all += keywords[i];
+            all += '\n';
+        }
+        return hashContent(all.data(), all.size());
     }
 
     // 从字符串中提取单词
-    vector<string> extractWords(const string& line) {
+    static vector<string> extractWords(const string& line) {
         vector<string> words;
         string word;
         for (size_t i = 0; i < line.length(); i++) {
@@ -43,7 +1899,37 @@ private:
 
 public:
     KeywordAnalyzer() {
-        scanCount = 0;
+        lexerMode = false;
+        cacheHits = 0;
+        topK = 0;
+        topCapacity = 0;
+        outputFormat = FORMAT_TEXT;
+        useBuiltinTable = false;
+    }
+
+    // 开启词法分析模式
+    void setLexerMode(bool enabled) {
+        lexerMode = enabled;
+    }
+
+    // 设置增量分析缓存文件, 只对 analyzeFiles 生效
+    void setCachePath(const string& path) {
+        cachePath = path;
+    }
+
+    // 只统计出现次数最多的 k 个非保留字, 计数误差不超过 epsilon * 非保留字总数.
+    // 计数表容量为 max(k, 1 / epsilon), 与输入大小无关; 保留字仍然精确计数
+    void setTopK(size_t k, double epsilon) {
+        topK = k;
+        topCapacity = k > 0 ? max(k, (size_t)ceil(1.0 / epsilon)) : 0;
+        counts.topNonKeywords.setCapacity(topCapacity);
+    }
+
+    // 设置结果文件格式和路径, 路径为空时使用 keyword_data / non_keyword_data 加格式的扩展名
+    void setOutput(OutputFormat format, const string& keywordPath, const string& nonKeywordPath) {
+        outputFormat = format;
+        keywordOutput = keywordPath;
+        nonKeywordOutput = nonKeywordPath;
     }
 
     // 从文件加载保留字
@@ -52,63 +1938,581 @@ public:
         string keyword;
         while (file >> keyword) {
             keywords.push_back(keyword);
-            keywordCount[keyword] = 0;
         }
         file.close();
+        counts.keywordCount.resize(keywords.size());
+        buildKeywordIndex();
     }
 
-    // 分析源文件
+    // 分析源文件: 优先内存映射整个文件直接切出单词, 无法映射时(管道、"-" 表示的标准输入)分块读取
     void analyzeFile(const string& filename) {
-        ifstream file(filename.c_str());
-        string line;
-        scanCount = 0;
+        counts.scanCount = 0;
+        MappedFile mapped(filename);
+        if (mapped.isOpen()) {
+            countBuffer(counts, mapped.begin(), mapped.end());
+            return;
+        }
+        countUnmapped(counts, filename);
+    }
 
-        while (getline(file, line)) {
-            scanCount++;
-            vector<string> words = extractWords(line);
-            
-            for (size_t i = 0; i < words.size(); i++) {
-                if (isKeyword(words[i])) {
-                    keywordCount[words[i]]++;
-                } else {
-                    nonKeywordCount[words[i]]++;
+    // 并行分析多个文件或目录, 每个工作线程写自己的计数表, 全部完成后再合并
+    // 使用缓存时按整个文件分配任务, 每个文件的直方图单独记录
+    void analyzeFiles(const vector<string>& inputs, int threadNum) {
+        bool useCache = !cachePath.empty();
+        vector<ScanTask> tasks = planScanTasks(collectSourceFiles(inputs), !lexerMode && !useCache);
+        threadNum = max(1, min(threadNum, (int)tasks.size()));
+        vector<WordCounts> local(threadNum), scratch(threadNum), uncached(threadNum);
+        vector<size_t> hits(threadNum, 0);
+        for (int i = 0; i < threadNum; i++) {
+            local[i].keywordCount.resize(keywords.size());
+            local[i].topNonKeywords.setCapacity(topCapacity);
+            uncached[i].keywordCount.resize(keywords.size());
+            uncached[i].topNonKeywords.setCapacity(topCapacity);
+        }
+
+        AnalysisCache cache(keywordsHash(), (uint32_t)keywords.size(), lexerMode ? CACHE_LEXER_MODE : 0);
+        vector<vector<char>> records(useCache ? tasks.size() : 0);
+        if (useCache) {
+            cache.load(cachePath);
+        }
+
+        WorkStealingPool pool(threadNum);
+        pool.run(tasks.size(), [&](size_t task, int worker) {
+            if (useCache) {
+                runCachedTask(tasks[task], cache, records[task], scratch[worker], local[worker], uncached[worker],
+                              hits[worker]);
+            } else {
+                runTask(tasks[task], local[worker]);
+            }
+        });
+        counts.scanCount = 0;
+        cacheHits = 0;
+        for (int i = 0; i < threadNum; i++) {
+            counts.merge(local[i]);
+            cacheHits += hits[i];
+        }
+        if (!useCache) {
+            return;
+        }
+
+        // 从上一次的汇总出发, 再减去本次不再分析的文件
+        bool removed = false;
+        if (cache.getTotals() != nullptr) {
+            AnalysisCache::mergeRecord(cache.getTotals(), counts);
+            unordered_map<string_view, bool> current;
+            for (size_t i = 0; i < tasks.size(); i++) {
+                current[tasks[i].path] = true;
+            }
+            vector<string_view> oldPaths = cache.paths();
+            for (size_t i = 0; i < oldPaths.size(); i++) {
+                if (current.find(oldPaths[i]) == current.end()) {
+                    AnalysisCache::mergeRecord(cache.find(string(oldPaths[i])), counts, -1);
+                    removed = true;
                 }
             }
         }
-        file.close();
+        // 所有文件都未改动时不必重写缓存
+        if (cacheHits != tasks.size() || removed || cache.getTotals() == nullptr) {
+            cache.save(cachePath, counts, records);
+        }
+        // 没有记录的输入不在保存的汇总里, 保存之后才加到本次结果中
+        for (int i = 0; i < threadNum; i++) {
+            counts.merge(uncached[i]);
+        }
+    }
+
+    // 按设置的格式写出一张直方图, 失败时提示
+    void writeOutput(const string& path, const char* defaultName, string_view title,
+                     const vector<HistogramEntry>& entries, bool byCount) const {
+        string target = !path.empty() ? path : string(defaultName) + outputExtension(outputFormat);
+        if (!writeHistogram(target, outputFormat, title, entries, byCount)) {
+            cout << "无法写入结果文件: " << target << endl;
+        }
     }
 
     // 输出统计结果到文件
     void writeResults() {
-        // 输出保留字统计
-        ofstream keywordFile("keyword_data.txt");
-        keywordFile << "保留字统计：\n";
-        map<string, int>::iterator it;
-        for (it = keywordCount.begin(); it != keywordCount.end(); ++it) {
-            if (it->second > 0) {
-                keywordFile << it->first << ": " << it->second << "\n";
+        // 输出保留字统计, 按字典序
+        vector<HistogramEntry> keywordEntries;
+        for (size_t i = 0; i < keywords.size(); i++) {
+            if (counts.keywordCount[i] > 0) {
+                keywordEntries.push_back(HistogramEntry{keywords[i], counts.keywordCount[i], 0});
             }
         }
-        keywordFile.close();
+        sort(keywordEntries.begin(), keywordEntries.end(), [](const HistogramEntry& a, const HistogramEntry& b) {
+            return a.word != b.word ? a.word < b.word : a.count < b.count;
+        });
+        writeOutput(keywordOutput, "keyword_data", "保留字统计：", keywordEntries, false);
 
-        // 输出非保留字统计
-        ofstream nonKeywordFile("non_keyword_data.txt");
-        nonKeywordFile << "非保留字统计：\n";
-        for (it = nonKeywordCount.begin(); it != nonKeywordCount.end(); ++it) {
-            nonKeywordFile << it->first << ": " << it->second << "\n";
+        // 前 K 模式: 按计数从大到小, 估计值可能偏大时注明误差上界
+        if (topK > 0) {
+            string title = "非保留字统计（前 " + to_string(topK) + " 个）：";
+            writeOutput(nonKeywordOutput, "non_keyword_data", title, counts.topNonKeywords.top(topK), true);
+            return;
         }
-        nonKeywordFile.close();
+
+        // 输出非保留字统计, 只在这里排序一次
+        writeOutput(nonKeywordOutput, "non_keyword_data", "非保留字统计：", counts.nonKeywordCount.sorted(), false);
+    }
+
+    // 获取前 K 模式下非保留字的总数和计数误差上界
+    long long getNonKeywordTotal() const {
+        return counts.topNonKeywords.totalCount();
+    }
+
+    long long getTopKErrorBound() const {
+        return counts.topNonKeywords.minCount();
     }
 
     // 获取扫描次数
     int getScanCount() const {
-        return scanCount;
+        return counts.scanCount;
+    }
+
+    // 获取上一次分析中直接使用缓存的文件数
+    size_t getCacheHits() const {
+        return cacheHits;
+    }
+
+    // 获取词法分析模式下的注释和字面量计数
+    const LexerCounts& getLexerCounts() const {
+        return counts.lexerCounts;
+    }
+
+    // 分阶段基准: 每轮依次计时 加载(保留字文件、映射语料并读入所有页)、切分(只取出单词)、
+    // 切分+计数、输出, 计数阶段取两者之差. 先预热 warmup 轮, 再统计 repeat 轮的百分位数
+    void benchmarkPhases(const string& filename, int warmup, int repeat) {
+        const int PHASE_NUM = 4;
+        const char* const phaseNames[PHASE_NUM] = {"加载", "切分", "计数", "输出"};
+        vector<double> samples[PHASE_NUM];
+        vector<double> fullSamples;  // 切分+计数
+        size_t bytes = 0, tokens = 0;
+        for (int r = 0; r < warmup + repeat; r++) {
+            auto t0 = std::chrono::steady_clock::now();
+            keywords.clear();
+            loadKeywords("keywords.txt");
+            MappedFile mapped(filename);
+            if (!mapped.isOpen()) {
+                cout << "无法读取语料: " << filename << endl;
+                return;
+            }
+            // 提前读入所有页, 后面的阶段不计缺页时间
+            unsigned char touched = 0;
+            for (size_t i = 0; i < mapped.size(); i += 4096) touched ^= (unsigned char)mapped.begin()[i];
+            asm volatile("" : : "r"(touched));
+            auto t1 = std::chrono::steady_clock::now();
+
+            tokens = 0;
+            auto onWord = [&tokens](string_view) {
+                tokens++;
+            };
+            if (lexerMode) {
+                CppLexer lexer;
+                LexerCounts ignored;
+                lexer.lex(mapped.begin(), mapped.end(), ignored, onWord);
+            } else {
+                forEachWord(mapped.begin(), mapped.end(), onWord);
+            }
+            auto t2 = std::chrono::steady_clock::now();
+
+            counts.clear(keywords.size());
+            countBuffer(counts, mapped.begin(), mapped.end());
+            auto t3 = std::chrono::steady_clock::now();
+
+            writeResults();
+            auto t4 = std::chrono::steady_clock::now();
+
+            bytes = mapped.size();
+            if (r < warmup) continue;
+            double load = std::chrono::duration<double>(t1 - t0).count();
+            double tokenize = std::chrono::duration<double>(t2 - t1).count();
+            double full = std::chrono::duration<double>(t3 - t2).count();
+            samples[0].push_back(load);
+            samples[1].push_back(tokenize);
+            samples[2].push_back(full - tokenize);
+            samples[3].push_back(std::chrono::duration<double>(t4 - t3).count());
+            fullSamples.push_back(full);
+        }
+        if (repeat <= 0) return;
+
+        cout << "语料: " << filename << ", " << bytes / 1e6 << " MB, 单词数 " << tokens
+             << (lexerMode ? " (词法分析模式)" : "") << ", 预热 " << warmup << " 轮, 统计 " << repeat << " 轮" << endl;
+        cout << "阶段\t最小\tp50\tp90\tp99\t最大 (毫秒)" << endl;
+        for (int k = 0; k < PHASE_NUM; k++) {
+            sort(samples[k].begin(), samples[k].end());
+            cout << phaseNames[k] << "\t" << samples[k].front() * 1e3 << "\t" << percentile(samples[k], 0.5) * 1e3
+                 << "\t" << percentile(samples[k], 0.9) * 1e3 << "\t" << percentile(samples[k], 0.99) * 1e3
+                 << "\t" << samples[k].back() * 1e3 << endl;
+        }
+        // 吞吐量按中位数计算
+        sort(fullSamples.begin(), fullSamples.end());
+        double tokenizeSeconds = percentile(samples[1], 0.5), fullSeconds = percentile(fullSamples, 0.5);
+        cout << "切分: " << bytes / tokenizeSeconds / 1e6 << " MB/s, " << tokens / tokenizeSeconds / 1e6 << " M单词/秒" << endl;
+        cout << "切分+计数: " << bytes / fullSeconds / 1e6 << " MB/s, " << tokens / fullSeconds / 1e6 << " M单词/秒" << endl;
+    }
+
+    // 保留字查找微基准: 对比原来的线性查找与当前查找方式的每单词耗时
+    void benchmarkLookup(const string& filename) {
+        ifstream file(filename.c_str());
+        string line;
+        vector<string> words;
+        while (getline(file, line)) {
+            vector<string> lineWords = extractWords(line);
+            words.insert(words.end(), lineWords.begin(), lineWords.end());
+        }
+        file.close();
+        if (words.empty()) {
+            cout << "语料为空: " << filename << endl;
+            return;
+        }
+
+        const int ROUNDS = 5;
+        size_t linearHits = 0, tableHits = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        for (int r = 0; r < ROUNDS; r++) {
+            for (size_t i = 0; i < words.size(); i++) {
+                linearHits += find(keywords.begin(), keywords.end(), words[i]) != keywords.end();
+            }
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        for (int r = 0; r < ROUNDS; r++) {
+            for (size_t i = 0; i < words.size(); i++) {
+                tableHits += isKeyword(words[i]);
+            }
+        }
+        auto t2 = std::chrono::steady_clock::now();
+
+        double lookups = (double)words.size() * ROUNDS;
+        double linearNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / lookups;
+        double tableNs = std::chrono::duration<double, std::nano>(t2 - t1).count() / lookups;
+        cout << "单词数: " << words.size() << ", 保留字命中: " << tableHits / ROUNDS << endl;
+        cout << "线性查找: " << linearNs << " ns/单词" << endl;
+        cout << (useBuiltinTable ? "完美哈希" : "运行期哈希") << ": " << tableNs << " ns/单词" << endl;
+        if (linearHits != tableHits) {
+            cout << "查找结果不一致!" << endl;
+        }
     }
 };
 
-int main() {
+// 生成确定性的合成 C++ 语料: 约 bytes 字节, 标识符从 distinct 个名字中按近似 Zipf 分布选取,
+// 约 keywordPercent% 的单词是保留字, 另有少量注释、字符串和数字. 相同参数和种子生成的文件完全相同
+bool generateCorpus(const string& filename, size_t bytes, size_t distinct, double keywordPercent, uint64_t seed) {
+    uint64_t state = seed;
+    // splitmix64
+    auto next = [&state]() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    };
+    auto uniform = [&next]() {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    };
+
+    // 名字由序号经过置乱后转成 36 进制, 长度 2~12 不等
+    auto identifier = [](size_t id, string& out) {
+        uint64_t x = (id + 1) * 0x9e3779b97f4a7c15ull;
+        out += "abcdefghijklmnopqrstuvwxyz_"[x % 27];
+        x /= 27;
+        for (size_t n = id % 11; n > 0; n--, x /= 37) {
+            out += "abcdefghijklmnopqrstuvwxyz0123456789_"[x % 37];
+        }
+        static const char digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+        for (size_t v = id; ; v /= 36) {
+            out += digits[v % 36];
+            if (v < 36) break;
+        }
+    };
+    static const char* const operators[] = {" = ", " + ", " - ", " * ", " < ", " == ", "(", ")", ", ", "->", ".", "::", " && ", "[", "]"};
+    const size_t operatorNum = sizeof(operators) / sizeof(operators[0]);
+
+    ofstream out(filename.c_str(), ios::binary);
+    if (!out) return false;
+    string buffer;
+    size_t written = 0;
+    while (written < bytes) {
+        string line(next() % 4 * 4, ' ');
+        double kind = uniform();
+        size_t words = 3 + next() % 8;
+        if (kind < 0.08) {
+            line += "// ";
+        } else if (kind < 0.10) {
+            line += "#define ";
+        }
+        for (size_t w = 0; w < words; w++) {
+            if (w > 0) {
+                line += kind < 0.08 ? " " : operators[next() % operatorNum];
+            }
+            double r = uniform();
+            if (r * 100 < keywordPercent) {
+                line += builtinKeywords[next() % BUILTIN_KEYWORD_NUM];
+            } else if (kind >= 0.08 && next() % 16 == 0) {
+                // 字面量: 数字或字符串, 字符串中的单词在词法分析模式下不计数
+                if (next() % 2) {
+                    line += to_string(next() % 100000);
+                } else {
+                    line += "\"";
+                    identifier(next() % max<size_t>(distinct, 1), line);
+                    line += " text\"";
+                }
+            } else {
+                // 近似 Zipf: 下标取 distinct^u - 1, 小下标出现得多
+                identifier((size_t)pow((double)max<size_t>(distinct, 1), uniform()) - 1, line);
+            }
+        }
+        line += kind < 0.10 ? "\n" : ";\n";
+        buffer += line;
+        written += line.size();
+        if (buffer.size() >= (1 << 20)) {
+            out.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+    out.write(buffer.data(), buffer.size());
+    return (bool)out;
+}
+
+// 扫描器吞吐量基准: 只切分单词不计数, 比较各个实现
+void benchmarkScanners(const string& filename) {
+    MappedFile mapped(filename);
+    if (!mapped.isOpen() || mapped.begin() == mapped.end()) {
+        cout << "无法读取语料: " << filename << endl;
+        return;
+    }
+    const int ROUNDS = 10;
+    double bytes = (double)(mapped.end() - mapped.begin()) * ROUNDS;
+    vector<ScannerKernel> kernels = availableScanners();
+    size_t expectedWords = 0;
+    for (size_t k = 0; k < kernels.size(); k++) {
+        size_t words = 0, wordBytes = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        for (int r = 0; r < ROUNDS; r++) {
+            forEachWord(mapped.begin(), mapped.end(), [&](string_view word) {
+                words++;
+                wordBytes += word.size();
+            }, kernels[k].scan);
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(t1 - t0).count();
+        cout << kernels[k].name << ": " << bytes / seconds / 1e9 << " GB/s, 单词数 " << words / ROUNDS << endl;
+        if (k == 0) {
+            expectedWords = words + wordBytes;
+        } else if (words + wordBytes != expectedWords) {
+            cout << kernels[k].name << " 切分结果与 scalar 不一致!" << endl;
+        }
+    }
+}
+
+// 当前已分配的堆内存字节数(含 mmap 分配的大块), 仅 glibc 可用, 其他平台返回 0
+size_t heapBytesInUse() {
+#ifdef __GLIBC__
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+// 计数表基准: distinct 个不同标识符, 每个平均出现 4 次, 比较 std::map 与 WordCounter 的速度和内存
+void benchmarkCounters(size_t distinct) {
+    // 生成不重复的标识符, 长度在 3~18 之间变化
+    string storage;
+    vector<size_t> offsets;
+    for (size_t i = 0; i < distinct; i++) {
+        offsets.push_back(storage.size());
+        storage += "id_";
+        uint64_t x = (i + 1) * 0x9e3779b97f4a7c15ull;
+        for (size_t n = i % 16; n > 0; n--, x /= 37) {
+            storage += "abcdefghijklmnopqrstuvwxyz0123456789_"[x % 37];
+        }
+        storage += to_string(i);
+    }
+    offsets.push_back(storage.size());
+    vector<string_view> words;
+    for (size_t i = 0; i < distinct; i++) {
+        words.emplace_back(storage.data() + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+    // 固定种子的单词序列: 先各出现一次, 再随机出现 3 * distinct 次
+    vector<uint32_t> stream;
+    for (size_t i = 0; i < distinct; i++) stream.push_back((uint32_t)i);
+    uint64_t state = 12345;
+    for (size_t i = 0; i < 3 * distinct; i++) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        stream.push_back((uint32_t)((state >> 33) % distinct));
+    }
+
+    size_t before = heapBytesInUse();
+    auto t0 = std::chrono::steady_clock::now();
+    {
+        map<string, int, less<>> counts;
+        for (size_t i = 0; i < stream.size(); i++) {
+            string_view word = words[stream[i]];
+            auto it = counts.find(word);
+            if (it != counts.end()) {
+                it->second++;
+            } else {
+                counts.emplace(string(word), 1);
+            }
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(t1 - t0).count();
+        cout << "std::map: " << stream.size() / seconds / 1e6 << " M次/秒, 内存 "
+             << (heapBytesInUse() - before) / 1e6 << " MB" << endl;
+    }
+
+    before = heapBytesInUse();
+    auto t2 = std::chrono::steady_clock::now();
+    {
+        WordCounter counts;
+        for (size_t i = 0; i < stream.size(); i++) {
+            counts.add(words[stream[i]]);
+        }
+        auto t3 = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(t3 - t2).count();
+        cout << "WordCounter: " << stream.size() / seconds / 1e6 << " M次/秒, 内存 "
+             << (heapBytesInUse() - before) / 1e6 << " MB (表 + 内存池 " << counts.memoryBytes() / 1e6 << " MB)" << endl;
+        auto t4 = std::chrono::steady_clock::now();
+        vector<HistogramEntry> entries = counts.sorted();
+        auto t5 = std::chrono::steady_clock::now();
+        cout << "输出前排序 " << entries.size() << " 项: " << std::chrono::duration<double>(t5 - t4).count() << " 秒" << endl;
+    }
+}
+
+// 多线程加速比基准: 线程数从 1 倍增到 maxThreads, 每次重新分析同一组输入
+void benchmarkThreads(const vector<string>& inputs, int maxThreads, bool lexerMode) {
+    vector<string> files = collectSourceFiles(inputs);
+    double bytes = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        struct stat st;
+        if (stat(files[i].c_str(), &st) == 0) bytes += st.st_size;
+    }
+    cout << "文件数: " << files.size() << ", 总大小: " << bytes / 1e6 << " MB, CPU 核数: " << thread::hardware_concurrency() << endl;
+
+    vector<int> threadNums;
+    for (int t = 1; t < maxThreads; t *= 2) threadNums.push_back(t);
+    threadNums.push_back(maxThreads);
+    double baseline = 0;
+    for (size_t i = 0; i < threadNums.size(); i++) {
+        KeywordAnalyzer analyzer;
+        analyzer.loadKeywords("keywords.txt");
+        analyzer.setLexerMode(lexerMode);
+        auto t0 = std::chrono::steady_clock::now();
+        analyzer.analyzeFiles(files, threadNums[i]);
+        auto t1 = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(t1 - t0).count();
+        if (i == 0) baseline = seconds;
+        cout << "线程数 " << threadNums[i] << ": " << seconds << " 秒, " << bytes / seconds / 1e6
+             << " MB/s, 加速比 " << baseline / seconds << endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
     KeywordAnalyzer analyzer;
-    
+
+    // 保留字查找微基准: keyword_analyzer --bench-lookup <语料文件>
+    if (argc == 3 && string(argv[1]) == "--bench-lookup") {
+        analyzer.loadKeywords("keywords.txt");
+        analyzer.benchmarkLookup(argv[2]);
+        return 0;
+    }
+
+    // 扫描器吞吐量基准: keyword_analyzer --bench-scan <语料文件>
+    if (argc == 3 && string(argv[1]) == "--bench-scan") {
+        benchmarkScanners(argv[2]);
+        return 0;
+    }
+
+    // 计数表基准: keyword_analyzer --bench-counter <不同标识符个数>
+    if (argc == 3 && string(argv[1]) == "--bench-counter") {
+        benchmarkCounters(max(1L, atol(argv[2])));
+        return 0;
+    }
+
+    // 生成合成语料: keyword_analyzer --gen-corpus <输出文件> <字节数> <不同标识符数> <保留字百分比> [种子]
+    if ((argc == 6 || argc == 7) && string(argv[1]) == "--gen-corpus") {
+        uint64_t seed = argc == 7 ? strtoull(argv[6], nullptr, 10) : 1;
+        if (!generateCorpus(argv[2], strtoull(argv[3], nullptr, 10), strtoull(argv[4], nullptr, 10), atof(argv[5]), seed)) {
+            cout << "无法写入语料: " << argv[2] << endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // keyword_analyzer [-j 线程数] [--lexer] [--cache 缓存文件] [--top K [--epsilon e]] [--bench-threads]
+    // [--bench [--warmup N] [--repeat N]] [--format text|csv|json|binary] [--keyword-out 文件] [--non-keyword-out 文件]
+    // [文件或目录...], 不给输入时分析 source.cpp, "-" 表示标准输入
+    vector<string> inputs;
+    int threadNum = max(1, (int)thread::hardware_concurrency());
+    bool benchThreads = false;
+    bool benchPhases = false;
+    int warmup = 2, repeat = 10;
+    bool lexerMode = false;
+    string cachePath;
+    size_t topK = 0;
+    double epsilon = 1e-4;
+    OutputFormat outputFormat = FORMAT_TEXT;
+    string keywordOutput, nonKeywordOutput;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-j" && i + 1 < argc) {
+            threadNum = max(1, atoi(argv[++i]));
+        } else if (arg == "--bench-threads") {
+            benchThreads = true;
+        } else if (arg == "--bench") {
+            benchPhases = true;
+        } else if (arg == "--warmup" && i + 1 < argc) {
+            warmup = max(0, atoi(argv[++i]));
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            repeat = max(1, atoi(argv[++i]));
+        } else if (arg == "--lexer") {
+            lexerMode = true;
+        } else if (arg == "--cache" && i + 1 < argc) {
+            cachePath = argv[++i];
+        } else if (arg == "--top" && i + 1 < argc) {
+            topK = max(1L, atol(argv[++i]));
+        } else if (arg == "--epsilon" && i + 1 < argc) {
+            epsilon = atof(argv[++i]);
+        } else if (arg == "--format" && i + 1 < argc) {
+            if (!parseOutputFormat(argv[++i], outputFormat)) {
+                cout << "未知的输出格式: " << argv[i] << " (可选 text, csv, json, binary)" << endl;
+                return 1;
+            }
+        } else if (arg == "--keyword-out" && i + 1 < argc) {
+            keywordOutput = argv[++i];
+        } else if (arg == "--non-keyword-out" && i + 1 < argc) {
+            nonKeywordOutput = argv[++i];
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+    if (benchThreads) {
+        benchmarkThreads(inputs, threadNum, lexerMode);
+        return 0;
+    }
+    if (topK > 0 && !cachePath.empty()) {
+        cout << "--top 不能与 --cache 同时使用: 缓存需要完整的直方图" << endl;
+        return 1;
+    }
+    if (!(epsilon > 0 && epsilon < 1)) {
+        cout << "--epsilon 应在 0 和 1 之间" << endl;
+        return 1;
+    }
+    analyzer.setLexerMode(lexerMode);
+    analyzer.setCachePath(cachePath);
+    analyzer.setTopK(topK, epsilon);
+    analyzer.setOutput(outputFormat, keywordOutput, nonKeywordOutput);
+    if (benchPhases) {
+        analyzer.benchmarkPhases(inputs.empty() ? "source.cpp" : inputs[0], warmup, repeat);
+        return 0;
+    }
+    if (inputs.size() > 1 && find(inputs.begin(), inputs.end(), "-") != inputs.end()) {
+        cout << "\"-\" (标准输入) 只能作为唯一的输入, 不能与其他文件或目录一起给出" << endl;
+        return 1;
+    }
+    if (!cachePath.empty() && inputs.empty()) {
+        inputs.push_back("source.cpp");
+    }
+
     // 记录开始时间
     auto start = high_resolution_clock::now();
 
@@ -116,7 +2520,13 @@ int main() {
     analyzer.loadKeywords("keywords.txt");
 
     // 分析源文件
-    analyzer.analyzeFile("source.cpp");
+    if (inputs.empty()) {
+        analyzer.analyzeFile("source.cpp");
+    } else if (inputs.size() == 1 && inputs[0] == "-") {
+        analyzer.analyzeFile("-");
+    } else {
+        analyzer.analyzeFiles(inputs, threadNum);
+    }
 
     // 输出结果
     analyzer.writeResults();
@@ -128,6 +2538,21 @@ int main() {
     // 输出扫描信息
     cout << "扫描次数: " << analyzer.getScanCount() << endl;
     cout << "扫描用时: " << duration.count() / 1000000.0 << " 秒" << endl;
+    if (!cachePath.empty()) {
+        cout << "缓存命中: " << analyzer.getCacheHits() << " 个文件" << endl;
+    }
+    if (topK > 0) {
+        cout << "非保留字总数: " << analyzer.getNonKeywordTotal()
+             << ", 计数误差上界: " << analyzer.getTopKErrorBound() << endl;
+    }
+    if (lexerMode) {
+        const LexerCounts& lexerCounts = analyzer.getLexerCounts();
+        cout << "注释: " << lexerCounts.comments << endl;
+        cout << "字符串字面量: " << lexerCounts.strings << endl;
+        cout << "字符字面量: " << lexerCounts.chars << endl;
+        cout << "数字字面量: " << lexerCounts.numbers << endl;
+        cout << "预处理指令: " << lexerCounts.directives << endl;
+    }
 
     return 0;
 }
\ No newline at end of file
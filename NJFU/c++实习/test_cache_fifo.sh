@@ -0,0 +1,32 @@
+#!/bin/sh
+# 增量缓存遇到管道输入时的回归测试: 同一个缓存连续运行两次, 输入是一个 FIFO 加一个普通文件,
+# 两次的保留字统计都必须与不用缓存时一致. FIFO 没有缓存记录, 它的计数不能进入保存的汇总,
+# 否则第二次运行会把它再加一遍.
+# 用法: sh test_cache_fifo.sh [keyword_analyzer 可执行文件]
+# 例如: g++ -std=c++17 -O2 -pthread -o keyword_analyzer keyword_analyzer_chrono_ver.cpp && sh test_cache_fifo.sh
+set -e
+here=$(cd "$(dirname "$0")" && pwd)
+analyzer=$(cd "$(dirname "${1:-./keyword_analyzer}")" && pwd)/$(basename "${1:-./keyword_analyzer}")
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cd "$work"
+cp "$here/keywords.txt" .
+printf 'int main() {\n    return 0;\n}\n' > a.cpp
+printf 'int f(int x) { if (x) return 1; return 0; }\n' > pipe.cpp
+mkfifo input
+
+# 基准: 不用缓存
+cat pipe.cpp > input &
+"$analyzer" input a.cpp > /dev/null
+cp keyword_data.txt expected.txt
+
+for run in 1 2; do
+    cat pipe.cpp > input &
+    "$analyzer" --cache analysis.cache input a.cpp > /dev/null
+    if ! cmp -s keyword_data.txt expected.txt; then
+        echo "第 $run 次带缓存运行的保留字统计与不用缓存时不同:"
+        diff expected.txt keyword_data.txt || true
+        exit 1
+    fi
+done
+echo "通过: FIFO 输入两次带缓存运行的结果都与不用缓存时一致"
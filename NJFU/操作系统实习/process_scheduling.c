@@ -1,194 +1,1609 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
+#include <time.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define MAX_PROCESSES 5
-#define EP 0.000001
+#define TICKS_PER_UNIT 100  // 时间用整数刻度表示, 1 个时间单位 = 100 刻度, 输入和输出都保留两位小数
+
+// 时间刻度. 模拟中的时间全部是整数, 加减比较没有舍入误差, 结果与运行次数和编译选项无关
+typedef int64_t Tick;
 
 typedef struct {
     char name;  // 进程名
-    float arrival_time;  // 到达时间
-    float service_time;  // 服务时间
-    float remaining_time;  // 剩余时间
-    float completion_time;  // 完成时间
-    float turnaround_time;  // 周转时间
-    float weighted_turnaround_time;  // 带权周转时间
+    Tick arrival_time;  // 到达时间
+    Tick service_time;  // 服务时间
+    Tick remaining_time;  // 剩余时间
+    Tick completion_time;  // 完成时间
+    Tick turnaround_time;  // 周转时间
+    double weighted_turnaround_time;  // 带权周转时间, 完成时由两个整数算出
+    int id;  // 在输入中的序号
+    const char* trace_name;  // 轨迹文件中的名字, 指向映射的文件内容, 不以 0 结尾
+    int trace_name_len;
+    int priority;  // 优先数, 越小越优先
+    int level;     // 多级反馈队列中所在的级别
+    Tick rank;     // 在就绪堆中的排序键
 } Process;
 
-// 抢占的短作业优先算法
-void calculate_SJF(Process processes[], int n) {
-    int completed = 0, min_index = -1;  // 已完成进程数, 最优先进程
-    float current_time = 0;  // 当前时间
-    int is_completed[MAX_PROCESSES];
-    // 初始化
-    int i;
-    for (i = 0; i < MAX_PROCESSES; i++) {
-        is_completed[i] = 0;
-    }
-
-    while (completed < n) {
-        // 寻找已到达的进程中的最优先进程
-        if (min_index != -1 && fabs(processes[min_index].remaining_time - 0) < EP) {
-            min_index = -1;
-            int i;
-            for (i = 0; i < n; i++) {
-                if (processes[i].arrival_time <= current_time &&  // 该进程已到来
-                    !is_completed[i] &&  // 该进程未完成
-                    (min_index == -1 || processes[i].remaining_time < processes[min_index].remaining_time)) {  // 当前未确定最优先进程或该进程优先级更高
-                    min_index = i;  // 确定该进程为最优先进程
-                }
-            }   
-        }
-
-        // 没有找到当前最优先进程, 说明当前没有进程到来, 寻找一个最先到达的进程
-        if (min_index == -1) {
-            float min_arrival_time = processes[0].arrival_time;
-            min_index = 0;
-            int i;
-            for (i = 0; i < n; i++) {
-                if (processes[i].arrival_time < min_arrival_time && !is_completed[i]) {
-                    min_arrival_time = processes[i].arrival_time;
-                    min_index = i;
-                }
-            }
-            current_time = min_arrival_time;
+// ---------------- 事件驱动的调度模拟 ----------------
+// 进程按到达时间从到达序列中逐个取出, 模拟器只保存已到达未完成的进程,
+// 完成的进程交给完成回调. 抢占的短作业优先和抢占的优先级调度用最小堆,
+// 时间片轮转、先来先服务和多级反馈队列用先进先出的就绪队列, 每个事件 O(log n), 总共 O(n log n)
+
+// 到达序列: 按到达时间非降序给出进程, 没有更多进程时返回 0
+typedef struct {
+    int (*next)(void* ctx, Process* p);
+    void* ctx;
+} ArrivalSource;
+
+// 进程完成时调用, p 中的完成时间、周转时间、带权周转时间已经算好
+typedef struct {
+    void (*done)(void* ctx, const Process* p);
+    void* ctx;
+} CompletionSink;
+
+// 已到达未完成的进程放在 slots 中, 完成后槽位放回空闲链表重复使用
+typedef struct {
+    Process* slots;
+    int* free_list;
+    int free_count;
+    int capacity;
+    int active;  // 已到达未完成的进程数
+    int peak;    // active 的最大值
+} ProcessPool;
+
+// 最小堆, 按 rank 排序, 相同时序号小的优先(与逐个扫描时下标小的优先一致)
+typedef struct {
+    int* items;
+    int size;
+    int capacity;
+} ReadyHeap;
+
+// 先进先出的就绪队列, 循环数组, 满了加倍
+typedef struct {
+    int* items;
+    int head;
+    int count;
+    int capacity;
+} ReadyQueue;
+
+void* grow_array(void* p, int* capacity, size_t elem_size) {
+    int new_capacity = *capacity > 0 ? *capacity * 2 : 64;
+    void* q = realloc(p, (size_t)new_capacity * elem_size);
+    if (q == NULL) {
+        perror("realloc");
+        exit(1);
+    }
+    *capacity = new_capacity;
+    return q;
+}
+
+int pool_add(ProcessPool* pool, const Process* p) {
+    if (pool->free_count == 0) {
+        int old_capacity = pool->capacity;
+        pool->slots = grow_array(pool->slots, &pool->capacity, sizeof(Process));
+        pool->free_list = realloc(pool->free_list, sizeof(int) * pool->capacity);
+        int i;
+        for (i = pool->capacity - 1; i >= old_capacity; i--) {
+            pool->free_list[pool->free_count++] = i;
         }
+    }
+    int slot = pool->free_list[--pool->free_count];
+    pool->slots[slot] = *p;
+    if (++pool->active > pool->peak) pool->peak = pool->active;
+    return slot;
+}
+
+void pool_remove(ProcessPool* pool, int slot) {
+    pool->free_list[pool->free_count++] = slot;
+    pool->active--;
+}
+
+void pool_free(ProcessPool* pool) {
+    free(pool->slots);
+    free(pool->free_list);
+}
+
+int heap_less(const Process* slots, int a, int b) {
+    if (slots[a].rank != slots[b].rank) {
+        return slots[a].rank < slots[b].rank;
+    }
+    return slots[a].id < slots[b].id;
+}
+
+void heap_push(ReadyHeap* h, const Process* slots, int slot) {
+    if (h->size == h->capacity) {
+        h->items = grow_array(h->items, &h->capacity, sizeof(int));
+    }
+    int i = h->size++;
+    while (i > 0 && heap_less(slots, slot, h->items[(i - 1) / 2])) {
+        h->items[i] = h->items[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    h->items[i] = slot;
+}
+
+int heap_pop(ReadyHeap* h, const Process* slots) {
+    int top = h->items[0];
+    int last = h->items[--h->size];
+    int i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= h->size) break;
+        if (child + 1 < h->size && heap_less(slots, h->items[child + 1], h->items[child])) child++;
+        if (!heap_less(slots, h->items[child], last)) break;
+        h->items[i] = h->items[child];
+        i = child;
+    }
+    if (h->size > 0) h->items[i] = last;
+    return top;
+}
 
-        // 下一个时间节点(当前进程处理完或者被抢占)
-        float next_time = current_time + processes[min_index].remaining_time;
-        int prior_index = min_index;
+void queue_push(ReadyQueue* q, int slot) {
+    if (q->count == q->capacity) {
+        // 加倍后把绕回开头的部分接到后面
+        int old_capacity = q->capacity;
+        q->items = grow_array(q->items, &q->capacity, sizeof(int));
         int i;
-        for (i = 0; i < n; i++) {
-            // 如果有进程在当前进程处理完成之前到达
-            if (processes[i].arrival_time < next_time && processes[i].arrival_time > current_time && !is_completed[i]  // 已到达, 未完成
-            ) {
-                // 并且剩余时间更短(优先级更高)
-                if (processes[i].remaining_time < next_time - processes[i].arrival_time) {
-                    if (prior_index == min_index) prior_index = i;
-                    else if (processes[i].remaining_time < processes[prior_index].remaining_time) {
-                        prior_index = i;
-                    }
+        for (i = 0; i < q->head + q->count - old_capacity; i++) {
+            q->items[old_capacity + i] = q->items[i];
+        }
+    }
+    q->items[(q->head + q->count) % q->capacity] = slot;
+    q->count++;
+}
+
+int queue_pop(ReadyQueue* q) {
+    int slot = q->items[q->head];
+    q->head = (q->head + 1) % q->capacity;
+    q->count--;
+    return slot;
+}
+
+// 填好完成时间和两个周转时间, 交给完成回调, 释放槽位
+void complete_process(ProcessPool* pool, int slot, Tick current_time, CompletionSink* sink) {
+    Process* p = &pool->slots[slot];
+    p->completion_time = current_time;
+    p->turnaround_time = p->completion_time - p->arrival_time;
+    p->weighted_turnaround_time = (double)p->turnaround_time / p->service_time;
+    p->remaining_time = 0;
+    sink->done(sink->ctx, p);
+    pool_remove(pool, slot);
+}
+
+// 抢占式调度的公共部分: 就绪堆顶的 rank 严格小于正在运行的进程时才抢占.
+// by_priority 为 0 时 rank 是剩余时间(最短剩余时间优先), 为 1 时 rank 是优先数.
+// 返回同时在内存中的进程数的最大值
+int simulate_preemptive(ArrivalSource* source, CompletionSink* sink, int by_priority) {
+    ProcessPool pool = {0};
+    ReadyHeap heap = {0};
+    Process next;
+    int has_next = source->next(source->ctx, &next);
+    int running = -1;
+    Tick current_time = 0;
+
+    while (has_next || running != -1 || heap.size > 0) {
+        // 没有可运行的进程, 推进到下一个到达时间
+        if (running == -1 && heap.size == 0 && next.arrival_time > current_time) {
+            current_time = next.arrival_time;
+        }
+        // 已到达的进程进入就绪堆
+        while (has_next && next.arrival_time <= current_time) {
+            next.rank = by_priority ? next.priority : next.remaining_time;
+            // pool_add 可能搬动 slots, 要先取得槽位再读 pool.slots
+            int slot = pool_add(&pool, &next);
+            heap_push(&heap, pool.slots, slot);
+            has_next = source->next(source->ctx, &next);
+        }
+        if (running == -1) {
+            running = heap_pop(&heap, pool.slots);
+        } else if (heap.size > 0 && pool.slots[heap.items[0]].rank < pool.slots[running].rank) {
+            // 抢占
+            int prior = heap_pop(&heap, pool.slots);
+            heap_push(&heap, pool.slots, running);
+            running = prior;
+        }
+
+        // 下一个时间节点: 当前进程处理完, 或者下一个进程到达
+        Tick next_time = current_time + pool.slots[running].remaining_time;
+        if (has_next && next.arrival_time < next_time) {
+            current_time = next.arrival_time;
+            pool.slots[running].remaining_time = next_time - current_time;
+            if (!by_priority) pool.slots[running].rank = pool.slots[running].remaining_time;
+        } else {
+            current_time = next_time;
+            complete_process(&pool, running, current_time, sink);
+            running = -1;
+        }
+    }
+    free(heap.items);
+    pool_free(&pool);
+    return pool.peak;
+}
+
+// 抢占的短作业优先(最短剩余时间优先). 新到达的进程剩余时间严格小于正在运行的进程时才抢占
+int simulate_SJF(ArrivalSource* source, CompletionSink* sink) {
+    return simulate_preemptive(source, sink, 0);
+}
+
+// 抢占的优先级调度, 优先数相同时先到达的优先
+int simulate_priority(ArrivalSource* source, CompletionSink* sink) {
+    return simulate_preemptive(source, sink, 1);
+}
+
+// 时间片轮转, 时间片以刻度为单位. 时间片用完时, 这段时间内到达的进程先进入就绪队列,
+// 被换下的进程排在它们后面. 返回同时在内存中的进程数的最大值
+int simulate_RR(ArrivalSource* source, CompletionSink* sink, Tick time_quantum) {
+    ProcessPool pool = {0};
+    ReadyQueue ready = {0};
+    Process next;
+    int has_next = source->next(source->ctx, &next);
+    Tick current_time = 0;
+
+    while (has_next || ready.count > 0) {
+        // 若当前时间没有任何进程到达，直接推进到下一个到达时间
+        if (ready.count == 0 && next.arrival_time > current_time) {
+            current_time = next.arrival_time;
+        }
+        while (has_next && next.arrival_time <= current_time) {
+            queue_push(&ready, pool_add(&pool, &next));
+            has_next = source->next(source->ctx, &next);
+        }
+
+        int slot = queue_pop(&ready);
+        Process* p = &pool.slots[slot];
+        int finished = 0;
+        if (p->remaining_time > time_quantum) {
+            current_time += time_quantum;
+            p->remaining_time -= time_quantum;
+        } else {
+            current_time += p->remaining_time;
+            finished = 1;
+        }
+        while (has_next && next.arrival_time <= current_time) {
+            queue_push(&ready, pool_add(&pool, &next));
+            has_next = source->next(source->ctx, &next);
+        }
+        if (finished) {
+            complete_process(&pool, slot, current_time, sink);
+        } else {
+            queue_push(&ready, slot);
+        }
+    }
+    free(ready.items);
+    pool_free(&pool);
+    return pool.peak;
+}
+
+// 先来先服务: 时间片无限长的时间片轮转
+int simulate_FCFS(ArrivalSource* source, CompletionSink* sink) {
+    return simulate_RR(source, sink, INT64_MAX);
+}
+
+#define MLFQ_LEVELS 3
+#define MLFQ_BOOST_QUANTA 64  // 每隔这么多个最高级时间片把所有进程提回最高级, 防止长进程饿死
+
+// 多级反馈队列: 第 k 级的时间片为 time_quantum * 2^k 个刻度, 新进程进入最高级,
+// 用完整个时间片还没结束就降一级, 高一级的队列空了才调度低一级.
+// 同一级内的顺序与时间片轮转相同, 时间片只在用完时才让出 CPU, 不被新到达的进程抢占
+int simulate_MLFQ(ArrivalSource* source, CompletionSink* sink, Tick time_quantum) {
+    ProcessPool pool = {0};
+    ReadyQueue ready[MLFQ_LEVELS] = {{0}};
+    Process next;
+    int has_next = source->next(source->ctx, &next);
+    int waiting = 0;  // 各级就绪队列中的进程总数
+    Tick boost_interval = time_quantum * MLFQ_BOOST_QUANTA;
+    Tick next_boost = boost_interval;
+    Tick current_time = 0;
+
+    while (has_next || waiting > 0) {
+        if (waiting == 0 && next.arrival_time > current_time) {
+            current_time = next.arrival_time;
+        }
+        while (has_next && next.arrival_time <= current_time) {
+            next.level = 0;
+            queue_push(&ready[0], pool_add(&pool, &next));
+            waiting++;
+            has_next = source->next(source->ctx, &next);
+        }
+        if (current_time >= next_boost) {
+            // 低级队列按原顺序接到最高级后面
+            int level;
+            for (level = 1; level < MLFQ_LEVELS; level++) {
+                while (ready[level].count > 0) {
+                    int slot = queue_pop(&ready[level]);
+                    pool.slots[slot].level = 0;
+                    queue_push(&ready[0], slot);
                 }
             }
+            next_boost = (current_time / boost_interval + 1) * boost_interval;
         }
-        // 如果不需要抢占, 完成当前进程, 计算周转时间和带权周转时间
-        if (prior_index == min_index) {  
-            current_time = next_time;
-            processes[min_index].completion_time = current_time;
-            processes[min_index].turnaround_time = processes[min_index].completion_time - processes[min_index].arrival_time;
-            processes[min_index].weighted_turnaround_time = (float)processes[min_index].turnaround_time / processes[min_index].service_time;
-            processes[min_index].remaining_time = 0;
-            is_completed[min_index] = 1;
-            completed++;
+
+        int level = 0;
+        while (ready[level].count == 0) level++;
+        int slot = queue_pop(&ready[level]);
+        waiting--;
+        Process* p = &pool.slots[slot];
+        Tick slice = time_quantum << level;
+        int finished = 0;
+        if (p->remaining_time > slice) {
+            current_time += slice;
+            p->remaining_time -= slice;
+        } else {
+            current_time += p->remaining_time;
+            finished = 1;
+        }
+        while (has_next && next.arrival_time <= current_time) {
+            next.level = 0;
+            queue_push(&ready[0], pool_add(&pool, &next));
+            waiting++;
+            has_next = source->next(source->ctx, &next);
         }
-        // 抢占
-        else {  
-            current_time = processes[prior_index].arrival_time;
-            processes[min_index].remaining_time = next_time - current_time;  // 记录被强占进程的剩余时间
-            min_index = prior_index;
+        p = &pool.slots[slot];  // 加入新进程时 slots 可能已经搬走
+        if (finished) {
+            complete_process(&pool, slot, current_time, sink);
+        } else {
+            if (p->level < MLFQ_LEVELS - 1) p->level++;
+            queue_push(&ready[p->level], slot);
+            waiting++;
         }
     }
+    int level;
+    for (level = 0; level < MLFQ_LEVELS; level++) {
+        free(ready[level].items);
+    }
+    pool_free(&pool);
+    return pool.peak;
 }
 
-// 时间片轮转算法
-void calculate_RR(Process processes[], int n, int time_quantum) {
-    int completed = 0, current_time = 0;
-    int is_completed[MAX_PROCESSES];
-    // 初始化
+// ---------------- 以数组为输入输出 ----------------
+// 进程表按列存放(结构数组), 每一列是一个连续数组, 汇总时只读需要的列, 循环可以向量化
+
+typedef struct {
+    int n;
+    char* name;
+    Tick* arrival_time;
+    Tick* service_time;
+    Tick* completion_time;
+    Tick* turnaround_time;
+} ProcessTable;
+
+ProcessTable table_alloc(int n) {
+    ProcessTable t;
+    size_t count = n > 0 ? n : 1;
+    t.n = n;
+    t.name = malloc(count);
+    t.arrival_time = malloc(sizeof(Tick) * count);
+    t.service_time = malloc(sizeof(Tick) * count);
+    t.completion_time = calloc(count, sizeof(Tick));
+    t.turnaround_time = calloc(count, sizeof(Tick));
+    return t;
+}
+
+void table_free(ProcessTable* t) {
+    free(t->name);
+    free(t->arrival_time);
+    free(t->service_time);
+    free(t->completion_time);
+    free(t->turnaround_time);
+}
+
+// 周转时间之和. 整数加法满足结合律, 向量化后结果不变
+Tick total_turnaround(const ProcessTable* t) {
+    Tick total = 0;
     int i;
-    for (i = 0; i < MAX_PROCESSES; i++) {
-        is_completed[i] = 0;
+    for (i = 0; i < t->n; i++) {
+        total += t->turnaround_time[i];
+    }
+    return total;
+}
+
+// 带权周转时间之和. 浮点加法不满足结合律, 这里固定用 4 路部分和, 最后按固定顺序合并,
+// 编译器可以把 4 路放进一个向量寄存器, 是否向量化都不改变结果
+double total_weighted_turnaround(const ProcessTable* t) {
+    double lane[4] = {0, 0, 0, 0};
+    int i;
+    for (i = 0; i + 4 <= t->n; i += 4) {
+        lane[0] += (double)t->turnaround_time[i] / t->service_time[i];
+        lane[1] += (double)t->turnaround_time[i + 1] / t->service_time[i + 1];
+        lane[2] += (double)t->turnaround_time[i + 2] / t->service_time[i + 2];
+        lane[3] += (double)t->turnaround_time[i + 3] / t->service_time[i + 3];
+    }
+    for (; i < t->n; i++) {
+        lane[i % 4] += (double)t->turnaround_time[i] / t->service_time[i];
+    }
+    return (lane[0] + lane[1]) + (lane[2] + lane[3]);
+}
+
+// 按到达时间排序的下标, 到达时间相同时下标小的在前
+typedef struct {
+    ProcessTable* table;
+    int* order;
+    int pos;
+} TableArrivals;
+
+const ProcessTable* sort_target;
+
+int compare_arrival(const void* a, const void* b) {
+    Tick ta = sort_target->arrival_time[*(const int*)a];
+    Tick tb = sort_target->arrival_time[*(const int*)b];
+    if (ta != tb) return ta < tb ? -1 : 1;
+    return *(const int*)a - *(const int*)b;
+}
+
+int table_next(void* ctx, Process* p) {
+    TableArrivals* a = ctx;
+    if (a->pos == a->table->n) return 0;
+    int i = a->order[a->pos++];
+    memset(p, 0, sizeof(*p));
+    p->name = a->table->name[i];
+    p->arrival_time = a->table->arrival_time[i];
+    p->service_time = a->table->service_time[i];
+    p->remaining_time = p->service_time;
+    p->id = i;
+    return 1;
+}
+
+// 把结果写回表中对应的行
+void table_done(void* ctx, const Process* p) {
+    ProcessTable* t = ctx;
+    t->completion_time[p->id] = p->completion_time;
+    t->turnaround_time[p->id] = p->turnaround_time;
+}
+
+int* sort_by_arrival(const ProcessTable* t) {
+    int* order = malloc(sizeof(int) * (t->n > 0 ? t->n : 1));
+    int i;
+    for (i = 0; i < t->n; i++) {
+        order[i] = i;
+    }
+    sort_target = t;
+    qsort(order, t->n, sizeof(int), compare_arrival);
+    return order;
+}
+
+// 抢占的短作业优先算法
+void calculate_SJF(ProcessTable* t) {
+    TableArrivals arrivals = {t, sort_by_arrival(t), 0};
+    ArrivalSource source = {table_next, &arrivals};
+    CompletionSink sink = {table_done, t};
+    simulate_SJF(&source, &sink);
+    free(arrivals.order);
+}
+
+// 时间片轮转算法, 时间片以时间单位计
+void calculate_RR(ProcessTable* t, int time_quantum) {
+    TableArrivals arrivals = {t, sort_by_arrival(t), 0};
+    ArrivalSource source = {table_next, &arrivals};
+    CompletionSink sink = {table_done, t};
+    simulate_RR(&source, &sink, (Tick)time_quantum * TICKS_PER_UNIT);
+    free(arrivals.order);
+}
+
+// ---------------- 轨迹文件 ----------------
+// 轨迹文件按到达时间非降序排列, 用 mmap 映射后边解析边送入模拟器, 不整体读入内存.
+// 文本格式每行 "名字,到达时间,服务时间[,优先数]", 时间最多两位小数, 第一行不是数字时当作表头跳过;
+// 二进制格式为 8 字节魔数 "PSTRACE1"、8 字节记录数, 之后每条记录
+// {到达时间 uint64, 服务时间 uint32, 编号 uint32}, 名字就是编号, 优先数都为 0.
+// 完成的进程立即写出一行, 内存只随同时在就绪队列中的进程数增长.
+// 读过的映射页定期用 MADV_DONTNEED 交还, 常驻内存也不随文件大小增长;
+// 就绪进程的名字仍指向这些页, 再访问时会从文件重新读入, 内容不变
+
+#define TRACE_MAGIC "PSTRACE1"
+#define OUT_BUFFER_SIZE (1 << 20)
+#define TRACE_RELEASE_BYTES (8 << 20)   // 每读过这么多就把读过的页交还内核
+
+typedef struct {
+    uint64_t arrival_time;
+    uint32_t service_time;
+    uint32_t id;
+} TraceRecord;
+
+typedef struct {
+    const char* data;
+    size_t size;
+    const char* pos;   // 文本格式下一行的开头
+    size_t released;   // 此前的页已经交还内核
+    uint64_t index;    // 已读出的进程数
+    uint64_t count;    // 二进制格式的记录数
+    int binary;
+    long line;
+    Tick last_arrival;
+    const char* error; // 出错时的说明, 读取随即停止
+} TraceReader;
+
+// 解析非负的十进制数, 最多两位小数, 换算成刻度. 成功时移动 *p 并返回 1
+int parse_ticks(const char** p, const char* end, Tick* value) {
+    const char* s = *p;
+    Tick v = 0;
+    if (s == end || *s < '0' || *s > '9') return 0;
+    while (s < end && *s >= '0' && *s <= '9') {
+        if (v > INT64_MAX / 10 / TICKS_PER_UNIT) return 0;
+        v = v * 10 + (*s++ - '0');
+    }
+    v *= TICKS_PER_UNIT;
+    if (s < end && *s == '.') {
+        Tick scale = TICKS_PER_UNIT;
+        for (s++; s < end && *s >= '0' && *s <= '9'; s++) {
+            scale /= 10;
+            if (scale == 0) return 0;
+            v += (*s - '0') * scale;
+        }
+    }
+    *value = v;
+    *p = s;
+    return 1;
+}
+
+// 解析 [s, eol) 整段为 int 范围内的十进制整数优先数, 带小数或其他字符都不接受. 成功时返回 1
+int parse_priority(const char* s, const char* eol, int* value) {
+    char buf[24];  // 轨迹是映射进来的, 不以 '\0' 结尾, 先复制出来再交给 strtol
+    size_t len = eol - s;
+    if (len == 0 || len >= sizeof(buf) || (*s != '-' && (*s < '0' || *s > '9'))) return 0;
+    memcpy(buf, s, len);
+    buf[len] = '\0';
+    char* end;
+    errno = 0;
+    long v = strtol(buf, &end, 10);
+    if (end != buf + len || errno != 0 || v < INT_MIN || v > INT_MAX) return 0;
+    *value = (int)v;
+    return 1;
+}
+
+// 解析文本格式的一行, 返回 1 表示得到一个进程, 0 表示到了文件末尾或出错
+int parse_trace_line(TraceReader* r, Process* p) {
+    const char* end = r->data + r->size;
+    while (r->pos < end) {
+        const char* line = r->pos;
+        const char* eol = memchr(line, '\n', end - line);
+        if (eol == NULL) eol = end;
+        r->pos = eol < end ? eol + 1 : end;
+        r->line++;
+        if (eol > line && eol[-1] == '\r') eol--;
+        if (eol == line) continue;  // 空行
+
+        const char* comma = memchr(line, ',', eol - line);
+        const char* s = comma != NULL ? comma + 1 : eol;
+        if (comma != NULL && r->line == 1 && (s == eol || *s < '0' || *s > '9')) continue;  // 表头
+        p->priority = 0;
+        if (comma == NULL || !parse_ticks(&s, eol, &p->arrival_time) || s == eol || *s++ != ',' ||
+            !parse_ticks(&s, eol, &p->service_time) ||
+            (s != eol && (*s++ != ',' || !parse_priority(s, eol, &p->priority)))) {
+            r->error = "格式应为 名字,到达时间,服务时间[,优先数], 时间最多两位小数, 优先数为整数";
+            return 0;
+        }
+        p->name = comma > line ? line[0] : '?';
+        p->trace_name = line;
+        p->trace_name_len = (int)(comma - line);
+        return 1;
+    }
+    return 0;
+}
+
+// ArrivalSource 的 next: 按文件顺序给出进程, 并检查到达时间不递减、服务时间为正
+int trace_next(void* ctx, Process* p) {
+    TraceReader* r = ctx;
+    if (r->error != NULL) return 0;
+    memset(p, 0, sizeof(*p));
+    if (r->binary) {
+        if (r->index == r->count) return 0;
+        TraceRecord rec;
+        memcpy(&rec, r->data + 16 + r->index * sizeof(TraceRecord), sizeof(rec));
+        if (rec.arrival_time > INT64_MAX / TICKS_PER_UNIT) {
+            r->error = "到达时间超出范围";
+            return 0;
+        }
+        p->arrival_time = (Tick)rec.arrival_time * TICKS_PER_UNIT;
+        p->service_time = (Tick)rec.service_time * TICKS_PER_UNIT;
+        p->name = '#';
+        p->id = (int)rec.id;
+        r->line = (long)r->index + 1;
+    } else if (parse_trace_line(r, p)) {
+        p->id = (int)r->index;
+    } else {
+        return 0;
+    }
+    if (p->service_time <= 0) {
+        r->error = "服务时间必须为正数";
+        return 0;
+    }
+    if (p->arrival_time < r->last_arrival) {
+        r->error = "到达时间必须不递减";
+        return 0;
+    }
+    r->last_arrival = p->arrival_time;
+    p->remaining_time = p->service_time;
+    r->index++;
+    size_t consumed = r->binary ? 16 + r->index * sizeof(TraceRecord) : (size_t)(r->pos - r->data);
+    if (consumed - r->released >= TRACE_RELEASE_BYTES) {
+        size_t end = consumed & ~(size_t)(sysconf(_SC_PAGESIZE) - 1);
+        madvise((void*)(r->data + r->released), end - r->released, MADV_DONTNEED);
+        r->released = end;
+    }
+    return 1;
+}
+
+// 映射轨迹文件并判断格式, 失败时返回 0
+int trace_open(TraceReader* r, const char* path) {
+    memset(r, 0, sizeof(*r));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror(path);
+        close(fd);
+        return 0;
+    }
+    r->size = st.st_size;
+    if (r->size > 0) {
+        r->data = mmap(NULL, r->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (r->data == MAP_FAILED) {
+            perror(path);
+            close(fd);
+            return 0;
+        }
+        madvise((void*)r->data, r->size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+    r->pos = r->data;
+    if (r->size >= 16 && memcmp(r->data, TRACE_MAGIC, 8) == 0) {
+        r->binary = 1;
+        memcpy(&r->count, r->data + 8, 8);
+        if (r->count > (r->size - 16) / sizeof(TraceRecord)) {
+            fprintf(stderr, "%s: 记录数超出文件长度\n", path);
+            munmap((void*)r->data, r->size);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void trace_close(TraceReader* r) {
+    if (r->size > 0) munmap((void*)r->data, r->size);
+}
+
+// 带缓冲的输出, 攒满 OUT_BUFFER_SIZE 才写一次
+typedef struct {
+    FILE* file;
+    char* buffer;
+    size_t length;
+} OutBuffer;
+
+void out_flush(OutBuffer* out) {
+    fwrite(out->buffer, 1, out->length, out->file);
+    out->length = 0;
+}
+
+void out_bytes(OutBuffer* out, const char* s, size_t n) {
+    if (out->length + n > OUT_BUFFER_SIZE) out_flush(out);
+    memcpy(out->buffer + out->length, s, n);
+    out->length += n;
+}
+
+// 写出非负整数
+void out_uint(OutBuffer* out, unsigned long long v) {
+    char digits[20];
+    int n = 0;
+    do {
+        digits[sizeof(digits) - 1 - n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v > 0);
+    out_bytes(out, digits + sizeof(digits) - n, n);
+}
+
+// 写出保留两位小数的非负数, cents 以 0.01 为单位
+void out_cents(OutBuffer* out, unsigned long long cents) {
+    char frac[3] = {'.', (char)('0' + cents / 10 % 10), (char)('0' + cents % 10)};
+    out_uint(out, cents / 100);
+    out_bytes(out, frac, 3);
+}
+
+void out_fixed2(OutBuffer* out, double v) {
+    out_cents(out, (unsigned long long)(v * 100 + 0.5));
+}
+
+// 刻度正好是 0.01, 直接写出, 不经过浮点数
+void out_ticks(OutBuffer* out, Tick t) {
+    out_cents(out, (unsigned long long)t * 100 / TICKS_PER_UNIT);
+}
+
+// 流式结果: 累加周转时间, 需要时每个完成的进程写出一行
+typedef struct {
+    OutBuffer* out;
+    unsigned long long count;
+    Tick total_turnaround_time;
+    double total_weighted_turnaround_time;
+    Tick max_turnaround_time;
+} StreamResults;
+
+void stream_done(void* ctx, const Process* p) {
+    StreamResults* r = ctx;
+    r->count++;
+    r->total_turnaround_time += p->turnaround_time;
+    r->total_weighted_turnaround_time += p->weighted_turnaround_time;
+    if (p->turnaround_time > r->max_turnaround_time) r->max_turnaround_time = p->turnaround_time;
+    if (r->out == NULL) return;
+    if (p->trace_name != NULL) {
+        out_bytes(r->out, p->trace_name, p->trace_name_len);
+    } else {
+        out_uint(r->out, (unsigned)p->id);
+    }
+    out_bytes(r->out, ",", 1);
+    out_ticks(r->out, p->completion_time);
+    out_bytes(r->out, ",", 1);
+    out_ticks(r->out, p->turnaround_time);
+    out_bytes(r->out, ",", 1);
+    out_fixed2(r->out, p->weighted_turnaround_time);
+    out_bytes(r->out, "\n", 1);
+}
+
+// 生成 n 个进程的随机轨迹文件, 参数同 random_processes, 文本格式另有 0~7 的优先数
+int write_trace(const char* path, long n, unsigned seed, int binary) {
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        perror(path);
+        return 1;
+    }
+    OutBuffer out = {file, malloc(OUT_BUFFER_SIZE), 0};
+    uint64_t arrival_time = 0;
+    long i;
+    srand(seed);
+    if (binary) {
+        uint64_t count = n;
+        out_bytes(&out, TRACE_MAGIC, 8);
+        out_bytes(&out, (const char*)&count, 8);
+    } else {
+        const char* header = "name,arrival,service,priority\n";
+        out_bytes(&out, header, strlen(header));
+    }
+    for (i = 0; i < n; i++) {
+        arrival_time += rand() % 21;
+        uint32_t service_time = 1 + rand() % 17;
+        int priority = rand() % 8;  // 二进制格式也取一次, 同一种子两种格式的到达和服务时间相同
+        if (binary) {
+            TraceRecord rec = {arrival_time, service_time, (uint32_t)i};
+            out_bytes(&out, (const char*)&rec, sizeof(rec));
+        } else {
+            out_bytes(&out, "job", 3);
+            out_uint(&out, i);
+            out_bytes(&out, ",", 1);
+            out_uint(&out, arrival_time);
+            out_bytes(&out, ",", 1);
+            out_uint(&out, service_time);
+            out_bytes(&out, ",", 1);
+            out_uint(&out, priority);
+            out_bytes(&out, "\n", 1);
+        }
+    }
+    out_flush(&out);
+    free(out.buffer);
+    if (fclose(file) != 0) {
+        perror(path);
+        return 1;
+    }
+    return 0;
+}
+
+// 重放轨迹: algorithm 为 "sjf" 或 "rr", output 为 NULL 时只输出汇总, "-" 表示标准输出
+int replay_trace(const char* path, const char* algorithm, int time_quantum, const char* output) {
+    TraceReader reader;
+    if (!trace_open(&reader, path)) return 1;
+    OutBuffer out = {NULL, NULL, 0};
+    StreamResults results = {NULL, 0, 0, 0, 0};
+    if (output != NULL) {
+        out.file = strcmp(output, "-") == 0 ? stdout : fopen(output, "w");
+        if (out.file == NULL) {
+            perror(output);
+            trace_close(&reader);
+            return 1;
+        }
+        out.buffer = malloc(OUT_BUFFER_SIZE);
+        results.out = &out;
+        const char* header = "name,completion,turnaround,weighted_turnaround\n";
+        out_bytes(&out, header, strlen(header));
+    }
+
+    ArrivalSource source = {trace_next, &reader};
+    CompletionSink sink = {stream_done, &results};
+    clock_t start = clock();
+    int peak;
+    if (strcmp(algorithm, "rr") == 0) {
+        peak = simulate_RR(&source, &sink, (Tick)time_quantum * TICKS_PER_UNIT);
+    } else {
+        peak = simulate_SJF(&source, &sink);
+    }
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    if (results.out != NULL) {
+        out_flush(&out);
+        free(out.buffer);
+        if (out.file != stdout) fclose(out.file);
+    }
+    trace_close(&reader);
+
+    if (reader.error != NULL) {
+        fprintf(stderr, "%s 第 %ld 条: %s\n", path, reader.line, reader.error);
+        return 1;
+    }
+    if (results.count == 0) {
+        fprintf(stderr, "%s: 没有进程\n", path);
+        return 1;
+    }
+    fprintf(stderr, "%s: %llu 个进程, 平均周转时间 %.2f, 平均带权周转时间 %.2f, 最大周转时间 %.2f\n",
+            strcmp(algorithm, "rr") == 0 ? "时间片轮转" : "抢占的短作业优先", results.count,
+            (double)results.total_turnaround_time / results.count / TICKS_PER_UNIT,
+            results.total_weighted_turnaround_time / results.count, (double)results.max_turnaround_time / TICKS_PER_UNIT);
+    fprintf(stderr, "用时 %.3f 秒, 每秒 %.0f 个进程, 同时在内存中的进程最多 %d 个\n", seconds,
+            results.count / (seconds > 0 ? seconds : 1e-9), peak);
+    return 0;
+}
+
+// ---------------- 多策略并行比较 ----------------
+// 轨迹只解析一次, 存成紧凑的只读数组由所有线程共享. 每个线程从共享计数器领取一个策略,
+// 用自己的游标从头读数组跑一遍模拟, 结果写进该策略自己的槽位, 除领取计数器外线程之间没有共享的可写数据
+
+#define SWEEP_MAX_QUANTA 64
+#define TAIL_SUB_BITS 7   // 每个 2 的幂区间再分 128 份, 分位数的相对误差不超过 1/128
+#define TAIL_BUCKETS (64 << TAIL_SUB_BITS)
+
+typedef enum { POLICY_FCFS, POLICY_SRTF, POLICY_RR, POLICY_PRIORITY, POLICY_MLFQ } PolicyKind;
+
+typedef struct {
+    Tick arrival_time;
+    Tick service_time;
+    int priority;
+} TraceJob;
+
+typedef struct {
+    const TraceJob* jobs;
+    int n;
+    int pos;
+    int speedup;  // 到达时间除以这个数, 用来按核数放大负载
+} JobArrivals;
+
+typedef struct {
+    PolicyKind kind;
+    int time_quantum;
+    int peak;
+    double seconds;
+    unsigned long long count;
+    Tick total_turnaround_time;
+    double total_weighted_turnaround_time;
+    Tick max_turnaround_time;
+    unsigned long long histogram[TAIL_BUCKETS];  // 周转时间刻度的对数线性直方图
+} SweepResult;
+
+typedef struct {
+    const TraceJob* jobs;
+    int n;
+    SweepResult* results;
+    int count;
+    atomic_int next;  // 下一个待领取的策略
+} SweepShared;
+
+int jobs_next(void* ctx, Process* p) {
+    JobArrivals* a = ctx;
+    if (a->pos == a->n) return 0;
+    const TraceJob* job = &a->jobs[a->pos];
+    memset(p, 0, sizeof(*p));
+    p->name = '#';
+    p->arrival_time = job->arrival_time / a->speedup;
+    p->service_time = job->service_time;
+    p->remaining_time = job->service_time;
+    p->priority = job->priority;
+    p->id = a->pos++;
+    return 1;
+}
+
+int tail_bucket(unsigned long long v) {
+    if (v < (1ULL << TAIL_SUB_BITS)) return (int)v;
+    int shift = 63 - __builtin_clzll(v) - TAIL_SUB_BITS;
+    return ((shift + 1) << TAIL_SUB_BITS) + (int)((v >> shift) & ((1 << TAIL_SUB_BITS) - 1));
+}
+
+// 桶 b 中最大的值
+unsigned long long tail_bucket_high(int b) {
+    if (b < (1 << TAIL_SUB_BITS)) return b;
+    int shift = (b >> TAIL_SUB_BITS) - 1;
+    unsigned long long low = (unsigned long long)((b & ((1 << TAIL_SUB_BITS) - 1)) | (1 << TAIL_SUB_BITS)) << shift;
+    return low + ((1ULL << shift) - 1);
+}
+
+// 周转时间的 q 分位数, 取所在桶的上界, 不超过最大值
+double tail_percentile(const SweepResult* r, double q) {
+    unsigned long long rank = (unsigned long long)ceil(q * r->count);
+    unsigned long long seen = 0;
+    int b;
+    for (b = 0; b < TAIL_BUCKETS; b++) {
+        seen += r->histogram[b];
+        if (seen >= rank && seen > 0) break;
+    }
+    Tick v = (Tick)tail_bucket_high(b);
+    return (double)(v < r->max_turnaround_time ? v : r->max_turnaround_time) / TICKS_PER_UNIT;
+}
+
+// 记一个时间, 计数、求和、最大值和直方图都按 total_turnaround_time 等字段存放
+void record_time(SweepResult* r, Tick t) {
+    r->count++;
+    r->total_turnaround_time += t;
+    if (t > r->max_turnaround_time) r->max_turnaround_time = t;
+    r->histogram[tail_bucket(t)]++;
+}
+
+void sweep_done(void* ctx, const Process* p) {
+    SweepResult* r = ctx;
+    record_time(r, p->turnaround_time);
+    r->total_weighted_turnaround_time += p->weighted_turnaround_time;
+}
+
+// clock() 统计的是整个进程的 CPU 时间, 多线程时每个策略用本线程的 CPU 时间, 总用时用墙钟
+double clock_seconds(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void run_policy(const TraceJob* jobs, int n, SweepResult* r) {
+    JobArrivals arrivals = {jobs, n, 0, 1};
+    ArrivalSource source = {jobs_next, &arrivals};
+    CompletionSink sink = {sweep_done, r};
+    double start = clock_seconds(CLOCK_THREAD_CPUTIME_ID);
+    switch (r->kind) {
+    case POLICY_FCFS:
+        r->peak = simulate_FCFS(&source, &sink);
+        break;
+    case POLICY_SRTF:
+        r->peak = simulate_SJF(&source, &sink);
+        break;
+    case POLICY_RR:
+        r->peak = simulate_RR(&source, &sink, (Tick)r->time_quantum * TICKS_PER_UNIT);
+        break;
+    case POLICY_PRIORITY:
+        r->peak = simulate_priority(&source, &sink);
+        break;
+    case POLICY_MLFQ:
+        r->peak = simulate_MLFQ(&source, &sink, (Tick)r->time_quantum * TICKS_PER_UNIT);
+        break;
+    }
+    r->seconds = clock_seconds(CLOCK_THREAD_CPUTIME_ID) - start;
+}
+
+void* sweep_worker(void* arg) {
+    SweepShared* shared = arg;
+    int i;
+    while ((i = atomic_fetch_add(&shared->next, 1)) < shared->count) {
+        run_policy(shared->jobs, shared->n, &shared->results[i]);
+    }
+    return NULL;
+}
+
+// 把整个轨迹读成 TraceJob 数组, 失败时返回 NULL
+TraceJob* load_jobs(const char* path, int* n) {
+    TraceReader reader;
+    if (!trace_open(&reader, path)) return NULL;
+    TraceJob* jobs = NULL;
+    int capacity = 0;
+    Process p;
+    *n = 0;
+    while (trace_next(&reader, &p)) {
+        if (*n == capacity) jobs = grow_array(jobs, &capacity, sizeof(TraceJob));
+        jobs[*n].arrival_time = p.arrival_time;
+        jobs[*n].service_time = p.service_time;
+        jobs[*n].priority = p.priority;
+        (*n)++;
+    }
+    trace_close(&reader);
+    if (reader.error != NULL) {
+        fprintf(stderr, "%s 第 %ld 条: %s\n", path, reader.line, reader.error);
+        free(jobs);
+        return NULL;
+    }
+    if (*n == 0) {
+        fprintf(stderr, "%s: 没有进程\n", path);
+        return NULL;
+    }
+    return jobs;
+}
+
+void policy_label(const SweepResult* r, char* label, size_t size) {
+    switch (r->kind) {
+    case POLICY_FCFS:
+        snprintf(label, size, "FCFS");
+        break;
+    case POLICY_SRTF:
+        snprintf(label, size, "SRTF");
+        break;
+    case POLICY_RR:
+        snprintf(label, size, "RR q=%d", r->time_quantum);
+        break;
+    case POLICY_PRIORITY:
+        snprintf(label, size, "PRIO");
+        break;
+    case POLICY_MLFQ:
+        snprintf(label, size, "MLFQ q=%d", r->time_quantum);
+        break;
+    }
+}
+
+// 在同一个轨迹上并行运行 FCFS、SRTF、各个时间片的 RR、优先级和 MLFQ, 输出比较表
+int sweep_trace(const char* path, const int quanta[], int quantum_count, int mlfq_quantum, int threads) {
+    int n;
+    double load_start = clock_seconds(CLOCK_MONOTONIC);
+    TraceJob* jobs = load_jobs(path, &n);
+    if (jobs == NULL) return 1;
+    double load_seconds = clock_seconds(CLOCK_MONOTONIC) - load_start;
+
+    SweepShared shared = {jobs, n, NULL, 0, 0};
+    shared.results = calloc(quantum_count + 4, sizeof(SweepResult));
+    shared.results[shared.count++].kind = POLICY_FCFS;
+    shared.results[shared.count++].kind = POLICY_SRTF;
+    int i;
+    for (i = 0; i < quantum_count; i++) {
+        shared.results[shared.count].kind = POLICY_RR;
+        shared.results[shared.count++].time_quantum = quanta[i];
+    }
+    shared.results[shared.count++].kind = POLICY_PRIORITY;
+    shared.results[shared.count].kind = POLICY_MLFQ;
+    shared.results[shared.count++].time_quantum = mlfq_quantum;
+    if (threads > shared.count) threads = shared.count;
+
+    pthread_t* workers = malloc(sizeof(pthread_t) * threads);
+    double start = clock_seconds(CLOCK_MONOTONIC);
+    for (i = 0; i < threads; i++) {
+        if (pthread_create(&workers[i], NULL, sweep_worker, &shared) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+    for (i = 0; i < threads; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    double wall = clock_seconds(CLOCK_MONOTONIC) - start;
+
+    printf("%d 个进程, 读入用时 %.3f 秒\n", n, load_seconds);
+    printf("策略          平均周转   平均带权       P50       P95       P99      最大 最多同时     用时\n");
+    double total_seconds = 0;
+    for (i = 0; i < shared.count; i++) {
+        const SweepResult* r = &shared.results[i];
+        char label[32];
+        policy_label(r, label, sizeof(label));
+        printf("%-10s %10.2f %10.2f %9.2f %9.2f %9.2f %9.2f %8d %8.3f\n", label,
+               (double)r->total_turnaround_time / r->count / TICKS_PER_UNIT, r->total_weighted_turnaround_time / r->count,
+               tail_percentile(r, 0.50), tail_percentile(r, 0.95), tail_percentile(r, 0.99),
+               (double)r->max_turnaround_time / TICKS_PER_UNIT, r->peak, r->seconds);
+        total_seconds += r->seconds;
+    }
+    printf("%d 个策略, %d 个线程, 各策略用时之和 %.3f 秒, 实际用时 %.3f 秒, 加速比 %.2f\n", shared.count, threads,
+           total_seconds, wall, total_seconds / (wall > 0 ? wall : 1e-9));
+    free(workers);
+    free(shared.results);
+    free(jobs);
+    return 0;
+}
+
+// ---------------- 多核调度 ----------------
+// 每个核有自己的就绪队列, 核内按时间片轮转. 新到达的进程按放置策略进入某个核的队列.
+// 空闲触发的窃取: 核空闲且自己的队列为空时, 从最长的队列尾部偷走一半;
+// 周期均衡: 每隔一段时间反复从负载最大的核往负载最小的核搬一个进程, 直到相差不超过 1.
+// 正在运行的核按本次时间片的结束时间放在最小堆里, 每个事件 O(log 核数);
+// 按最短队列放置、窃取和均衡时选核要扫描所有核, O(核数). 迁移本身不计开销
+
+#define MAX_CORES 1024
+#define BALANCE_IDLE 1      // 空闲时窃取
+#define BALANCE_PERIODIC 2  // 周期均衡
+
+typedef enum { PLACE_RR, PLACE_SHORTEST } PlacementKind;
+
+typedef struct {
+    int cores;
+    Tick time_quantum;       // 刻度, INT64_MAX 表示先来先服务
+    PlacementKind placement;
+    int balance;             // BALANCE_IDLE、BALANCE_PERIODIC 的组合
+    Tick balance_interval;   // 周期均衡的间隔, 刻度
+} MulticoreConfig;
+
+typedef struct {
+    ReadyQueue ready;
+    int running;      // 正在运行的槽位, -1 表示空闲; 空闲的核队列一定为空
+    Tick slice;       // 本次运行的长度
+    Tick slice_end;
+    Tick busy_time;
+    unsigned long long completed;
+    unsigned long long migrations_in;  // 从别的核迁来的进程数
+} CoreState;
+
+typedef struct {
+    CoreState* cores;
+    Tick first_arrival;
+    Tick makespan;    // 最后一个进程完成的时间
+    unsigned long long migrations;
+    int peak;
+} MulticoreResult;
+
+typedef struct {
+    const MulticoreConfig* config;
+    CoreState* cores;
+    int* events;      // 正在运行的核, 按 (slice_end, 核号) 的最小堆
+    int event_count;
+    ProcessPool pool;
+    unsigned long long migrations;
+} Multicore;
+
+int event_less(const Multicore* m, int a, int b) {
+    if (m->cores[a].slice_end != m->cores[b].slice_end) return m->cores[a].slice_end < m->cores[b].slice_end;
+    return a < b;
+}
+
+void event_push(Multicore* m, int core) {
+    int i = m->event_count++;
+    while (i > 0 && event_less(m, core, m->events[(i - 1) / 2])) {
+        m->events[i] = m->events[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    m->events[i] = core;
+}
+
+int event_pop(Multicore* m) {
+    int top = m->events[0];
+    int last = m->events[--m->event_count];
+    int i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= m->event_count) break;
+        if (child + 1 < m->event_count && event_less(m, m->events[child + 1], m->events[child])) child++;
+        if (!event_less(m, m->events[child], last)) break;
+        m->events[i] = m->events[child];
+        i = child;
+    }
+    if (m->event_count > 0) m->events[i] = last;
+    return top;
+}
+
+int queue_pop_back(ReadyQueue* q) {
+    q->count--;
+    return q->items[(q->head + q->count) % q->capacity];
+}
+
+int core_load(const CoreState* c) {
+    return c->ready.count + (c->running != -1);
+}
+
+// 核 c 从自己的队列取下一个进程开始运行, 队列不能为空
+void core_start(Multicore* m, int c, Tick now) {
+    CoreState* core = &m->cores[c];
+    core->running = queue_pop(&core->ready);
+    Tick remaining = m->pool.slots[core->running].remaining_time;
+    core->slice = remaining < m->config->time_quantum ? remaining : m->config->time_quantum;
+    core->slice_end = now + core->slice;
+    event_push(m, c);
+}
+
+void migrate(Multicore* m, int from, int to) {
+    queue_push(&m->cores[to].ready, queue_pop_back(&m->cores[from].ready));
+    m->cores[to].migrations_in++;
+    m->migrations++;
+}
+
+// 从队列最长的核尾部偷一半到核 c 的空队列, 返回是否偷到
+int steal_into(Multicore* m, int c) {
+    int victim = -1;
+    int i;
+    for (i = 0; i < m->config->cores; i++) {
+        if (i != c && m->cores[i].ready.count > 0 &&
+            (victim == -1 || m->cores[i].ready.count > m->cores[victim].ready.count)) {
+            victim = i;
+        }
+    }
+    if (victim == -1) return 0;
+    ReadyQueue* from = &m->cores[victim].ready;
+    int k = (from->count + 1) / 2;
+    // 保持原来的先后顺序
+    for (i = from->count - k; i < from->count; i++) {
+        queue_push(&m->cores[c].ready, from->items[(from->head + i) % from->capacity]);
     }
+    from->count -= k;
+    m->cores[c].migrations_in += k;
+    m->migrations += k;
+    return 1;
+}
 
-    while (completed < n) {
-        int found_process = 0;
+void balance_cores(Multicore* m, Tick now) {
+    for (;;) {
+        int high = 0, low = 0;
         int i;
-        for (i = 0; i < n; i++) {
-            // 如果该进程已到达且没有完成
-            if (processes[i].arrival_time <= current_time && !is_completed[i]) {
-                found_process = 1;
-                if (processes[i].remaining_time > 0) {
-                    if (processes[i].remaining_time > time_quantum) {
-                        current_time += time_quantum;
-                        processes[i].remaining_time -= time_quantum;
-                    } else {
-                        current_time += processes[i].remaining_time;
-                        processes[i].completion_time = current_time;
-                        processes[i].turnaround_time = processes[i].completion_time - processes[i].arrival_time;
-                        processes[i].weighted_turnaround_time = (float)processes[i].turnaround_time / processes[i].service_time;
-                        processes[i].remaining_time = 0;
-                        is_completed[i] = 1;
-                        completed++;
-                        break;
-                    }
-                }
-            }
+        for (i = 1; i < m->config->cores; i++) {
+            if (core_load(&m->cores[i]) > core_load(&m->cores[high])) high = i;
+            if (core_load(&m->cores[i]) < core_load(&m->cores[low])) low = i;
         }
+        if (core_load(&m->cores[high]) - core_load(&m->cores[low]) <= 1) break;
+        migrate(m, high, low);
+        if (m->cores[low].running == -1) core_start(m, low, now);
+    }
+}
 
-        // 若当前时间没有任何进程到达，直接推进到下一个到达时间
-        if (!found_process) {
-            int next_arrival_time = INT_MAX;
-            int i;
-            for (i = 0; i < n; i++) {
-                if (!is_completed[i] && processes[i].arrival_time > current_time) {
-                    next_arrival_time = fmin(next_arrival_time, processes[i].arrival_time);
-                }
+// 按轮转或最短队列选核. 最短队列从上次选中的下一个核开始找, 负载相同时不总偏向编号小的核
+int place_arrival(Multicore* m, int* cursor) {
+    int cores = m->config->cores;
+    int best = *cursor;
+    if (m->config->placement == PLACE_SHORTEST) {
+        int i;
+        for (i = 1; i < cores && core_load(&m->cores[best]) > 0; i++) {
+            int c = (*cursor + i) % cores;
+            if (core_load(&m->cores[c]) < core_load(&m->cores[best])) best = c;
+        }
+    }
+    *cursor = (best + 1) % cores;
+    return best;
+}
+
+// 多核模拟. 同一时刻先处理到达, 再处理时间片结束, 最后是周期均衡, 所以单核、不窃取时与 simulate_RR 结果相同.
+// result->cores 由调用者释放
+void simulate_multicore(ArrivalSource* source, CompletionSink* sink, const MulticoreConfig* config,
+                        MulticoreResult* result) {
+    Multicore m = {config, calloc(config->cores, sizeof(CoreState)), malloc(sizeof(int) * config->cores), 0, {0}, 0};
+    Process next;
+    int has_next = source->next(source->ctx, &next);
+    int cursor = 0;
+    int i;
+    for (i = 0; i < config->cores; i++) {
+        m.cores[i].running = -1;
+    }
+    result->first_arrival = has_next ? next.arrival_time : 0;
+    result->makespan = result->first_arrival;
+    Tick next_balance = (config->balance & BALANCE_PERIODIC) ? config->balance_interval : INT64_MAX;
+
+    while (has_next || m.event_count > 0) {
+        Tick core_time = m.event_count > 0 ? m.cores[m.events[0]].slice_end : INT64_MAX;
+        Tick arrival_time = has_next ? next.arrival_time : INT64_MAX;
+        if (arrival_time <= core_time && arrival_time <= next_balance) {
+            int slot = pool_add(&m.pool, &next);
+            int c = place_arrival(&m, &cursor);
+            queue_push(&m.cores[c].ready, slot);
+            if (m.cores[c].running == -1) {
+                core_start(&m, c, arrival_time);
+            } else if ((config->balance & BALANCE_IDLE) && m.event_count < config->cores) {
+                // 有空闲的核, 让它来偷
+                int idle = 0;
+                while (m.cores[idle].running != -1) idle++;
+                steal_into(&m, idle);
+                core_start(&m, idle, arrival_time);
+            }
+            has_next = source->next(source->ctx, &next);
+        } else if (core_time <= next_balance) {
+            int c = event_pop(&m);
+            CoreState* core = &m.cores[c];
+            Process* p = &m.pool.slots[core->running];
+            p->remaining_time -= core->slice;
+            core->busy_time += core->slice;
+            if (p->remaining_time == 0) {
+                complete_process(&m.pool, core->running, core_time, sink);
+                core->completed++;
+                result->makespan = core_time;
+            } else {
+                queue_push(&core->ready, core->running);
+            }
+            core->running = -1;
+            if (core->ready.count > 0 || ((config->balance & BALANCE_IDLE) && steal_into(&m, c))) {
+                core_start(&m, c, core_time);
             }
-            // 如果找到了下一个到达时间，则将当前时间推移到下一个到达时间
-            if (next_arrival_time != INT_MAX) {
-                current_time = next_arrival_time;
+        } else {
+            if (m.pool.active > m.event_count) {
+                balance_cores(&m, next_balance);
+                next_balance += config->balance_interval;
+            } else {
+                // 没有排队的进程, 直接跳到下一个事件之后的周期
+                Tick t = arrival_time < core_time ? arrival_time : core_time;
+                next_balance = (t / config->balance_interval + 1) * config->balance_interval;
             }
         }
     }
+    for (i = 0; i < config->cores; i++) {
+        free(m.cores[i].ready.items);
+    }
+    free(m.events);
+    pool_free(&m.pool);
+    result->cores = m.cores;
+    result->migrations = m.migrations;
+    result->peak = m.pool.peak;
+}
+
+// 周转时间和等待时间(周转时间减服务时间)的分布
+typedef struct {
+    SweepResult turnaround;
+    SweepResult waiting;
+} MulticoreTimes;
+
+void multicore_done(void* ctx, const Process* p) {
+    MulticoreTimes* t = ctx;
+    sweep_done(&t->turnaround, p);
+    record_time(&t->waiting, p->turnaround_time - p->service_time);
+}
+
+// 对每个核数在同一个轨迹上模拟一遍, 每个核数一行汇总; 只有一个核数时再列出每个核
+int multicore_trace(const char* path, const int core_counts[], int count, MulticoreConfig config, int speedup) {
+    int n;
+    TraceJob* jobs = load_jobs(path, &n);
+    if (jobs == NULL) return 1;
+    MulticoreTimes* times = malloc(sizeof(MulticoreTimes));
+    printf("%d 个进程, 到达加速 %d 倍\n", n, speedup);
+    printf("核数  平均周转       P50       P95       P99  平均等待  P99等待  平均利用率  最低    最高      迁移次数   用时\n");
+    int i;
+    for (i = 0; i < count; i++) {
+        config.cores = core_counts[i];
+        memset(times, 0, sizeof(*times));
+        JobArrivals arrivals = {jobs, n, 0, speedup};
+        ArrivalSource source = {jobs_next, &arrivals};
+        CompletionSink sink = {multicore_done, times};
+        MulticoreResult result;
+        double start = clock_seconds(CLOCK_MONOTONIC);
+        simulate_multicore(&source, &sink, &config, &result);
+        double seconds = clock_seconds(CLOCK_MONOTONIC) - start;
+
+        Tick span = result.makespan - result.first_arrival;
+        double total_utilization = 0, min_utilization = 1, max_utilization = 0;
+        int c;
+        for (c = 0; c < config.cores; c++) {
+            double u = span > 0 ? (double)result.cores[c].busy_time / span : 0;
+            total_utilization += u;
+            if (u < min_utilization) min_utilization = u;
+            if (u > max_utilization) max_utilization = u;
+        }
+        const SweepResult* t = &times->turnaround;
+        const SweepResult* w = &times->waiting;
+        printf("%4d %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %9.1f%% %5.1f%% %5.1f%% %13llu %6.3f\n", config.cores,
+               (double)t->total_turnaround_time / t->count / TICKS_PER_UNIT, tail_percentile(t, 0.50),
+               tail_percentile(t, 0.95), tail_percentile(t, 0.99),
+               (double)w->total_turnaround_time / w->count / TICKS_PER_UNIT, tail_percentile(w, 0.99),
+               100 * total_utilization / config.cores, 100 * min_utilization, 100 * max_utilization,
+               result.migrations, seconds);
+        if (count == 1) {
+            printf("\n核  利用率      完成数      迁入数\n");
+            for (c = 0; c < config.cores; c++) {
+                printf("%3d %6.1f%% %11llu %11llu\n", c,
+                       span > 0 ? 100.0 * result.cores[c].busy_time / span : 0.0, result.cores[c].completed,
+                       result.cores[c].migrations_in);
+            }
+        }
+        free(result.cores);
+    }
+    free(times);
+    free(jobs);
+    return 0;
 }
 
-void print_results(Process processes[], int n) {
-    float total_turnaround_time = 0.0, total_weighted_turnaround_time = 0.0;
+void print_results(const ProcessTable* t) {
+    int n = t->n;
     
     printf("进程  完成时间  周转时间  带权周转时间\n");
     int i;
     for (i = 0; i < n; i++) {
         printf("%c     %.2f     %.2f     %.2f\n", 
-                processes[i].name, 
-                processes[i].completion_time, 
-                processes[i].turnaround_time, 
-                processes[i].weighted_turnaround_time);
-        
-        total_turnaround_time += processes[i].turnaround_time;
-        total_weighted_turnaround_time += processes[i].weighted_turnaround_time;
-    }
-
-    printf("平均周转时间: %.2f\n", total_turnaround_time / n);
-    printf("平均带权周转时间: %.2f\n", total_weighted_turnaround_time / n);
-}
-
-int main() {
-    Process processes[MAX_PROCESSES] = {
-        {'A', 0, 3, 3, 0, 0, 0.0},
-        {'B', 2, 6, 6, 0, 0, 0.0},
-        {'C', 4, 4, 4, 0, 0, 0.0},
-        {'D', 6, 5, 5, 0, 0, 0.0},
-        {'E', 8, 2, 2, 0, 0, 0.0}
-    };
+                t->name[i], 
+                (double)t->completion_time[i] / TICKS_PER_UNIT, 
+                (double)t->turnaround_time[i] / TICKS_PER_UNIT, 
+                (double)t->turnaround_time[i] / t->service_time[i]);
+    }
 
-    // 运行 SJF 调度
-    printf("抢占的短作业优先 (SJF) 调度:\n");
-    calculate_SJF(processes, MAX_PROCESSES);
-    print_results(processes, MAX_PROCESSES);
-    
-    // 重新初始化进程剩余时间
+    printf("平均周转时间: %.2f\n", (double)total_turnaround(t) / n / TICKS_PER_UNIT);
+    printf("平均带权周转时间: %.2f\n", total_weighted_turnaround(t) / n);
+}
+
+// 随机生成 n 个进程: 到达间隔 0~20, 服务时间 1~17, CPU 负载约 90%
+ProcessTable random_processes(int n, unsigned seed) {
+    ProcessTable t = table_alloc(n);
+    Tick arrival_time = 0;
+    int i;
+    srand(seed);
+    for (i = 0; i < n; i++) {
+        arrival_time += (Tick)(rand() % 21) * TICKS_PER_UNIT;
+        t.name[i] = 'A' + i % 26;
+        t.arrival_time[i] = arrival_time;
+        t.service_time[i] = (Tick)(1 + rand() % 17) * TICKS_PER_UNIT;
+    }
+    return t;
+}
+
+void print_summary(const char* title, const ProcessTable* t, double seconds) {
+    printf("%s: 平均周转时间 %.2f, 平均带权周转时间 %.2f, 用时 %.3f 秒\n", title,
+           (double)total_turnaround(t) / t->n / TICKS_PER_UNIT, total_weighted_turnaround(t) / t->n, seconds);
+}
+
+// 用 n 个随机进程测试两种算法的规模
+int random_main(int n, unsigned seed, int time_quantum) {
+    if (n <= 0 || time_quantum <= 0) {
+        printf("进程数和时间片必须为正数\n");
+        return 1;
+    }
+    ProcessTable table = random_processes(n, seed);
+    printf("%d 个随机进程 (种子 %u)\n", n, seed);
+    clock_t start = clock();
+    calculate_SJF(&table);
+    print_summary("抢占的短作业优先", &table, (double)(clock() - start) / CLOCKS_PER_SEC);
+    start = clock();
+    calculate_RR(&table, time_quantum);
+    printf("时间片 %d ", time_quantum);
+    print_summary("时间片轮转", &table, (double)(clock() - start) / CLOCKS_PER_SEC);
+    table_free(&table);
+    return 0;
+}
+
+// 解析 trace 命令的参数并重放
+int trace_main(int argc, char* argv[]) {
+    const char* algorithm = "sjf";
+    const char* output = NULL;
+    int time_quantum = 1;
+    int i;
+    for (i = 3; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-a") == 0) {
+            algorithm = argv[i + 1];
+        } else if (strcmp(argv[i], "-q") == 0) {
+            time_quantum = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-o") == 0) {
+            output = argv[i + 1];
+        } else {
+            break;
+        }
+    }
+    if (argc < 3 || i != argc || (strcmp(algorithm, "sjf") != 0 && strcmp(algorithm, "rr") != 0) ||
+        time_quantum <= 0) {
+        printf("用法: %s trace 轨迹文件 [-a sjf|rr] [-q 时间片] [-o 结果文件|-]\n", argv[0]);
+        return 1;
+    }
+    return replay_trace(argv[2], algorithm, time_quantum, output);
+}
+
+// 解析逗号分隔的正整数列表, 最多 max 个, 成功时返回 1
+int parse_int_list(const char* s, int list[], int max, int* count) {
+    *count = 0;
+    while (*s != '\0') {
+        char* end;
+        long v = strtol(s, &end, 10);
+        if (end == s || v <= 0 || v > INT_MAX || *count == max || (*end != ',' && *end != '\0')) return 0;
+        list[(*count)++] = (int)v;
+        s = *end == ',' ? end + 1 : end;
+    }
+    return 1;
+}
+
+// 解析 sweep 命令的参数: -q 后是逗号分隔的时间片列表
+int sweep_main(int argc, char* argv[]) {
+    int quanta[SWEEP_MAX_QUANTA] = {1, 2, 4, 8, 16};
+    int quantum_count = 5;
+    int mlfq_quantum = 1;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int ok = argc >= 3;
+    int i;
+    for (i = 3; ok && i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-q") == 0) {
+            ok = parse_int_list(argv[i + 1], quanta, SWEEP_MAX_QUANTA, &quantum_count);
+        } else if (strcmp(argv[i], "-m") == 0) {
+            mlfq_quantum = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-t") == 0) {
+            threads = atol(argv[i + 1]);
+        } else {
+            break;
+        }
+    }
+    if (!ok || i != argc || mlfq_quantum <= 0 || threads <= 0) {
+        printf("用法: %s sweep 轨迹文件 [-q 时间片,时间片,...] [-m 多级反馈最高级时间片] [-t 线程数]\n", argv[0]);
+        return 1;
+    }
+    return sweep_trace(argv[2], quanta, quantum_count, mlfq_quantum, (int)threads);
+}
+
+// 解析 multicore 命令的参数: -c 后是逗号分隔的核数列表, -q 0 表示先来先服务
+int multicore_main(int argc, char* argv[]) {
+    int core_counts[64] = {4};
+    int count = 1;
+    int time_quantum = 1;
+    int balance_interval = 10;
+    int speedup = 1;
+    MulticoreConfig config = {0, 0, PLACE_RR, BALANCE_IDLE, 0};
+    int ok = argc >= 3;
+    int i;
+    for (i = 3; ok && i + 1 < argc; i += 2) {
+        const char* value = argv[i + 1];
+        if (strcmp(argv[i], "-c") == 0) {
+            ok = parse_int_list(value, core_counts, 64, &count);
+        } else if (strcmp(argv[i], "-q") == 0) {
+            time_quantum = atoi(value);
+            ok = time_quantum >= 0;
+        } else if (strcmp(argv[i], "-p") == 0) {
+            ok = strcmp(value, "rr") == 0 || strcmp(value, "short") == 0;
+            config.placement = strcmp(value, "short") == 0 ? PLACE_SHORTEST : PLACE_RR;
+        } else if (strcmp(argv[i], "-s") == 0) {
+            ok = strcmp(value, "none") == 0 || strcmp(value, "idle") == 0 || strcmp(value, "periodic") == 0 ||
+                 strcmp(value, "both") == 0;
+            config.balance = (strcmp(value, "idle") == 0 || strcmp(value, "both") == 0 ? BALANCE_IDLE : 0) |
+                             (strcmp(value, "periodic") == 0 || strcmp(value, "both") == 0 ? BALANCE_PERIODIC : 0);
+        } else if (strcmp(argv[i], "-b") == 0) {
+            balance_interval = atoi(value);
+            ok = balance_interval > 0;
+        } else if (strcmp(argv[i], "-x") == 0) {
+            speedup = atoi(value);
+            ok = speedup > 0;
+        } else {
+            break;
+        }
+    }
+    ok = ok && i == argc;
+    for (i = 0; ok && i < count; i++) {
+        ok = core_counts[i] <= MAX_CORES;
+    }
+    if (!ok) {
+        printf("用法: %s multicore 轨迹文件 [-c 核数,核数,...] [-q 时间片, 0 为先来先服务] [-p rr|short]\n"
+               "       [-s none|idle|periodic|both] [-b 均衡周期] [-x 到达加速倍数]\n", argv[0]);
+        return 1;
+    }
+    config.time_quantum = time_quantum > 0 ? (Tick)time_quantum * TICKS_PER_UNIT : INT64_MAX;
+    config.balance_interval = (Tick)balance_interval * TICKS_PER_UNIT;
+    return multicore_trace(argv[2], core_counts, count, config, speedup);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && strcmp(argv[1], "trace") == 0) {
+        return trace_main(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "sweep") == 0) {
+        return sweep_main(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "multicore") == 0) {
+        return multicore_main(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "gen-trace") == 0) {
+        if (argc < 4) {
+            printf("用法: %s gen-trace 轨迹文件 进程数 [种子] [csv|bin]\n", argv[0]);
+            return 1;
+        }
+        return write_trace(argv[2], atol(argv[3]), argc > 4 ? (unsigned)atoi(argv[4]) : 1,
+                           argc > 5 && strcmp(argv[5], "bin") == 0);
+    }
+    if (argc > 1 && strcmp(argv[1], "random") == 0) {
+        if (argc < 3) {
+            printf("用法: %s random 进程数 [种子] [时间片]\n", argv[0]);
+            return 1;
+        }
+        return random_main(atoi(argv[2]), argc > 3 ? (unsigned)atoi(argv[3]) : 1, argc > 4 ? atoi(argv[4]) : 1);
+    }
+
+    // 进程名, 到达时间, 服务时间
+    static const struct { char name; int arrival_time; int service_time; } example[MAX_PROCESSES] = {
+        {'A', 0, 3},
+        {'B', 2, 6},
+        {'C', 4, 4},
+        {'D', 6, 5},
+        {'E', 8, 2}
+    };
+    ProcessTable table = table_alloc(MAX_PROCESSES);
     int i;
     for (i = 0; i < MAX_PROCESSES; i++) {
-        processes[i].remaining_time = processes[i].service_time;
-        processes[i].completion_time = 0;
-        processes[i].turnaround_time = 0;
-        processes[i].weighted_turnaround_time = 0.0;
+        table.name[i] = example[i].name;
+        table.arrival_time[i] = (Tick)example[i].arrival_time * TICKS_PER_UNIT;
+        table.service_time[i] = (Tick)example[i].service_time * TICKS_PER_UNIT;
     }
 
-    // 运行 RR 调度
+    // 运行 SJF 调度
+    printf("抢占的短作业优先 (SJF) 调度:\n");
+    calculate_SJF(&table);
+    print_results(&table);
+
+    // 运行 RR 调度, 输入列不会被模拟修改, 不需要重新初始化
     printf("\n时间片轮转 (RR) 调度:\n");
-    calculate_RR(processes, MAX_PROCESSES, 1);
-    print_results(processes, MAX_PROCESSES);
+    calculate_RR(&table, 1);
+    print_results(&table);
 
+    table_free(&table);
     return 0;
 }
\ No newline at end of file
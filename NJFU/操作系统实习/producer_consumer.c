@@ -1,5 +1,20 @@
+#define _GNU_SOURCE  // pthread_attr_setaffinity_np
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sched.h>
+#include <limits.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <unistd.h>
 #include <pthread.h>
 #include <semaphore.h>
 
@@ -9,6 +24,25 @@
 #define PRODUCER_LOOP 4 // 每个生产者生产次数 
 #define CONSUMER_LOOP 6 // 每个消费者消费次数
 
+#define CACHE_LINE 64          // 缓存行大小, 不同线程频繁写的变量放在不同缓存行, 避免伪共享
+#define BENCH_K 1024           // 吞吐量测试默认的缓冲区大小, 环形队列要求是 2 的幂
+#define BENCH_ITEMS 1000000    // 吞吐量测试中每个生产者默认的生产次数
+#define SPIN_LIMIT 64          // yield 策略先自旋的次数, 之后每次让出 CPU
+#define SPIN_PARK_LIMIT 4096   // spinpark 策略挂起前自旋的次数
+#define ADAPTIVE_SPIN_MIN 16   // adaptive 策略自旋次数的范围
+#define ADAPTIVE_SPIN_MAX 65536
+#define PARK_WORTH_NS 50000    // 挂起后这么快就被唤醒, 说明多自旋一会儿就能避免挂起
+#define MAX_BATCH 1024         // 批量放入/取出的最大个数
+#define BRING_BYTES (1 << 18)  // 字节环形队列默认的容量
+#define BRING_HDR 8            // 每条消息前的头部: 4 字节长度, 其余为填充, 使负载按 8 字节对齐
+#define BRING_PAD UINT32_MAX   // 长度为此值的头部表示跳到数据区开头
+#define BRING_TOO_LARGE ((void*)-1)  // bring_reserve 的返回值: 负载超过 bring_max_payload, 永远放不下
+#define STEAL_CHUNK 64         // 分发模式下消费者每次从入站队列取出的个数, 也是汇报进度的间隔
+#define STATS_MAX_THREADS 1024 // 统计表能登记的线程数, 超出的线程不单独统计
+#define STATS_DEPTH_BUCKETS 18 // 队列长度直方图: 0, 1, 2-3, 4-7, ..., >= 65536
+#define STATS_SAMPLE_MASK 63   // 每个线程每 64 次操作采样一次队列长度
+#define STATS_INTERVAL_MS 1000 // 默认每秒输出一次统计快照
+
 // 缓冲区相关数据结构
 int buffer[K];    // 缓冲区数组
 int in = 0;       // 生产者放入位置
@@ -19,16 +53,278 @@ sem_t s1;         // 同步信号量,控制缓冲区不满
 sem_t s2;         // 同步信号量,控制缓冲区不空
 sem_t mutex;      // 互斥信号量,控制缓冲区互斥访问
 
+// ---------------- 运行统计 ----------------
+// 每个线程只写自己的一行(独占缓存行), 不需要原子的读-改-写, 快照线程随时可以读.
+// 阻塞时间只在真的要等待时才读时钟: 先 sem_trywait, 成功就不计时.
+// 编译时定义 PC_NO_STATS 则全部去掉
+
+typedef enum { STAT_FULL, STAT_EMPTY, STAT_MUTEX, STAT_KINDS } stat_kind_t;
+
+int64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+#ifndef PC_NO_STATS
+
+static const char* const stat_names[] = {"full", "empty", "mutex"};
+
+typedef struct {
+    _Alignas(CACHE_LINE) const char* role;
+    int id;
+    atomic_int ready;                        // role 和 id 填好后才置 1, 快照跳过未填好的行
+    atomic_llong blocked_ns[STAT_KINDS];     // 在 s1(满)、s2(空)、mutex 上阻塞的总时间
+    atomic_llong blocked_count[STAT_KINDS];  // 阻塞的次数
+    atomic_llong items;                      // 放入或取出的产品数
+    atomic_llong depth[STATS_DEPTH_BUCKETS]; // 采样得到的队列长度直方图
+} thread_stats_t;
+
+static thread_stats_t stats_table[STATS_MAX_THREADS];
+static thread_stats_t stats_overflow;  // 表满后的线程共用, 不输出
+static atomic_int stats_count;
+static _Thread_local thread_stats_t* stats_self = &stats_overflow;
+static _Thread_local unsigned stats_ops;
+
+// 只有本线程写, 读-加-写即可
+void stat_add(atomic_llong* counter, long long v) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + v, memory_order_relaxed);
+}
+
+long long stat_get(atomic_llong* counter) {
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+// 清空统计表, 只能在没有线程登记着运行时调用
+void stats_reset() {
+    int n = atomic_load(&stats_count);
+    memset(stats_table, 0, sizeof(thread_stats_t) * (n < STATS_MAX_THREADS ? n : STATS_MAX_THREADS));
+    atomic_store(&stats_count, 0);
+}
+
+// 线程开始时登记自己, 之后的统计都记到这一行
+void stats_register(const char* role, int id) {
+    int i = atomic_fetch_add(&stats_count, 1);
+    stats_self = i < STATS_MAX_THREADS ? &stats_table[i] : &stats_overflow;
+    stats_self->role = role;
+    stats_self->id = id;
+    atomic_store_explicit(&stats_self->ready, 1, memory_order_release);
+}
+
+// 只在统计打开时读时钟, 用于只在慢路径上计时的地方
+int64_t stats_clock() {
+    return now_ns();
+}
+
+void stats_blocked(stat_kind_t kind, int64_t ns) {
+    stat_add(&stats_self->blocked_ns[kind], ns);
+    stat_add(&stats_self->blocked_count[kind], 1);
+}
+
+void stats_items(long n) {
+    stat_add(&stats_self->items, n);
+}
+
+// 本次操作是否要采样队列长度
+int stats_sample() {
+    return (stats_ops++ & STATS_SAMPLE_MASK) == 0;
+}
+
+void stats_depth(long depth) {
+    int b = depth <= 0 ? 0 : 64 - __builtin_clzll((unsigned long long)depth);
+    stat_add(&stats_self->depth[b < STATS_DEPTH_BUCKETS ? b : STATS_DEPTH_BUCKETS - 1], 1);
+}
+
+// 计时的 P 操作: 不需要等待时和 sem_wait 一样只有一次原子操作
+void timed_sem_wait(sem_t* s, stat_kind_t kind) {
+    if(sem_trywait(s) == 0) {
+        return;
+    }
+    int64_t start = now_ns();
+    while(sem_wait(s) != 0);
+    stats_blocked(kind, now_ns() - start);
+}
+
+// 直方图中第 q 分位所在桶的上界
+long stats_depth_percentile(const long long* depth, double q) {
+    long long total = 0, seen = 0;
+    for(int b = 0; b < STATS_DEPTH_BUCKETS; b++) total += depth[b];
+    for(int b = 0; b < STATS_DEPTH_BUCKETS; b++) {
+        seen += depth[b];
+        if(total > 0 && seen >= q * total) {
+            return b == 0 ? 0 : (1L << b) - 1;
+        }
+    }
+    return 0;
+}
+
+// 输出一次快照: 文本格式先输出合计, 再每线程一行; JSON 格式整个快照占一行, 便于逐行解析
+void stats_snapshot(FILE* out, int json, double seconds) {
+    int n = atomic_load(&stats_count);
+    if(n > STATS_MAX_THREADS) n = STATS_MAX_THREADS;
+    long long total_ns[STAT_KINDS] = {0}, total_count[STAT_KINDS] = {0}, total_put = 0, total_get = 0;
+    long long depth[STATS_DEPTH_BUCKETS] = {0};
+    int shown = 0;
+    if(json) {
+        fprintf(out, "{\"time\":%.3f,\"threads\":[", seconds);
+    } else {
+        fprintf(out, "[统计 %.3f 秒]\n", seconds);
+    }
+    for(int i = 0; i < n; i++) {
+        thread_stats_t* t = &stats_table[i];
+        if(!atomic_load_explicit(&t->ready, memory_order_acquire)) {
+            continue;
+        }
+        long long ns[STAT_KINDS], count[STAT_KINDS], items = stat_get(&t->items);
+        for(int k = 0; k < STAT_KINDS; k++) {
+            ns[k] = stat_get(&t->blocked_ns[k]);
+            count[k] = stat_get(&t->blocked_count[k]);
+            total_ns[k] += ns[k];
+            total_count[k] += count[k];
+        }
+        for(int b = 0; b < STATS_DEPTH_BUCKETS; b++) depth[b] += stat_get(&t->depth[b]);
+        const char* role = t->role;
+        if(strcmp(role, "producer") == 0) {
+            total_put += items;
+        } else {
+            total_get += items;
+        }
+        if(json) {
+            fprintf(out, "%s{\"role\":\"%s\",\"id\":%d,\"items\":%lld", shown++ > 0 ? "," : "", role, t->id,
+                    items);
+            for(int k = 0; k < STAT_KINDS; k++) {
+                fprintf(out, ",\"%s_ns\":%lld,\"%s_count\":%lld", stat_names[k], ns[k], stat_names[k], count[k]);
+            }
+            fprintf(out, "}");
+        } else {
+            fprintf(out, "  %s %d: 产品 %lld", role, t->id, items);
+            for(int k = 0; k < STAT_KINDS; k++) {
+                fprintf(out, ", %s %.3f 毫秒/%lld 次", stat_names[k], ns[k] / 1e6, count[k]);
+            }
+            fprintf(out, "\n");
+        }
+    }
+    if(json) {
+        fprintf(out, "],\"total\":{\"put\":%lld,\"get\":%lld", total_put, total_get);
+        for(int k = 0; k < STAT_KINDS; k++) {
+            fprintf(out, ",\"%s_ns\":%lld,\"%s_count\":%lld", stat_names[k], total_ns[k], stat_names[k],
+                    total_count[k]);
+        }
+        fprintf(out, ",\"depth\":[");
+        for(int b = 0; b < STATS_DEPTH_BUCKETS; b++) fprintf(out, "%s%lld", b > 0 ? "," : "", depth[b]);
+        fprintf(out, "]}}\n");
+    } else {
+        fprintf(out, "  合计: 放入 %lld, 取出 %lld", total_put, total_get);
+        for(int k = 0; k < STAT_KINDS; k++) {
+            fprintf(out, ", %s %.3f 毫秒/%lld 次", stat_names[k], total_ns[k] / 1e6, total_count[k]);
+        }
+        fprintf(out, ", 队列长度 p50 <= %ld, p99 <= %ld\n", stats_depth_percentile(depth, 0.5),
+                stats_depth_percentile(depth, 0.99));
+    }
+    fflush(out);
+}
+
+#else
+
+#define stats_clock() 0
+#define stats_reset() ((void)0)
+#define stats_register(role, id) ((void)0)
+#define stats_blocked(kind, ns) ((void)(kind), (void)(ns))
+#define stats_items(n) ((void)0)
+#define stats_sample() 0
+#define stats_depth(depth) ((void)0)
+#define timed_sem_wait(s, kind) sem_wait(s)
+
+#endif
+
+// 定期输出统计快照的线程
+typedef struct {
+    int enabled;
+    int json;
+    int interval_ms;
+    int64_t start;
+    atomic_int stop;
+    pthread_t tid;
+} stats_reporter_t;
+
+void* stats_reporter_main(void* arg) {
+#ifndef PC_NO_STATS
+    stats_reporter_t* r = arg;
+    int64_t next = r->start + (int64_t)r->interval_ms * 1000000;
+    while(!atomic_load(&r->stop)) {
+        struct timespec ts = {0, 10 * 1000000};  // 每 10 毫秒检查一次是否该结束
+        nanosleep(&ts, NULL);
+        int64_t now = now_ns();
+        if(now >= next) {
+            stats_snapshot(stdout, r->json, (now - r->start) / 1e9);
+            next += (int64_t)r->interval_ms * 1000000;
+        }
+    }
+#else
+    (void)arg;
+#endif
+    return NULL;
+}
+
+// 清空统计, 需要时开始定期输出快照, 要在工作线程创建之前调用
+void stats_start(stats_reporter_t* r) {
+    stats_reset();
+    if(!r->enabled) {
+        return;
+    }
+#ifndef PC_NO_STATS
+    r->start = now_ns();
+    atomic_store(&r->stop, 0);
+    pthread_create(&r->tid, NULL, stats_reporter_main, r);
+#else
+    printf("编译时定义了 PC_NO_STATS, 没有统计可输出\n");
+#endif
+}
+
+// 停止定期输出, 再输出一次最终的快照, 要在工作线程全部结束之后调用
+void stats_stop(stats_reporter_t* r) {
+    if(!r->enabled) {
+        return;
+    }
+#ifndef PC_NO_STATS
+    atomic_store(&r->stop, 1);
+    pthread_join(r->tid, NULL);
+    stats_snapshot(stdout, r->json, (now_ns() - r->start) / 1e9);
+#endif
+}
+
+// 解析 --stats text|json 和 --stats-interval 毫秒, 识别并消耗了参数返回 1, 参数有误返回 -1
+int stats_parse_option(stats_reporter_t* r, const char* opt, const char* val) {
+    if(strcmp(opt, "--stats") == 0) {
+        if(val == NULL || (strcmp(val, "text") != 0 && strcmp(val, "json") != 0)) {
+            return -1;
+        }
+        r->enabled = 1;
+        r->json = strcmp(val, "json") == 0;
+        return 1;
+    }
+    if(strcmp(opt, "--stats-interval") == 0) {
+        if(val == NULL || atoi(val) <= 0) {
+            return -1;
+        }
+        r->interval_ms = atoi(val);
+        return 1;
+    }
+    return 0;
+}
+
 // 生产者线程函数
 void* producer(void* arg) {
     int id = *(int*)arg;
     int item;
+    int depth;
     
+    stats_register("producer", id);
     for(int i = 0; i < PRODUCER_LOOP; i++) {
         item = rand() % 100;  // 生产一个随机数
         
-        sem_wait(&s1);        // P(s1) 
-        sem_wait(&mutex);     // P(mutex)
+        timed_sem_wait(&s1, STAT_FULL);      // P(s1) 
+        timed_sem_wait(&mutex, STAT_MUTEX);  // P(mutex)
         
         buffer[in] = item;
         printf("producer %d produced %d in %d\n", id, item, in);
@@ -36,6 +332,10 @@ void* producer(void* arg) {
         
         sem_post(&mutex);     // V(mutex)
         sem_post(&s2);        // V(s2)
+        stats_items(1);
+        if(stats_sample() && sem_getvalue(&s2, &depth) == 0) {
+            stats_depth(depth);
+        }
         
         sleep(rand() % 3);    // 随机等待一段时间
     }
@@ -46,10 +346,12 @@ void* producer(void* arg) {
 void* consumer(void* arg) {
     int id = *(int*)arg;
     int item;
+    int depth;
     
+    stats_register("consumer", id);
     for(int i = 0; i < CONSUMER_LOOP; i++) {
-        sem_wait(&s2);        // P(s2)
-        sem_wait(&mutex);     // P(mutex)
+        timed_sem_wait(&s2, STAT_EMPTY);     // P(s2)
+        timed_sem_wait(&mutex, STAT_MUTEX);  // P(mutex)
         
         item = buffer[out];
         printf("consumer %d consumed %d in %d\n", id, item, out);
@@ -57,20 +359,1616 @@ void* consumer(void* arg) {
         
         sem_post(&mutex);     // V(mutex)
         sem_post(&s1);        // V(s1)
+        stats_items(1);
+        if(stats_sample() && sem_getvalue(&s2, &depth) == 0) {
+            stats_depth(depth);
+        }
         
         sleep(rand() % 3);    // 随机等待一段时间
     }
     pthread_exit(NULL);
 }
 
-int main() {
+// ---------------- 吞吐量测试用的缓冲区 ----------------
+
+// 测试中传递的产品: 带上放入时的时间戳, 取出时据此计算延迟
+typedef struct {
+    int64_t value;
+    int64_t enqueue_ns;
+} item_t;
+
+// 信号量缓冲区: 与上面的演示相同的 s1/s2/mutex 三个信号量, 每个产品 4 次信号量操作
+typedef struct {
+    item_t* buffer;
+    int size;
+    int in, out;
+    sem_t s1, s2, mutex;
+} sem_queue_t;
+
+// 单生产者单消费者无锁环形队列: 生产者只写 tail, 消费者只写 head, 两者放在不同缓存行.
+// 各自缓存对方的位置, 只有看起来满/空时才重新读取, 减少缓存行在两个核之间来回传递
+typedef struct {
+    _Alignas(CACHE_LINE) atomic_size_t head;   // 消费者取出位置
+    size_t cached_tail;                         // 消费者看到的 tail
+    _Alignas(CACHE_LINE) atomic_size_t tail;   // 生产者放入位置
+    size_t cached_head;                         // 生产者看到的 head
+    _Alignas(CACHE_LINE) size_t mask;          // 大小 - 1
+    item_t* buffer;
+} spsc_ring_t;
+
+// 多生产者多消费者无锁环形队列(Vyukov): 每个槽带一个序号,
+// 序号 == 位置 表示槽空可写, 序号 == 位置 + 1 表示槽满可读, 生产者/消费者用 CAS 抢占位置
+typedef struct {
+    atomic_size_t seq;
+    item_t data;
+} mpmc_cell_t;
+
+typedef struct {
+    _Alignas(CACHE_LINE) atomic_size_t enqueue_pos;
+    _Alignas(CACHE_LINE) atomic_size_t dequeue_pos;
+    _Alignas(CACHE_LINE) size_t mask;
+    mpmc_cell_t* cells;
+} mpmc_ring_t;
+
+typedef enum { QUEUE_SEM, QUEUE_SPSC, QUEUE_MPMC } queue_kind_t;
+
+static const char* const queue_names[] = {"sem", "spsc", "mpmc"};
+
+// 缓冲区满/空时的等待策略:
+// spin      只自旋(pause), 唤醒最快, 一直占用 CPU
+// yield     自旋一会儿后每次让出 CPU, 环形队列原来的做法
+// spinpark  自旋固定次数, 仍不满足就用 futex 挂起
+// block     直接挂起, 信号量缓冲区原来的做法
+// adaptive  同 spinpark, 但自旋次数按最近的等待时间调整
+typedef enum { WAIT_SPIN, WAIT_YIELD, WAIT_SPINPARK, WAIT_BLOCK, WAIT_ADAPTIVE, WAIT_DEFAULT } wait_kind_t;
+
+static const char* const wait_names[] = {"spin", "yield", "spinpark", "block", "adaptive"};
+
+// 挂起/唤醒用的事件: 等待者先读 seq 再登记, 重新检查条件后在 seq 上 futex 挂起;
+// 通知者发布数据后看到有人登记才把 seq 加 1 并唤醒, 没人等待时只多一次内存屏障和读
+typedef struct {
+    _Alignas(CACHE_LINE) atomic_uint seq;
+    atomic_int waiters;
+} event_t;
+
+// 统一的缓冲区接口, 按 kind 分派到具体实现
+typedef struct {
+    queue_kind_t kind;
+    wait_kind_t wait;
+    sem_queue_t* sem;
+    spsc_ring_t* spsc;
+    mpmc_ring_t* mpmc;
+    event_t* not_full;   // 环形队列有空位
+    event_t* not_empty;  // 环形队列有产品
+} queue_t;
+
+// 分配按缓存行对齐的内存
+void* alloc_aligned(size_t size) {
+    void* p = NULL;
+    if(posix_memalign(&p, CACHE_LINE, size) != 0) {
+        perror("posix_memalign");
+        exit(1);
+    }
+    memset(p, 0, size);
+    return p;
+}
+
+// ---------------- 等待策略 ----------------
+
+void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// 一次等待的过程
+typedef struct {
+    int spins;
+    int parked;
+    int64_t park_start;
+} wait_state_t;
+
+// adaptive 策略每个线程当前的自旋次数
+static _Thread_local int adaptive_spin = 1024;
+
+int wait_parks(wait_kind_t kind) {
+    return kind == WAIT_SPINPARK || kind == WAIT_BLOCK || kind == WAIT_ADAPTIVE;
+}
+
+void wait_begin(wait_state_t* w) {
+    w->spins = 0;
+    w->parked = 0;
+    w->park_start = 0;
+}
+
+// 一次尝试失败后调用: 按策略自旋或让出 CPU 并返回 0, 应当挂起时返回 1
+int wait_idle(wait_kind_t kind, wait_state_t* w) {
+    int limit;
+    switch(kind) {
+    case WAIT_SPIN:
+        cpu_relax();
+        return 0;
+    case WAIT_YIELD:
+        // 单核机器上也能让对方线程运行
+        if(++w->spins > SPIN_LIMIT) {
+            sched_yield();
+        }
+        return 0;
+    case WAIT_BLOCK:
+        limit = 0;
+        break;
+    case WAIT_SPINPARK:
+        limit = SPIN_PARK_LIMIT;
+        break;
+    default:
+        limit = adaptive_spin;
+        break;
+    }
+    if(w->spins < limit) {
+        w->spins++;
+        cpu_relax();
+        return 0;
+    }
+    if(!w->parked && kind == WAIT_ADAPTIVE) {
+        w->park_start = now_ns();
+    }
+    w->parked = 1;
+    return 1;
+}
+
+// 等待结束. adaptive 策略: 自旋期间等到了, 自旋次数向本次用掉次数的 2 倍靠拢;
+// 挂起后很快被唤醒, 说明自旋得不够, 加倍; 挂起了很久, 说明自旋是浪费, 减半
+void wait_end(wait_kind_t kind, wait_state_t* w) {
+    if(kind != WAIT_ADAPTIVE || (w->spins == 0 && !w->parked)) {
+        return;
+    }
+    int limit = adaptive_spin;
+    if(!w->parked) {
+        limit += (2 * w->spins - limit) / 8;
+    } else if(now_ns() - w->park_start < PARK_WORTH_NS) {
+        limit *= 2;
+    } else {
+        limit /= 2;
+    }
+    adaptive_spin = limit < ADAPTIVE_SPIN_MIN ? ADAPTIVE_SPIN_MIN : limit > ADAPTIVE_SPIN_MAX ? ADAPTIVE_SPIN_MAX : limit;
+}
+
+// 登记为等待者, 返回挂起时要比较的 seq; 之后调用者必须重新检查条件
+uint32_t event_prepare(event_t* ev) {
+    uint32_t key = atomic_load(&ev->seq);
+    atomic_fetch_add(&ev->waiters, 1);
+    return key;
+}
+
+// seq 仍等于 key 时挂起, 被唤醒或 seq 已变化时返回
+void event_park(event_t* ev, uint32_t key) {
+    syscall(SYS_futex, &ev->seq, FUTEX_WAIT_PRIVATE, key, NULL, NULL, 0);
+}
+
+void event_cancel(event_t* ev) {
+    atomic_fetch_sub(&ev->waiters, 1);
+}
+
+// 发布数据之后调用: 有等待者时推进 seq 并唤醒全部等待者
+void event_signal(wait_kind_t kind, event_t* ev) {
+    if(!wait_parks(kind)) {
+        return;
+    }
+    atomic_thread_fence(memory_order_seq_cst);
+    if(atomic_load_explicit(&ev->waiters, memory_order_relaxed) > 0) {
+        atomic_fetch_add(&ev->seq, 1);
+        syscall(SYS_futex, &ev->seq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+    }
+}
+
+// 按策略获取信号量: 自旋阶段用 sem_trywait, 挂起阶段用 sem_wait. 从第一次失败到拿到的时间记为阻塞时间
+void sem_acquire(wait_kind_t kind, sem_t* s, stat_kind_t stat) {
+    if(sem_trywait(s) == 0) {
+        return;
+    }
+    int64_t start = stats_clock();
+    wait_state_t w;
+    wait_begin(&w);
+    while(sem_trywait(s) != 0) {
+        if(wait_idle(kind, &w)) {
+            while(sem_wait(s) != 0);
+            break;
+        }
+    }
+    wait_end(kind, &w);
+    stats_blocked(stat, stats_clock() - start);
+}
+
+int spsc_try_put(spsc_ring_t* q, item_t item) {
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    if(tail - q->cached_head > q->mask) {
+        q->cached_head = atomic_load_explicit(&q->head, memory_order_acquire);
+        if(tail - q->cached_head > q->mask) {
+            return 0;  // 满
+        }
+    }
+    q->buffer[tail & q->mask] = item;
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+int spsc_try_get(spsc_ring_t* q, item_t* item) {
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    if(head == q->cached_tail) {
+        q->cached_tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+        if(head == q->cached_tail) {
+            return 0;  // 空
+        }
+    }
+    *item = q->buffer[head & q->mask];
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+    return 1;
+}
+
+int mpmc_try_put(mpmc_ring_t* q, item_t item) {
+    size_t pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+    mpmc_cell_t* cell;
+    for(;;) {
+        cell = &q->cells[pos & q->mask];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if(diff == 0) {
+            // 槽空, 抢占这个位置; 失败时 pos 被更新为最新值
+            if(atomic_compare_exchange_weak_explicit(&q->enqueue_pos, &pos, pos + 1,
+                                                     memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if(diff < 0) {
+            return 0;  // 满: 这个槽上一轮的产品还没被取走
+        } else {
+            pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+        }
+    }
+    cell->data = item;
+    atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+    return 1;
+}
+
+int mpmc_try_get(mpmc_ring_t* q, item_t* item) {
+    size_t pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+    mpmc_cell_t* cell;
+    for(;;) {
+        cell = &q->cells[pos & q->mask];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if(diff == 0) {
+            if(atomic_compare_exchange_weak_explicit(&q->dequeue_pos, &pos, pos + 1,
+                                                     memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if(diff < 0) {
+            return 0;  // 空
+        } else {
+            pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+        }
+    }
+    *item = cell->data;
+    // 序号推进一整圈, 表示下一轮生产者可以写这个槽
+    atomic_store_explicit(&cell->seq, pos + q->mask + 1, memory_order_release);
+    return 1;
+}
+
+// 创建大小为 size 的缓冲区, 环形队列的 size 必须是 2 的幂.
+// wait 为 WAIT_DEFAULT 时保持原来的做法: 信号量缓冲区直接挂起, 环形队列自旋后让出 CPU
+void queue_init(queue_t* q, queue_kind_t kind, int size, wait_kind_t wait) {
+    memset(q, 0, sizeof(*q));
+    q->kind = kind;
+    q->wait = wait != WAIT_DEFAULT ? wait : kind == QUEUE_SEM ? WAIT_BLOCK : WAIT_YIELD;
+    q->not_full = alloc_aligned(sizeof(event_t));
+    q->not_empty = alloc_aligned(sizeof(event_t));
+    switch(kind) {
+    case QUEUE_SEM:
+        q->sem = alloc_aligned(sizeof(sem_queue_t));
+        q->sem->buffer = alloc_aligned(sizeof(item_t) * size);
+        q->sem->size = size;
+        sem_init(&q->sem->s1, 0, size);
+        sem_init(&q->sem->s2, 0, 0);
+        sem_init(&q->sem->mutex, 0, 1);
+        break;
+    case QUEUE_SPSC:
+        q->spsc = alloc_aligned(sizeof(spsc_ring_t));
+        q->spsc->mask = size - 1;
+        q->spsc->buffer = alloc_aligned(sizeof(item_t) * size);
+        break;
+    case QUEUE_MPMC:
+        q->mpmc = alloc_aligned(sizeof(mpmc_ring_t));
+        q->mpmc->mask = size - 1;
+        q->mpmc->cells = alloc_aligned(sizeof(mpmc_cell_t) * size);
+        for(int i = 0; i < size; i++) {
+            atomic_init(&q->mpmc->cells[i].seq, i);
+        }
+        break;
+    }
+}
+
+void queue_destroy(queue_t* q) {
+    switch(q->kind) {
+    case QUEUE_SEM:
+        sem_destroy(&q->sem->s1);
+        sem_destroy(&q->sem->s2);
+        sem_destroy(&q->sem->mutex);
+        free(q->sem->buffer);
+        free(q->sem);
+        break;
+    case QUEUE_SPSC:
+        free(q->spsc->buffer);
+        free(q->spsc);
+        break;
+    case QUEUE_MPMC:
+        free(q->mpmc->cells);
+        free(q->mpmc);
+        break;
+    }
+    free(q->not_full);
+    free(q->not_empty);
+}
+
+// ---------------- 批量操作 ----------------
+// 一次预留多个位置、整块复制、只发布一次, 把同步开销分摊到一批产品上
+
+// 最多放入 n 个产品, 返回实际放入的个数(队列满时为 0); 只推进一次 tail
+int spsc_try_put_batch(spsc_ring_t* q, const item_t* items, int n) {
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    size_t size = q->mask + 1;
+    if(size - (tail - q->cached_head) < (size_t)n) {
+        q->cached_head = atomic_load_explicit(&q->head, memory_order_acquire);
+    }
+    size_t space = size - (tail - q->cached_head);
+    if(space < (size_t)n) n = (int)space;
+    if(n == 0) return 0;
+    // 跨过数组末尾时分两段复制
+    size_t start = tail & q->mask;
+    size_t first = size - start < (size_t)n ? size - start : (size_t)n;
+    memcpy(q->buffer + start, items, first * sizeof(item_t));
+    memcpy(q->buffer, items + first, (n - first) * sizeof(item_t));
+    atomic_store_explicit(&q->tail, tail + n, memory_order_release);
+    return n;
+}
+
+// 最多取出 n 个产品, 返回实际取出的个数(队列空时为 0); 只推进一次 head
+int spsc_try_get_batch(spsc_ring_t* q, item_t* items, int n) {
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    if(q->cached_tail - head < (size_t)n) {
+        q->cached_tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    }
+    size_t ready = q->cached_tail - head;
+    if(ready < (size_t)n) n = (int)ready;
+    if(n == 0) return 0;
+    size_t size = q->mask + 1;
+    size_t start = head & q->mask;
+    size_t first = size - start < (size_t)n ? size - start : (size_t)n;
+    memcpy(items, q->buffer + start, first * sizeof(item_t));
+    memcpy(items + first, q->buffer, (n - first) * sizeof(item_t));
+    atomic_store_explicit(&q->head, head + n, memory_order_release);
+    return n;
+}
+
+// 从 pos 开始数出连续可写的槽(最多 n 个), 用一次 CAS 全部预留, 返回预留的个数.
+// 数到的槽在本轮已经空出, CAS 成功说明没有别的生产者抢先预留其中任何一个
+int mpmc_try_put_batch(mpmc_ring_t* q, const item_t* items, int n) {
+    size_t pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+    int k;
+    for(;;) {
+        k = 0;
+        while(k < n && atomic_load_explicit(&q->cells[(pos + k) & q->mask].seq, memory_order_acquire) == pos + k) {
+            k++;
+        }
+        if(k == 0) {
+            size_t seq = atomic_load_explicit(&q->cells[pos & q->mask].seq, memory_order_acquire);
+            if((intptr_t)seq - (intptr_t)pos < 0) return 0;  // 满
+            pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+            continue;
+        }
+        if(atomic_compare_exchange_weak_explicit(&q->enqueue_pos, &pos, pos + k,
+                                                 memory_order_relaxed, memory_order_relaxed)) {
+            break;
+        }
+    }
+    for(int i = 0; i < k; i++) {
+        mpmc_cell_t* cell = &q->cells[(pos + i) & q->mask];
+        cell->data = items[i];
+        atomic_store_explicit(&cell->seq, pos + i + 1, memory_order_release);
+    }
+    return k;
+}
+
+// 从 pos 开始数出连续可读的槽(最多 n 个), 用一次 CAS 全部取走, 返回取出的个数
+int mpmc_try_get_batch(mpmc_ring_t* q, item_t* items, int n) {
+    size_t pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+    int k;
+    for(;;) {
+        k = 0;
+        while(k < n && atomic_load_explicit(&q->cells[(pos + k) & q->mask].seq, memory_order_acquire) == pos + k + 1) {
+            k++;
+        }
+        if(k == 0) {
+            size_t seq = atomic_load_explicit(&q->cells[pos & q->mask].seq, memory_order_acquire);
+            if((intptr_t)seq - (intptr_t)(pos + 1) < 0) return 0;  // 空
+            pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+            continue;
+        }
+        if(atomic_compare_exchange_weak_explicit(&q->dequeue_pos, &pos, pos + k,
+                                                 memory_order_relaxed, memory_order_relaxed)) {
+            break;
+        }
+    }
+    for(int i = 0; i < k; i++) {
+        mpmc_cell_t* cell = &q->cells[(pos + i) & q->mask];
+        items[i] = cell->data;
+        atomic_store_explicit(&cell->seq, pos + i + q->mask + 1, memory_order_release);
+    }
+    return k;
+}
+
+// 在环形队列上尝试放入/取出最多 n 个产品, 返回成功的个数
+int ring_try(queue_t* q, int put, item_t* items, int n) {
+    if(q->kind == QUEUE_SPSC) {
+        if(n == 1) return put ? spsc_try_put(q->spsc, items[0]) : spsc_try_get(q->spsc, items);
+        return put ? spsc_try_put_batch(q->spsc, items, n) : spsc_try_get_batch(q->spsc, items, n);
+    }
+    if(n == 1) return put ? mpmc_try_put(q->mpmc, items[0]) : mpmc_try_get(q->mpmc, items);
+    return put ? mpmc_try_put_batch(q->mpmc, items, n) : mpmc_try_get_batch(q->mpmc, items, n);
+}
+
+// 在环形队列上放入/取出 1~n 个产品, 按等待策略等到至少成功一个, 返回个数.
+// 挂起前先登记再重试一次, 避免在登记前刚好错过对方的通知
+int ring_transfer(queue_t* q, int put, item_t* items, int n) {
+    event_t* wait_event = put ? q->not_full : q->not_empty;
+    wait_state_t w;
+    int k = ring_try(q, put, items, n);
+    if(k > 0) {
+        event_signal(q->wait, put ? q->not_empty : q->not_full);
+        return k;
+    }
+    int64_t start = stats_clock();
+    wait_begin(&w);
+    while((k = ring_try(q, put, items, n)) == 0) {
+        if(!wait_idle(q->wait, &w)) {
+            continue;
+        }
+        uint32_t key = event_prepare(wait_event);
+        k = ring_try(q, put, items, n);
+        if(k == 0) {
+            event_park(wait_event, key);
+        }
+        event_cancel(wait_event);
+        if(k > 0) {
+            break;
+        }
+    }
+    wait_end(q->wait, &w);
+    stats_blocked(put ? STAT_FULL : STAT_EMPTY, stats_clock() - start);
+    event_signal(q->wait, put ? q->not_empty : q->not_full);
+    return k;
+}
+
+// 信号量缓冲区放入/取出 1~n 个产品. 没有"一次 P 多个"的操作:
+// 先按等待策略拿到 1 个, 再用 sem_trywait 尽量多拿, 拿到的在一次 mutex 内整块复制,
+// 不会在持有部分空位的同时阻塞, 多个生产者不会互相卡死
+int sem_transfer(queue_t* q, int put, item_t* items, int n) {
+    sem_queue_t* sq = q->sem;
+    sem_t* take = put ? &sq->s1 : &sq->s2;
+    sem_t* give = put ? &sq->s2 : &sq->s1;
+    int k;
+    sem_acquire(q->wait, take, put ? STAT_FULL : STAT_EMPTY);  // P(s1) 或 P(s2)
+    for(k = 1; k < n && sem_trywait(take) == 0; k++);   // 尽量多拿
+    timed_sem_wait(&sq->mutex, STAT_MUTEX);              // P(mutex)
+    for(int i = 0; i < k; i++) {
+        if(put) {
+            sq->buffer[sq->in] = items[i];
+            sq->in = (sq->in + 1) % sq->size;
+        } else {
+            items[i] = sq->buffer[sq->out];
+            sq->out = (sq->out + 1) % sq->size;
+        }
+    }
+    sem_post(&sq->mutex);                                // V(mutex)
+    for(int i = 0; i < k; i++) sem_post(give);           // V(s2) 或 V(s1)
+    return k;
+}
+
+// 缓冲区中的产品数, 只用于统计采样, 并发修改时是近似值
+long queue_depth(queue_t* q) {
+    int value = 0;
+    long depth = 0;
+    switch(q->kind) {
+    case QUEUE_SEM:
+        sem_getvalue(&q->sem->s2, &value);
+        depth = value;
+        break;
+    case QUEUE_SPSC:
+        depth = (long)(atomic_load_explicit(&q->spsc->tail, memory_order_relaxed) -
+                       atomic_load_explicit(&q->spsc->head, memory_order_relaxed));
+        break;
+    case QUEUE_MPMC:
+        depth = (long)(atomic_load_explicit(&q->mpmc->enqueue_pos, memory_order_relaxed) -
+                       atomic_load_explicit(&q->mpmc->dequeue_pos, memory_order_relaxed));
+        break;
+    }
+    return depth;
+}
+
+int queue_transfer(queue_t* q, int put, item_t* items, int n) {
+    int k = q->kind == QUEUE_SEM ? sem_transfer(q, put, items, n) : ring_transfer(q, put, items, n);
+    stats_items(k);
+    if(stats_sample()) {
+        stats_depth(queue_depth(q));
+    }
+    return k;
+}
+
+// 放入一个产品, 缓冲区满时等待
+void queue_put(queue_t* q, item_t item) {
+    queue_transfer(q, 1, &item, 1);
+}
+
+// 取出一个产品, 缓冲区空时等待
+item_t queue_get(queue_t* q) {
+    item_t item;
+    queue_transfer(q, 0, &item, 1);
+    return item;
+}
+
+// 放入 n 个产品, 缓冲区满时等待
+void queue_put_batch(queue_t* q, const item_t* items, int n) {
+    while(n > 0) {
+        int k = queue_transfer(q, 1, (item_t*)items, n);
+        items += k;
+        n -= k;
+    }
+}
+
+// 取出 1~max 个产品, 返回取出的个数, 缓冲区空时等待
+int queue_get_batch(queue_t* q, item_t* items, int max) {
+    return queue_transfer(q, 0, items, max);
+}
+
+// ---------------- 按消费者分发与偷取 ----------------
+// 共享缓冲区的 out(或 dequeue_pos)所在缓存行被所有消费者争抢, 核数多时成为瓶颈.
+// 分发模式下每个消费者有自己的入站 MPMC 队列和 Chase-Lev 双端队列:
+// 生产者按轮转或按 key 把产品放进某个消费者的入站队列; 消费者本地双端队列空了才从
+// 入站队列整块取出一批压入, 然后从底部逐个取出; 空闲的消费者从别人的双端队列顶部偷一个,
+// 偷不到再直接从别人的入站队列整块取走一批.
+//
+// 顺序保证:
+// 1. 每个产品恰好被消费一次.
+// 2. 不偷取时(--no-steal), 入站队列只有它的主人在取, 主人按取出顺序逐个处理,
+//    所以同一生产者发往同一消费者的产品按放入顺序被处理. 按 key 分发时,
+//    同一 key(产品值)总是发往同一消费者, 即同一生产者同一 key 的产品保持顺序;
+//    轮转分发时, 一次放入的一批整批发往同一消费者, 批内保持顺序.
+// 3. 允许偷取时没有任何顺序保证: 小偷从顶部拿走的是块内最新的产品,
+//    也可能整块拿走别人入站队列中的产品, 与主人并行处理.
+
+typedef enum { ROUTE_RR, ROUTE_KEY } route_kind_t;
+
+static const char* const route_names[] = {"rr", "key"};
+
+// 双端队列的槽: 小偷读取槽后才用 CAS 确认, 读取期间槽可能被主人改写, 所以字段是原子的,
+// 读到不一致的值时 CAS 一定失败, 这个值会被丢弃
+typedef struct {
+    atomic_llong value;
+    atomic_llong enqueue_ns;
+} deque_slot_t;
+
+// Chase-Lev 双端队列: 主人在底部压入/取出, 小偷在顶部 CAS 取出.
+// 主人只在队列空时压入一块, 所以固定 MAX_BATCH 个槽就够, 不需要扩容
+typedef struct {
+    _Alignas(CACHE_LINE) atomic_long top;
+    _Alignas(CACHE_LINE) atomic_long bottom;
+    deque_slot_t* slots;
+} deque_t;
+
+typedef struct {
+    int consumers;
+    route_kind_t route;
+    int steal;              // 是否允许偷取
+    wait_kind_t idle;       // 消费者无事可做时的等待策略
+    queue_t* inbound;       // 每个消费者一个入站队列
+    deque_t* deques;        // 每个消费者一个双端队列
+    long total;             // 产品总数
+    _Alignas(CACHE_LINE) atomic_long done;  // 已消费的产品数, 每个消费者攒够 STEAL_CHUNK 个才加一次
+} steal_pool_t;
+
+// 主人在底部压入, 调用者保证队列未满
+void deque_push(deque_t* d, item_t item) {
+    long b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    deque_slot_t* slot = &d->slots[b & (MAX_BATCH - 1)];
+    atomic_store_explicit(&slot->value, item.value, memory_order_relaxed);
+    atomic_store_explicit(&slot->enqueue_ns, item.enqueue_ns, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+}
+
+// 主人从底部取出, 只剩最后一个时与小偷 CAS 竞争, 成功返回 1
+int deque_take(deque_t* d, item_t* item) {
+    long b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&d->top, memory_order_relaxed);
+    if(t > b) {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        return 0;
+    }
+    deque_slot_t* slot = &d->slots[b & (MAX_BATCH - 1)];
+    item->value = atomic_load_explicit(&slot->value, memory_order_relaxed);
+    item->enqueue_ns = atomic_load_explicit(&slot->enqueue_ns, memory_order_relaxed);
+    if(t == b) {
+        int won = atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst,
+                                                          memory_order_relaxed);
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        return won;
+    }
+    return 1;
+}
+
+// 小偷从顶部取出一个, 成功返回 1, 队列空或竞争失败返回 0
+int deque_steal(deque_t* d, item_t* item) {
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+    if(t >= b) {
+        return 0;
+    }
+    deque_slot_t* slot = &d->slots[t & (MAX_BATCH - 1)];
+    item->value = atomic_load_explicit(&slot->value, memory_order_relaxed);
+    item->enqueue_ns = atomic_load_explicit(&slot->enqueue_ns, memory_order_relaxed);
+    return atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed);
+}
+
+// 每个入站队列大小为 size
+void steal_init(steal_pool_t* pool, int consumers, int size, wait_kind_t wait, route_kind_t route, int steal) {
+    memset(pool, 0, sizeof(*pool));
+    pool->consumers = consumers;
+    pool->route = route;
+    pool->steal = steal;
+    pool->inbound = calloc(consumers, sizeof(queue_t));
+    pool->deques = alloc_aligned(sizeof(deque_t) * consumers);
+    for(int c = 0; c < consumers; c++) {
+        queue_init(&pool->inbound[c], QUEUE_MPMC, size, wait);
+        pool->deques[c].slots = alloc_aligned(sizeof(deque_slot_t) * MAX_BATCH);
+    }
+    // 消费者的工作可能出现在任何一个队列里, 没法挂起在某一个事件上, 只自旋或让出 CPU
+    pool->idle = pool->inbound[0].wait == WAIT_SPIN ? WAIT_SPIN : WAIT_YIELD;
+}
+
+void steal_destroy(steal_pool_t* pool) {
+    for(int c = 0; c < pool->consumers; c++) {
+        queue_destroy(&pool->inbound[c]);
+        free(pool->deques[c].slots);
+    }
+    free(pool->inbound);
+    free(pool->deques);
+}
+
+// 按 key 分发时产品值就是 key, 打散后取模
+int route_key(const steal_pool_t* pool, int64_t key) {
+    return (int)((((uint64_t)key * 0x9E3779B97F4A7C15ull) >> 32) % (uint64_t)pool->consumers);
+}
+
+// 生产者放入 n 个产品. 轮转分发时整批发给 *cursor 指向的消费者(初值取生产者编号, 错开起点);
+// 按 key 分发时把这批产品按目标分组, 每组一次批量放入
+void steal_put(steal_pool_t* pool, int* cursor, const item_t* items, int n) {
+    if(pool->route == ROUTE_RR) {
+        int c = *cursor % pool->consumers;
+        *cursor = c + 1;
+        queue_put_batch(&pool->inbound[c], items, n);
+        return;
+    }
+    if(n == 1) {
+        queue_put(&pool->inbound[route_key(pool, items[0].value)], items[0]);
+        return;
+    }
+    item_t group[MAX_BATCH];
+    for(int c = 0; c < pool->consumers; c++) {
+        int k = 0;
+        for(int i = 0; i < n; i++) {
+            if(route_key(pool, items[i].value) == c) group[k++] = items[i];
+        }
+        if(k > 0) {
+            queue_put_batch(&pool->inbound[c], group, k);
+        }
+    }
+}
+
+// 从 from 号入站队列取出一批: 第一个直接返回, 其余倒序压入自己的双端队列,
+// 之后从底部取出的顺序就是入站顺序. 调用时自己的双端队列必须为空
+int steal_refill(steal_pool_t* pool, int from, deque_t* own, item_t* buffer, int chunk, item_t* item) {
+    queue_t* q = &pool->inbound[from];
+    int n = ring_try(q, 0, buffer, chunk);
+    if(n == 0) {
+        return 0;
+    }
+    event_signal(q->wait, q->not_full);
+    for(int i = n - 1; i > 0; i--) {
+        deque_push(own, buffer[i]);
+    }
+    *item = buffer[0];
+    return 1;
+}
+
+// 自己的双端队列空了以后找下一个产品: 先取自己的入站队列,
+// 再从其他消费者的双端队列偷一个, 最后整块取走其他消费者入站队列里的产品
+int steal_find(steal_pool_t* pool, int self, item_t* buffer, int chunk, item_t* item) {
+    deque_t* own = &pool->deques[self];
+    if(steal_refill(pool, self, own, buffer, chunk, item)) {
+        return 1;
+    }
+    if(!pool->steal) {
+        return 0;
+    }
+    for(int v = 1; v < pool->consumers; v++) {
+        if(deque_steal(&pool->deques[(self + v) % pool->consumers], item)) {
+            return 1;
+        }
+    }
+    for(int v = 1; v < pool->consumers; v++) {
+        if(steal_refill(pool, (self + v) % pool->consumers, own, buffer, chunk, item)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// ---------------- 变长消息的字节环形队列 ----------------
+// 单生产者单消费者. 生产者预留空间、原地写入负载、提交; 消费者原地读取、释放,
+// 整个过程不需要为每条消息 malloc 和 memcpy. 每条消息是 8 字节头部 + 负载, 按 8 字节对齐;
+// 数据区末尾放不下时写一个填充头部, 消息从数据区开头开始, 所以负载总是连续的.
+// 结构体里没有指针, 数据区紧跟在结构体后面, 整块内存可以放在共享内存里给多个进程使用.
+// 跨进程时私有 futex 不可用, 满/空时只自旋后让出 CPU
+typedef struct {
+    _Alignas(CACHE_LINE) atomic_size_t head;   // 消费者释放到的位置
+    size_t cached_tail;
+    size_t read_pos;                            // 正在读的消息的起点
+    size_t read_size;                           // 正在读的消息占用的字节数
+    _Alignas(CACHE_LINE) atomic_size_t tail;   // 生产者提交到的位置
+    size_t cached_head;
+    size_t reserve_pos;                         // 正在写的消息的起点
+    _Alignas(CACHE_LINE) size_t size;          // 数据区字节数, 2 的幂
+    size_t map_size;                            // 整个映射的字节数
+    unsigned char data[];
+} byte_ring_t;
+
+// 负载为 len 字节的消息占用的字节数
+size_t bring_record_size(size_t len) {
+    return (BRING_HDR + len + 7) & ~(size_t)7;
+}
+
+// 单条消息负载的上限. 不超过数据区的一半, 保证队列空时无论写到哪里都放得下
+size_t bring_max_payload(const byte_ring_t* r) {
+    return r->size / 2 - BRING_HDR;
+}
+
+// 预留 len 字节的负载空间, 返回写入位置, 空间不够时返回 NULL. 之后必须调用 bring_commit.
+// len 超过 bring_max_payload 时重试也放不下, 返回 BRING_TOO_LARGE, 队列状态不变, 由调用者处理这一条
+void* bring_reserve(byte_ring_t* r, size_t len) {
+    if(len > bring_max_payload(r)) {
+        return BRING_TOO_LARGE;
+    }
+    size_t need = bring_record_size(len);
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    size_t offset = tail & (r->size - 1);
+    size_t start = need <= r->size - offset ? tail : tail + (r->size - offset);
+    if(start + need - r->cached_head > r->size) {
+        r->cached_head = atomic_load_explicit(&r->head, memory_order_acquire);
+        if(start + need - r->cached_head > r->size) {
+            return NULL;
+        }
+    }
+    if(start != tail) {
+        // 填充头部和后面的消息一起提交, 消费者不会看到单独的填充
+        *(uint32_t*)(r->data + offset) = BRING_PAD;
+    }
+    r->reserve_pos = start;
+    return r->data + (start & (r->size - 1)) + BRING_HDR;
+}
+
+// 提交刚才预留的消息, len 是实际写入的字节数, 可以小于预留的大小
+void bring_commit(byte_ring_t* r, size_t len) {
+    *(uint32_t*)(r->data + (r->reserve_pos & (r->size - 1))) = (uint32_t)len;
+    atomic_store_explicit(&r->tail, r->reserve_pos + bring_record_size(len), memory_order_release);
+}
+
+// 读取下一条消息, 返回负载位置并把长度写入 len, 队列空时返回 NULL. 用完后必须调用 bring_release
+const void* bring_read(byte_ring_t* r, size_t* len) {
+    size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    for(;;) {
+        if(head == r->cached_tail) {
+            r->cached_tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+            if(head == r->cached_tail) {
+                return NULL;
+            }
+        }
+        size_t offset = head & (r->size - 1);
+        uint32_t n = *(const uint32_t*)(r->data + offset);
+        if(n != BRING_PAD) {
+            r->read_pos = head;
+            r->read_size = bring_record_size(n);
+            *len = n;
+            return r->data + offset + BRING_HDR;
+        }
+        head += r->size - offset;
+    }
+}
+
+// 释放刚才读取的消息, 它占用的空间可以被生产者重新使用
+void bring_release(byte_ring_t* r) {
+    atomic_store_explicit(&r->head, r->read_pos + r->read_size, memory_order_release);
+}
+
+// 创建数据区为 size 字节(2 的幂)的字节环形队列, 失败时返回 NULL.
+// name 为 NULL 时使用匿名共享映射, fork 出的子进程可以直接使用;
+// 否则创建名为 name 的 POSIX 共享内存, 其他进程可以用 bring_attach 打开, 用完后由创建者 shm_unlink
+byte_ring_t* bring_create(size_t size, const char* name) {
+    size_t map_size = sizeof(byte_ring_t) + size;
+    void* p;
+    if(name == NULL) {
+        p = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    } else {
+        int fd = shm_open(name, O_CREAT | O_TRUNC | O_RDWR, 0600);
+        if(fd < 0) {
+            perror("shm_open");
+            return NULL;
+        }
+        if(ftruncate(fd, map_size) != 0) {
+            perror("ftruncate");
+            close(fd);
+            shm_unlink(name);
+            return NULL;
+        }
+        p = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+    }
+    if(p == MAP_FAILED) {
+        perror("mmap");
+        return NULL;
+    }
+    // 新映射的内存全为 0, 只需填写大小
+    byte_ring_t* r = p;
+    r->size = size;
+    r->map_size = map_size;
+    return r;
+}
+
+// 打开其他进程用 bring_create 创建的共享字节环形队列, 失败时返回 NULL.
+// 结构体里的大小来自共享内存, 要和对象的实际长度核对, 否则别的或截断的对象会让读写越界
+byte_ring_t* bring_attach(const char* name) {
+    int fd = shm_open(name, O_RDWR, 0);
+    if(fd < 0) {
+        perror("shm_open");
+        return NULL;
+    }
+    struct stat st;
+    void* p = MAP_FAILED;
+    if(fstat(fd, &st) == 0 && (size_t)st.st_size > sizeof(byte_ring_t)) {
+        p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if(p == MAP_FAILED) {
+        fprintf(stderr, "%s 不是有效的字节环形队列\n", name);
+        return NULL;
+    }
+    byte_ring_t* r = p;
+    size_t size = r->size;
+    if(size < 4 * BRING_HDR || (size & (size - 1)) != 0 || size > (size_t)st.st_size - sizeof(byte_ring_t) ||
+       r->map_size != (size_t)st.st_size) {
+        fprintf(stderr, "%s 不是有效的字节环形队列\n", name);
+        munmap(p, st.st_size);
+        return NULL;
+    }
+    return r;
+}
+
+void bring_detach(byte_ring_t* r) {
+    munmap(r, r->map_size);
+}
+
+// ---------------- 吞吐量与延迟测试 ----------------
+
+// 延迟直方图: 每个 2 的幂区间再均分为 2^HIST_SUB_BITS 份, 各桶的相对宽度不超过 1/16,
+// 固定大小, 每个消费者一份, 结束后相加
+#define HIST_SUB_BITS 4
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS (64 * HIST_SUB)
+
+typedef struct {
+    long long count[HIST_BUCKETS];
+    long long total;
+    int64_t max;
+} histogram_t;
+
+int hist_bucket(uint64_t v) {
+    if(v < HIST_SUB) return (int)v;
+    int shift = 63 - __builtin_clzll(v) - HIST_SUB_BITS;
+    return (shift + 1) * HIST_SUB + (int)((v >> shift) & (HIST_SUB - 1));
+}
+
+// 桶中的最大值, 报告百分位数时取它, 偏保守
+uint64_t hist_bucket_high(int b) {
+    if(b < HIST_SUB) return b;
+    int shift = b / HIST_SUB - 1;
+    uint64_t low = (uint64_t)(HIST_SUB + b % HIST_SUB) << shift;
+    return low + ((uint64_t)1 << shift) - 1;
+}
+
+void hist_add(histogram_t* h, int64_t v) {
+    if(v < 0) v = 0;
+    h->count[hist_bucket(v)]++;
+    h->total++;
+    if(v > h->max) h->max = v;
+}
+
+void hist_merge(histogram_t* h, const histogram_t* other) {
+    for(int i = 0; i < HIST_BUCKETS; i++) {
+        h->count[i] += other->count[i];
+    }
+    h->total += other->total;
+    if(other->max > h->max) h->max = other->max;
+}
+
+// 第 q 分位数(0 < q <= 1)所在桶的上界, 不超过实际最大值
+int64_t hist_percentile(const histogram_t* h, double q) {
+    long long rank = (long long)(q * h->total + 0.999999);
+    if(rank < 1) rank = 1;
+    long long seen = 0;
+    for(int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->count[i];
+        if(seen >= rank) {
+            int64_t high = hist_bucket_high(i);
+            return high < h->max ? high : h->max;
+        }
+    }
+    return h->max;
+}
+
+// 按 2 的幂区间打印直方图
+void hist_print(const histogram_t* h) {
+    for(int k = 0; k < 64; k++) {
+        long long n = 0;
+        for(int i = 0; i < HIST_BUCKETS; i++) {
+            uint64_t high = hist_bucket_high(i);
+            int msb = high == 0 ? 0 : 63 - __builtin_clzll(high);
+            if(msb == k) n += h->count[i];
+        }
+        if(n == 0) continue;
+        int bar = (int)(n * 50 / h->total);
+        printf("  [%12llu, %12llu) ns %10lld ", k == 0 ? 0ULL : 1ULL << k, 1ULL << (k + 1), n);
+        for(int i = 0; i < bar; i++) putchar('#');
+        putchar('\n');
+    }
+}
+
+// 测试配置, 全部可以在命令行指定
+typedef struct {
+    queue_kind_t kind;
+    int size;           // 缓冲区大小
+    int producers;
+    int consumers;
+    long items;         // 每个生产者的产品数
+    int batch;          // 每次放入/取出的个数, 1 表示逐个操作
+    int sweep;          // 依次测试批量 1, 2, 4, ..., MAX_BATCH
+    int pin;            // 把线程绑定到 CPU 上
+    wait_kind_t wait;   // 等待策略
+    int distribute;     // 按消费者分发(steal), 缓冲区大小指每个入站队列
+    route_kind_t route; // 分发方式
+    int steal;          // 分发模式下是否允许偷取
+    int scale;          // 扩展性测试: 线程数从 1 加倍到核数, 比较共享缓冲区与分发模式
+    stats_reporter_t* stats;  // 运行统计的输出方式
+} bench_config_t;
+
+// 本进程所有线程用掉的 CPU 时间(用户态 + 内核态)
+double cpu_seconds() {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+typedef struct {
+    int id;
+    long count;         // 生产/消费的产品数
+    int batch;
+    int producers;      // 生产者总数, 第 i 个产品的值为 i * producers + id, 各生产者互不重复
+    queue_t* queue;
+    steal_pool_t* pool; // 分发模式下代替 queue
+    long long sum;      // 产品之和, 用于检查没有丢失或重复
+    histogram_t* latency;  // 消费者记录的放入到取出的延迟
+} bench_arg_t;
+
+void* bench_producer(void* arg) {
+    bench_arg_t* a = arg;
+    long long sum = 0;
+    int cursor = a->id;
+    stats_register("producer", a->id);
+    item_t items[MAX_BATCH];
+    for(long i = 0; i < a->count; ) {
+        int n = a->count - i < a->batch ? (int)(a->count - i) : a->batch;
+        int64_t stamp = now_ns();  // 同一批共用一个时间戳
+        for(int j = 0; j < n; j++, i++) {
+            items[j].value = i * a->producers + a->id;
+            items[j].enqueue_ns = stamp;
+            sum += items[j].value;
+        }
+        if(a->pool != NULL) {
+            steal_put(a->pool, &cursor, items, n);
+        } else if(n == 1) {
+            queue_put(a->queue, items[0]);
+        } else {
+            queue_put_batch(a->queue, items, n);
+        }
+    }
+    a->sum = sum;
+    return NULL;
+}
+
+void* bench_consumer(void* arg) {
+    bench_arg_t* a = arg;
+    long long sum = 0;
+    item_t items[MAX_BATCH];
+    stats_register("consumer", a->id);
+    for(long i = 0; i < a->count; ) {
+        int n;
+        if(a->batch == 1) {
+            items[0] = queue_get(a->queue);
+            n = 1;
+        } else {
+            int max = a->count - i < a->batch ? (int)(a->count - i) : a->batch;
+            n = queue_get_batch(a->queue, items, max);
+        }
+        int64_t stamp = now_ns();
+        for(int j = 0; j < n; j++) {
+            sum += items[j].value;
+            hist_add(a->latency, stamp - items[j].enqueue_ns);
+        }
+        i += n;
+    }
+    a->sum = sum;
+    return NULL;
+}
+
+// 分发模式的消费者: 事先不知道自己会处理多少个, 所有消费者合计处理完 total 个后结束
+void* steal_consumer(void* arg) {
+    bench_arg_t* a = arg;
+    steal_pool_t* pool = a->pool;
+    deque_t* own = &pool->deques[a->id];
+    stats_register("consumer", a->id);
+    int chunk = a->batch > STEAL_CHUNK ? a->batch : STEAL_CHUNK;
+    long long sum = 0;
+    long pending = 0;
+    item_t items[MAX_BATCH];
+    wait_state_t w;
+    wait_begin(&w);
+    for(;;) {
+        item_t item;
+        if(deque_take(own, &item) || steal_find(pool, a->id, items, chunk, &item)) {
+            sum += item.value;
+            hist_add(a->latency, now_ns() - item.enqueue_ns);
+            if(++pending == STEAL_CHUNK) {
+                atomic_fetch_add(&pool->done, pending);
+                stats_items(pending);
+                pending = 0;
+            }
+            w.spins = 0;
+            continue;
+        }
+        if(pending > 0) {
+            atomic_fetch_add(&pool->done, pending);
+            stats_items(pending);
+            pending = 0;
+        }
+        if(atomic_load(&pool->done) == pool->total) {
+            break;
+        }
+        wait_idle(pool->idle, &w);
+    }
+    a->sum = sum;
+    return NULL;
+}
+
+// 用指定的缓冲区跑一遍生产者-消费者, 返回每秒传递的产品数, 校验失败时返回负数,
+// 延迟累加到 latency, 用掉的 CPU 时间写入 cpu. 产品总数平均分给消费者,
+// 除不尽的部分由前几个消费者多取一个. 绑核时第 i 个线程绑到 CPU i % 核数
+double run_bench(const bench_config_t* cfg, int batch, histogram_t* latency, double* cpu) {
+    int threads = cfg->producers + cfg->consumers;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    long total = cfg->items * cfg->producers;
+    queue_t queue;
+    steal_pool_t pool;
+    if(cfg->distribute) {
+        steal_init(&pool, cfg->consumers, cfg->size, cfg->wait, cfg->route, cfg->steal);
+        pool.total = total;
+    } else {
+        queue_init(&queue, cfg->kind, cfg->size, cfg->wait);
+    }
+    pthread_t* tids = malloc(sizeof(pthread_t) * threads);
+    bench_arg_t* args = calloc(threads, sizeof(bench_arg_t));
+    histogram_t* hists = calloc(cfg->consumers, sizeof(histogram_t));
+
+    stats_start(cfg->stats);
+    int64_t start = now_ns();
+    double cpu_start = cpu_seconds();
+    for(int i = 0; i < threads; i++) {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        if(cfg->pin) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(i % (cpus > 0 ? cpus : 1), &set);
+            pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+        }
+        args[i].queue = &queue;
+        args[i].pool = cfg->distribute ? &pool : NULL;
+        args[i].batch = batch;
+        args[i].producers = cfg->producers;
+        if(i < cfg->producers) {
+            args[i].id = i;
+            args[i].count = cfg->items;
+            pthread_create(&tids[i], &attr, bench_producer, &args[i]);
+        } else {
+            int c = i - cfg->producers;
+            args[i].id = c;
+            args[i].count = total / cfg->consumers + (c < total % cfg->consumers);
+            args[i].latency = &hists[c];
+            pthread_create(&tids[i], &attr, cfg->distribute ? steal_consumer : bench_consumer, &args[i]);
+        }
+        pthread_attr_destroy(&attr);
+    }
+    long long produced = 0, consumed = 0;
+    for(int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+        if(i < cfg->producers) {
+            produced += args[i].sum;
+        } else {
+            consumed += args[i].sum;
+            hist_merge(latency, args[i].latency);
+        }
+    }
+    double seconds = (now_ns() - start) / 1e9;
+    *cpu = cpu_seconds() - cpu_start;
+    stats_stop(cfg->stats);
+
+    free(hists);
+    free(tids);
+    free(args);
+    if(cfg->distribute) {
+        steal_destroy(&pool);
+    } else {
+        queue_destroy(&queue);
+    }
+    return produced == consumed ? total / seconds : -1;
+}
+
+void bench_usage(const char* name) {
+    printf("用法: %s bench <sem|spsc|mpmc|steal> [-k 缓冲区大小] [-p 生产者数] [-c 消费者数]\n"
+           "       [-n 每个生产者的产品数] [-b 批量大小|sweep] [-w spin|yield|spinpark|block|adaptive] [--pin]\n"
+           "       [-d rr|key] [--no-steal] [--scale] [--stats text|json] [--stats-interval 毫秒]\n"
+           "steal 为按消费者分发模式, -k 指每个消费者入站队列的大小;\n"
+           "--scale 时生产者和消费者各 1, 2, 4, ... 个直到核数(或 -c), 比较 sem、mpmc 与 steal\n"
+           "       %s bench bytes [-k 环形队列字节数] [-n 消息数] [-l 最小长度-最大长度] [--fork [--shm 名字]]\n",
+           name, name);
+}
+
+// ---------------- 变长消息测试 ----------------
+
+typedef struct {
+    byte_ring_t* ring;
+    queue_t* queue;             // 对照组: 每条消息 malloc + memcpy, 指针经 spsc 队列传递
+    long count;                 // 消息数
+    size_t min_len, max_len;    // 负载长度范围
+    unsigned long long sum;     // 负载字节之和, 用于检查
+} bytes_arg_t;
+
+// 第 i 条消息的长度, 生产者和消费者各自算出同一个序列
+size_t bytes_length(const bytes_arg_t* a, uint64_t* seed) {
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 7;
+    *seed ^= *seed << 17;
+    return a->min_len + *seed % (a->max_len - a->min_len + 1);
+}
+
+unsigned long long bytes_sum(const unsigned char* p, size_t len) {
+    unsigned long long sum = 0;
+    for(size_t i = 0; i < len; i++) {
+        sum += p[i];
+    }
+    return sum;
+}
+
+void* bytes_producer(void* arg) {
+    bytes_arg_t* a = arg;
+    uint64_t seed = 88172645463325252ull;
+    unsigned long long sum = 0;
+    unsigned char* local = a->ring == NULL ? malloc(a->max_len + 1) : NULL;
+    for(long i = 0; i < a->count; i++) {
+        size_t len = bytes_length(a, &seed);
+        int fill = (int)(i & 0xff);
+        wait_state_t w;
+        wait_begin(&w);
+        if(a->ring != NULL) {
+            void* p;
+            size_t sent = len;
+            while((p = bring_reserve(a->ring, sent)) == NULL || p == BRING_TOO_LARGE) {
+                if(p == BRING_TOO_LARGE) {
+                    // 参数检查过长度, 不应发生. 改发空消息保持条数, sum 仍按 len 计, 校验会报告失败
+                    fprintf(stderr, "消息 %ld: 负载 %zu 字节超过上限 %zu 字节\n", i, len, bring_max_payload(a->ring));
+                    sent = 0;
+                    continue;
+                }
+                wait_idle(WAIT_YIELD, &w);
+            }
+            memset(p, fill, sent);
+            bring_commit(a->ring, sent);
+        } else {
+            // 对照组: 消息先在别处生成, 再复制到新分配的内存里交给消费者
+            memset(local, fill, len);
+            unsigned char* copy = malloc(len + 1);
+            memcpy(copy, local, len);
+            item_t item = {(int64_t)(intptr_t)copy, (int64_t)len};
+            queue_put(a->queue, item);
+        }
+        sum += (unsigned long long)len * fill;
+    }
+    free(local);
+    a->sum = sum;
+    return NULL;
+}
+
+void* bytes_consumer(void* arg) {
+    bytes_arg_t* a = arg;
+    unsigned long long sum = 0;
+    for(long i = 0; i < a->count; i++) {
+        if(a->ring != NULL) {
+            const void* p;
+            size_t len;
+            wait_state_t w;
+            wait_begin(&w);
+            while((p = bring_read(a->ring, &len)) == NULL) {
+                wait_idle(WAIT_YIELD, &w);
+            }
+            sum += bytes_sum(p, len);
+            bring_release(a->ring);
+        } else {
+            item_t item = queue_get(a->queue);
+            unsigned char* p = (unsigned char*)(intptr_t)item.value;
+            sum += bytes_sum(p, (size_t)item.enqueue_ns);
+            free(p);
+        }
+    }
+    a->sum = sum;
+    return NULL;
+}
+
+// 用两个线程(或 fork 出的消费者进程)传递 count 条变长消息, 返回每秒消息数, 校验失败返回负数
+double run_bytes(bytes_arg_t* tmpl, int use_ring, size_t ring_size, int use_fork, const char* shm_name) {
+    bytes_arg_t prod = *tmpl, cons = *tmpl;
+    queue_t queue;
+    byte_ring_t* ring = NULL;
+    if(use_ring) {
+        ring = bring_create(ring_size, shm_name);
+        if(ring == NULL) {
+            return -1;
+        }
+    } else {
+        queue_init(&queue, QUEUE_SPSC, BENCH_K, WAIT_DEFAULT);
+    }
+    prod.ring = cons.ring = ring;
+    prod.queue = cons.queue = &queue;
+
+    int64_t start = now_ns();
+    if(use_fork) {
+        int fds[2];
+        if(pipe(fds) != 0) {
+            perror("pipe");
+            return -1;
+        }
+        fflush(stdout);  // 避免子进程重复输出缓冲区里的内容
+        pid_t pid = fork();
+        if(pid == 0) {
+            // 消费者进程: 给了名字就像无关进程一样按名字重新打开
+            close(fds[0]);
+            if(shm_name != NULL) {
+                cons.ring = bring_attach(shm_name);
+                if(cons.ring == NULL) {
+                    _exit(1);
+                }
+            }
+            bytes_consumer(&cons);
+            ssize_t written = write(fds[1], &cons.sum, sizeof(cons.sum));
+            _exit(written == sizeof(cons.sum) ? 0 : 1);
+        }
+        close(fds[1]);
+        if(pid < 0) {
+            perror("fork");
+            close(fds[0]);
+            return -1;
+        }
+        bytes_producer(&prod);
+        int status;
+        waitpid(pid, &status, 0);
+        if(read(fds[0], &cons.sum, sizeof(cons.sum)) != sizeof(cons.sum)) {
+            cons.sum = ~prod.sum;
+        }
+        close(fds[0]);
+    } else {
+        pthread_t tids[2];
+        pthread_create(&tids[0], NULL, bytes_producer, &prod);
+        pthread_create(&tids[1], NULL, bytes_consumer, &cons);
+        pthread_join(tids[0], NULL);
+        pthread_join(tids[1], NULL);
+    }
+    double seconds = (now_ns() - start) / 1e9;
+
+    if(use_ring) {
+        bring_detach(ring);
+        if(shm_name != NULL) {
+            shm_unlink(shm_name);
+        }
+    } else {
+        queue_destroy(&queue);
+    }
+    return prod.sum == cons.sum ? tmpl->count / seconds : -1;
+}
+
+// 变长消息测试: 字节环形队列与"malloc + memcpy + 传指针"对比, 可选消费者放在 fork 出的进程里
+int bytes_main(int argc, char* argv[]) {
+    size_t ring_size = BRING_BYTES;
+    bytes_arg_t tmpl = {NULL, NULL, BENCH_ITEMS, 16, 1500, 0};
+    int use_fork = 0;
+    const char* shm_name = NULL;
+    for(int i = 3; i < argc; i++) {
+        const char* opt = argv[i];
+        const char* val = i + 1 < argc ? argv[i + 1] : NULL;
+        if(strcmp(opt, "--fork") == 0) {
+            use_fork = 1;
+            continue;
+        }
+        if(val == NULL) {
+            bench_usage(argv[0]);
+            return 1;
+        }
+        i++;
+        if(strcmp(opt, "-k") == 0) {
+            ring_size = strtoul(val, NULL, 10);
+        } else if(strcmp(opt, "-n") == 0) {
+            tmpl.count = atol(val);
+        } else if(strcmp(opt, "-l") == 0) {
+            char* end;
+            tmpl.min_len = strtoul(val, &end, 10);
+            tmpl.max_len = *end == '-' ? strtoul(end + 1, NULL, 10) : tmpl.min_len;
+        } else if(strcmp(opt, "--shm") == 0) {
+            shm_name = val;
+        } else {
+            bench_usage(argv[0]);
+            return 1;
+        }
+    }
+    if(ring_size < 64 || (ring_size & (ring_size - 1)) != 0) {
+        printf("字节环形队列的容量必须是不小于 64 的 2 的幂\n");
+        return 1;
+    }
+    if(tmpl.count <= 0 || tmpl.min_len > tmpl.max_len || tmpl.max_len > ring_size / 2 - BRING_HDR) {
+        printf("消息数必须为正数, 消息长度范围应在 0 到 %zu 之间\n", ring_size / 2 - BRING_HDR);
+        return 1;
+    }
+    if(shm_name != NULL && !use_fork) {
+        printf("--shm 需要和 --fork 一起使用\n");
+        return 1;
+    }
+
+    printf("变长消息: %ld 条, 负载 %zu-%zu 字节, 环形队列 %zu 字节%s\n", tmpl.count, tmpl.min_len, tmpl.max_len,
+           ring_size, use_fork ? (shm_name != NULL ? ", 消费者进程按名字打开共享内存" : ", 消费者在子进程中") : "");
+    for(int use_ring = 1; use_ring >= (use_fork ? 1 : 0); use_ring--) {
+        double rate = run_bytes(&tmpl, use_ring, ring_size, use_fork, shm_name);
+        const char* label = use_ring ? "字节环形队列" : "malloc+memcpy";
+        if(rate < 0) {
+            printf("%s: 校验和不一致!\n", label);
+            return 1;
+        }
+        printf("%12.0f 条/秒, %8.1f MB/秒  %s\n", rate, rate * (tmpl.min_len + tmpl.max_len) / 2 / 1e6, label);
+    }
+    return 0;
+}
+
+// 扩展性测试: 生产者和消费者各 t 个, t 从 1 加倍到 max_threads(最后一档取 max_threads),
+// 依次测试共享的信号量缓冲区、共享的 MPMC 环形队列和分发模式, 每个生产者的产品数不变
+int bench_scale(const bench_config_t* base, int max_threads) {
+    static const char* const labels[] = {"sem", "mpmc", "steal"};
+    histogram_t* latency = malloc(sizeof(histogram_t));
+    printf("线程数");
+    for(int m = 0; m < 3; m++) {
+        printf("  %28s", labels[m]);
+    }
+    printf("\n");
+    for(int t = 1; t <= max_threads; t = t < max_threads && t * 2 > max_threads ? max_threads : t * 2) {
+        printf("%6d", t);
+        for(int m = 0; m < 3; m++) {
+            bench_config_t cfg = *base;
+            cfg.producers = cfg.consumers = t;
+            cfg.kind = m == 0 ? QUEUE_SEM : QUEUE_MPMC;
+            cfg.distribute = m == 2;
+            memset(latency, 0, sizeof(histogram_t));
+            double cpu;
+            double rate = run_bench(&cfg, cfg.batch, latency, &cpu);
+            if(rate < 0) {
+                printf("\n%s %d 线程: 校验和不一致!\n", labels[m], t);
+                free(latency);
+                return 1;
+            }
+            printf("  %12.0f 个/秒 p99 %8lld", rate, (long long)hist_percentile(latency, 0.99));
+        }
+        printf("\n");
+    }
+    free(latency);
+    return 0;
+}
+
+// 吞吐量与延迟测试: 解析命令行, 跑一次(或按批量大小扫描), 输出每秒产品数和延迟百分位数
+int bench_main(int argc, char* argv[]) {
+    stats_reporter_t reporter = {.interval_ms = STATS_INTERVAL_MS};
+    bench_config_t cfg = {QUEUE_SEM, BENCH_K, PRODUCER_NUM, CONSUMER_NUM, BENCH_ITEMS, 1, 0, 0, WAIT_DEFAULT,
+                          0, ROUTE_RR, 1, 0, &reporter};
+    int found = 0, threads_given = 0;
+    for(int i = 0; i < 3; i++) {
+        if(argc > 2 && strcmp(argv[2], queue_names[i]) == 0) {
+            cfg.kind = (queue_kind_t)i;
+            found = 1;
+        }
+    }
+    if(argc > 2 && strcmp(argv[2], "steal") == 0) {
+        cfg.kind = QUEUE_MPMC;  // 入站队列是 MPMC 环形队列
+        cfg.distribute = 1;
+        found = 1;
+    }
+    if(!found) {
+        bench_usage(argv[0]);
+        return 1;
+    }
+    for(int i = 3; i < argc; i++) {
+        const char* opt = argv[i];
+        const char* val = i + 1 < argc ? argv[i + 1] : NULL;
+        if(strcmp(opt, "--pin") == 0) {
+            cfg.pin = 1;
+            continue;
+        }
+        if(strcmp(opt, "--no-steal") == 0) {
+            cfg.steal = 0;
+            continue;
+        }
+        if(strcmp(opt, "--scale") == 0) {
+            cfg.scale = 1;
+            continue;
+        }
+        int used = stats_parse_option(&reporter, opt, val);
+        if(used != 0) {
+            if(used < 0) {
+                bench_usage(argv[0]);
+                return 1;
+            }
+            i++;
+            continue;
+        }
+        if(val == NULL) {
+            bench_usage(argv[0]);
+            return 1;
+        }
+        i++;
+        if(strcmp(opt, "-k") == 0) {
+            cfg.size = atoi(val);
+        } else if(strcmp(opt, "-p") == 0) {
+            cfg.producers = atoi(val);
+            threads_given = 1;
+        } else if(strcmp(opt, "-c") == 0) {
+            cfg.consumers = atoi(val);
+            threads_given = 1;
+        } else if(strcmp(opt, "-n") == 0) {
+            cfg.items = atol(val);
+        } else if(strcmp(opt, "-w") == 0) {
+            cfg.wait = WAIT_DEFAULT;
+            for(int w = 0; w < WAIT_DEFAULT; w++) {
+                if(strcmp(val, wait_names[w]) == 0) cfg.wait = (wait_kind_t)w;
+            }
+            if(cfg.wait == WAIT_DEFAULT) {
+                bench_usage(argv[0]);
+                return 1;
+            }
+        } else if(strcmp(opt, "-d") == 0) {
+            if(strcmp(val, route_names[ROUTE_RR]) == 0) {
+                cfg.route = ROUTE_RR;
+            } else if(strcmp(val, route_names[ROUTE_KEY]) == 0) {
+                cfg.route = ROUTE_KEY;
+            } else {
+                bench_usage(argv[0]);
+                return 1;
+            }
+        } else if(strcmp(opt, "-b") == 0) {
+            cfg.sweep = strcmp(val, "sweep") == 0;
+            cfg.batch = cfg.sweep ? 1 : atoi(val);
+        } else {
+            bench_usage(argv[0]);
+            return 1;
+        }
+    }
+    if(cfg.kind == QUEUE_SPSC && !threads_given) {
+        cfg.producers = cfg.consumers = 1;
+    }
+    if(cfg.items <= 0 || cfg.producers <= 0 || cfg.consumers <= 0 || cfg.size <= 0) {
+        printf("缓冲区大小、产品数和线程数必须为正数\n");
+        return 1;
+    }
+    if(cfg.kind != QUEUE_SEM && (cfg.size & (cfg.size - 1)) != 0) {
+        printf("环形队列的大小必须是 2 的幂\n");
+        return 1;
+    }
+    if(cfg.batch < 1 || cfg.batch > MAX_BATCH) {
+        printf("批量大小应在 1 到 %d 之间\n", MAX_BATCH);
+        return 1;
+    }
+    if(cfg.kind == QUEUE_SPSC && (cfg.producers != 1 || cfg.consumers != 1)) {
+        printf("spsc 只支持 1 个生产者和 1 个消费者\n");
+        return 1;
+    }
+    if(cfg.scale) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        return bench_scale(&cfg, threads_given ? cfg.consumers : cpus > 0 ? (int)cpus : 1);
+    }
+
+    wait_kind_t wait = cfg.wait != WAIT_DEFAULT ? cfg.wait : cfg.kind == QUEUE_SEM ? WAIT_BLOCK : WAIT_YIELD;
+    printf("%s: 缓冲区 %d, 生产者 %d, 消费者 %d, 产品 %ld, 等待策略 %s%s\n",
+           cfg.distribute ? "steal" : queue_names[cfg.kind], cfg.size, cfg.producers, cfg.consumers,
+           cfg.items * cfg.producers, wait_names[wait], cfg.pin ? ", 绑核" : "");
+    if(cfg.distribute) {
+        printf("分发方式 %s, %s\n", route_names[cfg.route], cfg.steal ? "允许偷取" : "不偷取");
+    }
+    histogram_t* latency = malloc(sizeof(histogram_t));
+    for(int b = cfg.batch; b <= (cfg.sweep ? MAX_BATCH : cfg.batch); b *= 2) {
+        memset(latency, 0, sizeof(histogram_t));
+        double cpu;
+        double rate = run_bench(&cfg, b, latency, &cpu);
+        if(rate < 0) {
+            printf("批量 %4d: 校验和不一致!\n", b);
+            free(latency);
+            return 1;
+        }
+        printf("批量 %4d: %12.0f 个/秒, CPU %.3f 秒, 延迟(纳秒) p50 %lld, p99 %lld, p999 %lld, 最大 %lld\n", b, rate,
+               cpu, (long long)hist_percentile(latency, 0.5), (long long)hist_percentile(latency, 0.99),
+               (long long)hist_percentile(latency, 0.999), (long long)latency->max);
+    }
+    if(!cfg.sweep) {
+        hist_print(latency);
+    }
+    free(latency);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
     pthread_t pid[PRODUCER_NUM], cid[CONSUMER_NUM];
     int i, producer_id[PRODUCER_NUM], consumer_id[CONSUMER_NUM];
+
+    if(argc > 1 && strcmp(argv[1], "bench") == 0) {
+        if(argc > 2 && strcmp(argv[2], "bytes") == 0) {
+            return bytes_main(argc, argv);
+        }
+        return bench_main(argc, argv);
+    }
+    stats_reporter_t reporter = {.interval_ms = STATS_INTERVAL_MS};
+    for(i = 1; i < argc; i += 2) {
+        if(stats_parse_option(&reporter, argv[i], i + 1 < argc ? argv[i + 1] : NULL) != 1) {
+            printf("用法: %s [--stats text|json] [--stats-interval 毫秒]\n", argv[0]);
+            bench_usage(argv[0]);
+            return 1;
+        }
+    }
     
     // 初始化信号量
     sem_init(&s1, 0, K);      // 初始值为K
     sem_init(&s2, 0, 0);      // 初始值为0
     sem_init(&mutex, 0, 1);   // 初始值为1
+    stats_start(&reporter);
     
     // 创建生产者线程
     for(i = 0; i < PRODUCER_NUM; i++) {
@@ -91,6 +1989,7 @@ int main() {
     for(i = 0; i < CONSUMER_NUM; i++) {
         pthread_join(cid[i], NULL);
     }
+    stats_stop(&reporter);
     
     // 销毁信号量
     sem_destroy(&s1);
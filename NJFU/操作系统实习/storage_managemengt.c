@@ -2,10 +2,17 @@
 #include <stdlib.h>
 #include <time.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define PAGE_SIZE 10 // 每页包含10条指令
 #define OUTER_MEMORY_SIZE 400 // 外存大小为400条指令
 #define MAX_MEMORY 40 // 内存最多可以容纳40页
+#define PAGE_COUNT (OUTER_MEMORY_SIZE / PAGE_SIZE) // 外存共有的页数
 
 // 页面结构体,包含页号、访问次数和使用位等信息
 struct p_str {
@@ -15,9 +22,20 @@ struct p_str {
     struct p_str *next;
 };
 
-// LRU算法的结构体
+// LRU链表的节点, 前后指针用节点池中的下标表示, -1 表示没有
+struct LRU_node {
+    int pagenum;
+    int prev;
+    int next;
+};
+
+// LRU算法的结构体: 页号直接映射到节点, 节点按使用先后串成双向链表,
+// 节点从按页框数分配的节点池中取, 每次访问都是 O(1), 不再分配内存
 struct LRU {
-    struct p_str *head;
+    struct LRU_node *nodes;  // 节点池, 共 max_pages 个
+    int index[PAGE_COUNT];  // 页号对应的节点下标, -1 表示不在内存中
+    int head;  // 最近使用的页面
+    int tail;  // 最久未使用的页面
     int size;
     int max_pages;  // 最大页面数限制
 };
@@ -45,95 +63,114 @@ int generateRandomInstruction() {
     return rand() % OUTER_MEMORY_SIZE;
 }
 
+// 生成一串随机的页面访问, 各种算法和内存大小都在同一串访问上比较
+void generateReferences(int pages[]) {
+    int i;
+    for (i = 0; i < OUTER_MEMORY_SIZE; i++) {
+        pages[i] = instructions[generateRandomInstruction()];
+    }
+}
+
 // 打印命中率
 void printHitRate(int hits, int total) {
     printf("命中率: %.2f%%\n", (float)hits * 100 / total);
 }
 
-// 初始化LRU结构体
-void LRU_init(struct LRU *lru) {
-    lru->head = NULL;
+// 初始化LRU结构体, 节点池按 max_pages 个页框分配
+void LRU_init(struct LRU *lru, int max_pages) {
+    lru->nodes = malloc(sizeof(struct LRU_node) * max_pages);
+    if (lru->nodes == NULL) {
+        fprintf(stderr, "LRU 节点池分配失败: %d 个页框\n", max_pages);
+        exit(1);
+    }
+    lru->head = -1;
+    lru->tail = -1;
     lru->size = 0;
+    lru->max_pages = max_pages;
+    int i;
+    for (i = 0; i < PAGE_COUNT; i++) {
+        lru->index[i] = -1;
+    }
+}
+
+void LRU_free(struct LRU *lru) {
+    free(lru->nodes);
 }
 
-// 向LRU中添加新页面
+// 把节点从链表中摘下
+void LRU_unlink(struct LRU *lru, int node) {
+    struct LRU_node *n = &lru->nodes[node];
+    if (n->prev != -1) {
+        lru->nodes[n->prev].next = n->next;
+    } else {
+        lru->head = n->next;
+    }
+    if (n->next != -1) {
+        lru->nodes[n->next].prev = n->prev;
+    } else {
+        lru->tail = n->prev;
+    }
+}
+
+// 把节点放到链表头部(表示最近使用)
+void LRU_pushFront(struct LRU *lru, int node) {
+    lru->nodes[node].prev = -1;
+    lru->nodes[node].next = lru->head;
+    if (lru->head != -1) {
+        lru->nodes[lru->head].prev = node;
+    } else {
+        lru->tail = node;
+    }
+    lru->head = node;
+}
+
+// 向LRU中添加新页面, 内存已满时重用最久未使用页面的节点
 void LRU_addPage(struct LRU *lru, int page) {
-    struct p_str *new_page = (struct p_str*)malloc(sizeof(struct p_str));
-    new_page->pagenum = page;
-    new_page->count = 0;
-    new_page->next = lru->head;
-    lru->head = new_page;
-    lru->size++;
+    int node;
+    if (lru->size < lru->max_pages) {
+        node = lru->size++;
+    } else {
+        node = lru->tail;
+        LRU_unlink(lru, node);
+        lru->index[lru->nodes[node].pagenum] = -1;
+    }
+    lru->nodes[node].pagenum = page;
+    lru->index[page] = node;
+    LRU_pushFront(lru, node);
 }
 
 // 检查页面是否在LRU中
 bool LRU_isPageInMemory(struct LRU *lru, int page) {
-    struct p_str *current = lru->head;
-    while (current != NULL) {
-        if (current->pagenum == page) {
-            return true;
-        }
-        current = current->next;
-    }
-    return false;
+    return lru->index[page] != -1;
 }
 
 // LRU算法的替换
 void LRU_reference(struct LRU *lru, int page) {
-    struct p_str *current = lru->head, *prev = NULL;
-    // 查找页面是否存在于链表中
-    while (current != NULL) {
-        if (current->pagenum == page) {
-            // 如果页面存在,将其移到链表头部（表示最近使用）
-            if (prev != NULL) {
-                prev->next = current->next; // 断开当前节点
-                current->next = lru->head;   // 将当前节点的下一个指针指向原头节点
-                lru->head = current;          // 更新头节点为当前节点
-            }
-            return; // 页面已存在,直接返回
-        }
-        prev = current; // 更新前一个节点
-        current = current->next; // 移动到下一个节点
-    }
-    
-    // 页面不存在,需要添加新页面
-    struct p_str *new_page = (struct p_str*)malloc(sizeof(struct p_str));
-    new_page->pagenum = page; // 设置页面编号
-    new_page->count = 0; // 初始化计数
-    new_page->next = lru->head; // 新页面指向当前头节点
-    lru->head = new_page;
-    lru->size++;
-    
-    // 如果超出内存限制, 删除最后一个节点(最久未使用的页面)
-    if (lru->size > lru->max_pages) {
-        current = lru->head;
-        prev = NULL;
-        // 找到链表的最后一个节点
-        while (current->next != NULL) {
-            prev = current; // 更新前一个节点
-            current = current->next; // 移动到下一个节点
+    int node = lru->index[page];
+    if (node != -1) {
+        // 如果页面存在,将其移到链表头部（表示最近使用）
+        if (node != lru->head) {
+            LRU_unlink(lru, node);
+            LRU_pushFront(lru, node);
         }
-        // 从链表中删除最后一个节点
-        prev->next = NULL;
-        free(current);
-        lru->size--; 
+        return; // 页面已存在,直接返回
     }
+    // 页面不存在,添加新页面, 超出内存限制时替换最久未使用的页面
+    LRU_addPage(lru, page);
 }
 
-// LRU算法的模拟
-int LRU_simulate(int memory_pages) {
+// LRU算法的模拟, pages 为 OUTER_MEMORY_SIZE 次访问的页号
+int LRU_simulate(const int pages[], int memory_pages) {
     struct LRU lru;
-    LRU_init(&lru); // 初始化 LRU 结构
-    lru.max_pages = memory_pages;  // 设置最大页面数限制
+    LRU_init(&lru, memory_pages); // 初始化 LRU 结构, 设置最大页面数限制
     int hits = 0; // 记录命中次数
     int total = 0; // 记录总访问次数
     
     // 模拟页面访问过程
     int i;
     for (i = 0; i < OUTER_MEMORY_SIZE; i++) {
-        int instruction = generateRandomInstruction(); // 生成随机指令
         total++; // 增加总访问次数
-        int page = instructions[instruction]; // 获取访问的页面
+        int page = pages[i]; // 获取访问的页面
         
         //        // 检查页面是否在内存中
         if (LRU_isPageInMemory(&lru, page)) {
@@ -142,14 +179,7 @@ int LRU_simulate(int memory_pages) {
         // 更新页面的引用状态
         LRU_reference(&lru, page);
     }
-    
-    // 清理内存,释放所有页面节点
-    struct p_str *current = lru.head;
-    while (current != NULL) {
-        struct p_str *temp = current; // 保存当前节点
-        current = current->next; // 移动到下一个节点
-        free(temp); // 释放当前节点的内存
-    }
+    LRU_free(&lru);
     
     return hits; // 返回命中次数
 }
@@ -180,8 +210,8 @@ void Clock_addPage(struct Clock *clock, int page) {
     clock->size++;
 }
 
-// Clock算法的模拟
-int Clock_simulate(int memory_pages) {
+// Clock算法的模拟, pages 为 OUTER_MEMORY_SIZE 次访问的页号
+int Clock_simulate(const int pages[], int memory_pages) {
     struct Clock clock;
     // 初始化
     Clock_init(&clock);
@@ -191,10 +221,8 @@ int Clock_simulate(int memory_pages) {
     // 模拟访问页面的过程
     int i;
     for (i = 0; i < OUTER_MEMORY_SIZE; i++) {
-        // 生成随机的指令以访问页面
-        int instruction = generateRandomInstruction();
         total++;
-        int page = instructions[instruction]; // 获取要访问的页面
+        int page = pages[i]; // 获取要访问的页面
         bool pageHit = false; // 标记页面是否命中
 
         // 检查页面是否在Clock中
@@ -236,20 +264,691 @@ int Clock_simulate(int memory_pages) {
     return hits;
 }
 
-int main() {
+// ---------------- 轨迹回放 ----------------
+// 轨迹文件是连续存放的 64 位地址(本机字节序), 用 mmap 映射后顺序读取, 不读入内存,
+// 读过的部分定期交还内核. 页大小必须是 2 的幂, 页号 = 地址 >> 页内偏移位数.
+// 页号稀疏, 页号到页框用开放定址的散列表查找, 容量不小于页框数的 2 倍.
+// LRU 和 Clock 的规则与上面的模拟相同, 同一个页连续访问时状态不变, 直接算作命中
+
+#define TRACE_RELEASE_BYTES (64 << 20)  // 每读过这么多就把读过的页交还内核
+#define TRACE_MAX_FRAMES (1 << 24)  // -f 允许的最大页框数
+
+// 散列表的槽, frame 为 -1 表示空
+struct PageSlot {
+    uint64_t page;
+    int frame;
+};
+
+struct PageMap {
+    struct PageSlot *slots;
+    uint64_t mask;
+    int shift;  // 64 - 容量的位数
+};
+
+// LRU 的页框, 按使用先后串成双向链表
+struct FrameNode {
+    uint64_t page;
+    int prev;
+    int next;
+};
+
+// 映射好的轨迹文件
+struct Trace {
+    const uint64_t *addresses;
+    size_t count;
+    size_t size;
+};
+
+// 分配失败时报错退出, 轨迹回放中的表都靠它分配
+void *checkedAlloc(void *old, size_t size) {
+    void *p = realloc(old, size);
+    if (p == NULL) {
+        fprintf(stderr, "内存分配失败: %zu 字节\n", size);
+        exit(1);
+    }
+    return p;
+}
+
+void PageMap_init(struct PageMap *map, int frames) {
+    int bits = 4;
+    while ((1ULL << bits) < 2ULL * frames) {
+        bits++;
+    }
+    map->slots = checkedAlloc(NULL, sizeof(struct PageSlot) << bits);
+    map->mask = (1ULL << bits) - 1;
+    map->shift = 64 - bits;
+    uint64_t i;
+    for (i = 0; i <= map->mask; i++) {
+        map->slots[i].frame = -1;
+    }
+}
+
+uint64_t PageMap_home(const struct PageMap *map, uint64_t page) {
+    return (page * 0x9E3779B97F4A7C15ULL) >> map->shift;
+}
+
+// 返回页所在的页框, 不在内存中时返回 -1
+int PageMap_find(const struct PageMap *map, uint64_t page) {
+    uint64_t i = PageMap_home(map, page);
+    while (map->slots[i].frame != -1) {
+        if (map->slots[i].page == page) {
+            return map->slots[i].frame;
+        }
+        i = (i + 1) & map->mask;
+    }
+    return -1;
+}
+
+void PageMap_insert(struct PageMap *map, uint64_t page, int frame) {
+    uint64_t i = PageMap_home(map, page);
+    while (map->slots[i].frame != -1) {
+        i = (i + 1) & map->mask;
+    }
+    map->slots[i].page = page;
+    map->slots[i].frame = frame;
+}
+
+// 换成能放下 frames 个页的容量, 重新插入所有元素
+void PageMap_resize(struct PageMap *map, int frames) {
+    struct PageMap old = *map;
+    PageMap_init(map, frames);
+    uint64_t i;
+    for (i = 0; i <= old.mask; i++) {
+        if (old.slots[i].frame != -1) {
+            PageMap_insert(map, old.slots[i].page, old.slots[i].frame);
+        }
+    }
+    free(old.slots);
+}
+
+// 删除页, 把后面探测链上的元素前移填补空位, 不留删除标记
+void PageMap_erase(struct PageMap *map, uint64_t page) {
+    uint64_t i = PageMap_home(map, page);
+    while (map->slots[i].page != page) {
+        i = (i + 1) & map->mask;
+    }
+    uint64_t j = i;
+    while (true) {
+        j = (j + 1) & map->mask;
+        if (map->slots[j].frame == -1) {
+            break;
+        }
+        // 槽 j 的元素本来的位置不在 (i, j] 之间时, 才能移到 i
+        uint64_t home = PageMap_home(map, map->slots[j].page);
+        if (((j - home) & map->mask) >= ((j - i) & map->mask)) {
+            map->slots[i] = map->slots[j];
+            i = j;
+        }
+    }
+    map->slots[i].frame = -1;
+}
+
+// 读过 done 个地址后, 把此前还没交还的整页交还内核, 返回下一次交还时的地址下标
+size_t Trace_release(const struct Trace *trace, size_t done, size_t *released) {
+    size_t end = done * sizeof(uint64_t) & ~(size_t)(sysconf(_SC_PAGESIZE) - 1);
+    madvise((char *)trace->addresses + *released, end - *released, MADV_DONTNEED);
+    *released = end;
+    return done + TRACE_RELEASE_BYTES / sizeof(uint64_t);
+}
+
+// 用 LRU 回放轨迹, 返回命中次数
+uint64_t Trace_LRU(const struct Trace *trace, int page_shift, int frames) {
+    struct PageMap map;
+    PageMap_init(&map, frames);
+    struct FrameNode *nodes = checkedAlloc(NULL, sizeof(struct FrameNode) * frames);
+    int head = -1, tail = -1, size = 0;
+    uint64_t hits = 0;
+    uint64_t last_page = 0;
+    bool has_last = false;
+    size_t released = 0;
+    size_t release_at = TRACE_RELEASE_BYTES / sizeof(uint64_t);
+    size_t i;
+    for (i = 0; i < trace->count; i++) {
+        uint64_t page = trace->addresses[i] >> page_shift;
+        if (page == last_page && has_last) {
+            hits++;
+            continue;
+        }
+        last_page = page;
+        has_last = true;
+        if (i >= release_at) {
+            release_at = Trace_release(trace, i, &released);
+        }
+
+        int node = PageMap_find(&map, page);
+        if (node != -1) {
+            hits++;
+            if (node == head) {
+                continue;
+            }
+            // 摘下后放到头部
+            nodes[nodes[node].prev].next = nodes[node].next;
+            if (nodes[node].next != -1) {
+                nodes[nodes[node].next].prev = nodes[node].prev;
+            } else {
+                tail = nodes[node].prev;
+            }
+        } else if (size < frames) {
+            node = size++;
+            nodes[node].page = page;
+            PageMap_insert(&map, page, node);
+            if (tail == -1) {
+                tail = node;
+            }
+        } else {
+            // 替换最久未使用的页面
+            node = tail;
+            PageMap_erase(&map, nodes[node].page);
+            nodes[node].page = page;
+            PageMap_insert(&map, page, node);
+            if (node == head) {
+                continue;  // 只有一个页框
+            }
+            tail = nodes[node].prev;
+            nodes[tail].next = -1;
+        }
+        nodes[node].prev = -1;
+        nodes[node].next = head;
+        if (head != -1) {
+            nodes[head].prev = node;
+        }
+        head = node;
+    }
+    free(nodes);
+    free(map.slots);
+    return hits;
+}
+
+// 用 Clock 回放轨迹, 返回命中次数
+uint64_t Trace_Clock(const struct Trace *trace, int page_shift, int frames) {
+    struct PageMap map;
+    PageMap_init(&map, frames);
+    uint64_t *pages = checkedAlloc(NULL, sizeof(uint64_t) * frames);
+    unsigned char *use_bits = checkedAlloc(NULL, frames);
+    int pointer = 0, size = 0;
+    uint64_t hits = 0;
+    uint64_t last_page = 0;
+    bool has_last = false;
+    size_t released = 0;
+    size_t release_at = TRACE_RELEASE_BYTES / sizeof(uint64_t);
+    size_t i;
+    for (i = 0; i < trace->count; i++) {
+        uint64_t page = trace->addresses[i] >> page_shift;
+        if (page == last_page && has_last) {
+            hits++;
+            continue;
+        }
+        last_page = page;
+        has_last = true;
+        if (i >= release_at) {
+            release_at = Trace_release(trace, i, &released);
+        }
+
+        int frame = PageMap_find(&map, page);
+        if (frame != -1) {
+            use_bits[frame] = 1;
+            hits++;
+        } else if (size < frames) {
+            pages[size] = page;
+            use_bits[size] = 1;
+            PageMap_insert(&map, page, size);
+            size++;
+        } else {
+            // 与 Clock_simulate 相同: 使用位为 1 的清零后前进, 替换后指针不动
+            while (use_bits[pointer] != 0) {
+                use_bits[pointer] = 0;
+                pointer = pointer + 1 == size ? 0 : pointer + 1;
+            }
+            PageMap_erase(&map, pages[pointer]);
+            pages[pointer] = page;
+            use_bits[pointer] = 1;
+            PageMap_insert(&map, page, pointer);
+        }
+    }
+    free(pages);
+    free(use_bits);
+    free(map.slots);
+    return hits;
+}
+
+// 映射轨迹文件, 失败时返回 false
+bool Trace_open(struct Trace *trace, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror(path);
+        close(fd);
+        return false;
+    }
+    trace->size = st.st_size;
+    trace->count = trace->size / sizeof(uint64_t);
+    trace->addresses = NULL;
+    if (trace->size % sizeof(uint64_t) != 0) {
+        fprintf(stderr, "%s: 长度不是 8 的倍数\n", path);
+        close(fd);
+        return false;
+    }
+    if (trace->size > 0) {
+        trace->addresses = mmap(NULL, trace->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (trace->addresses == MAP_FAILED) {
+            perror(path);
+            close(fd);
+            return false;
+        }
+        madvise((void *)trace->addresses, trace->size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+    return true;
+}
+
+void Trace_close(struct Trace *trace) {
+    if (trace->size > 0) {
+        munmap((void *)trace->addresses, trace->size);
+    }
+}
+
+double nowSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// ---------------- 栈距离 ----------------
+// Mattson 栈距离: LRU 有包含性, m 个页框时内存中的页总是 m+1 个页框时的子集,
+// 所以一次访问在 m 个页框下命中, 当且仅当它的栈距离(上次访问这个页以来访问过的不同页数)小于 m.
+// 一遍扫描得到栈距离的直方图, 就有了所有内存大小下的命中次数.
+// 每个页只在最近一次访问的时刻留一个标记, 上次访问之后的标记数就是栈距离, 用树状数组求,
+// 每次访问 O(log n). 时刻只在换页时前进, 用完容量时把标记按先后重新编号压紧
+
+#define STACK_MIN_CAPACITY (1 << 16)
+
+struct StackDistance {
+    struct PageMap map;   // 页号 -> 页的编号
+    int *last;            // 页的编号 -> 最近一次访问的时刻
+    uint64_t *histogram;  // histogram[d] 为栈距离为 d 的访问次数
+    int pages;            // 不同页数, 也是标记数
+    int page_capacity;
+    int *owner;           // 时刻 -> 这时访问的页的编号, -1 表示这个页后来又被访问过
+    int *tree;            // 标记的树状数组, 下标从 1 开始
+    int capacity;         // 时刻的容量
+    int now;              // 下一个时刻
+    uint64_t total;
+    uint64_t cold;        // 第一次访问, 任何大小都缺页
+    uint64_t last_page;
+};
+
+void StackDistance_init(struct StackDistance *sd) {
+    PageMap_init(&sd->map, STACK_MIN_CAPACITY);
+    sd->page_capacity = STACK_MIN_CAPACITY;
+    sd->last = checkedAlloc(NULL, sizeof(int) * sd->page_capacity);
+    sd->histogram = checkedAlloc(NULL, sizeof(uint64_t) * sd->page_capacity);
+    memset(sd->histogram, 0, sizeof(uint64_t) * sd->page_capacity);
+    sd->pages = 0;
+    sd->capacity = STACK_MIN_CAPACITY;
+    sd->owner = checkedAlloc(NULL, sizeof(int) * sd->capacity);
+    sd->tree = checkedAlloc(NULL, sizeof(int) * (sd->capacity + 1));
+    memset(sd->tree, 0, sizeof(int) * (sd->capacity + 1));
+    sd->now = 0;
+    sd->total = 0;
+    sd->cold = 0;
+    sd->last_page = 0;
+}
+
+void StackDistance_free(struct StackDistance *sd) {
+    free(sd->map.slots);
+    free(sd->last);
+    free(sd->histogram);
+    free(sd->owner);
+    free(sd->tree);
+}
+
+void StackDistance_add(struct StackDistance *sd, int time, int delta) {
+    int i;
+    for (i = time + 1; i <= sd->capacity; i += i & -i) {
+        sd->tree[i] += delta;
+    }
+}
+
+// 时刻不晚于 time 的标记数
+int StackDistance_prefix(const struct StackDistance *sd, int time) {
+    int sum = 0;
+    int i;
+    for (i = time + 1; i > 0; i -= i & -i) {
+        sum += sd->tree[i];
+    }
+    return sum;
+}
+
+// 把留有标记的时刻按先后重新编号为 0, 1, ..., 需要时把容量加倍, 再线性重建树状数组
+void StackDistance_compact(struct StackDistance *sd) {
+    int k = 0;
+    int i;
+    for (i = 0; i < sd->now; i++) {
+        if (sd->owner[i] != -1) {
+            sd->owner[k] = sd->owner[i];
+            sd->last[sd->owner[k]] = k;
+            k++;
+        }
+    }
+    sd->now = k;
+    if (k * 2 > sd->capacity) {
+        sd->capacity *= 2;
+        sd->owner = checkedAlloc(sd->owner, sizeof(int) * sd->capacity);
+        free(sd->tree);
+        sd->tree = checkedAlloc(NULL, sizeof(int) * (sd->capacity + 1));
+    }
+    sd->tree[0] = 0;
+    for (i = 1; i <= sd->capacity; i++) {
+        sd->tree[i] = i <= k;
+    }
+    for (i = 1; i <= sd->capacity; i++) {
+        int parent = i + (i & -i);
+        if (parent <= sd->capacity) {
+            sd->tree[parent] += sd->tree[i];
+        }
+    }
+}
+
+void StackDistance_access(struct StackDistance *sd, uint64_t page) {
+    sd->total++;
+    if (page == sd->last_page && sd->total > 1) {
+        sd->histogram[0]++;  // 连续访问同一页, 栈距离为 0, 标记不用动
+        return;
+    }
+    sd->last_page = page;
+    if (sd->now == sd->capacity) {
+        StackDistance_compact(sd);
+    }
+    int id = PageMap_find(&sd->map, page);
+    if (id == -1) {
+        sd->cold++;
+        if (sd->pages == sd->page_capacity) {
+            sd->last = checkedAlloc(sd->last, sizeof(int) * sd->page_capacity * 2);
+            sd->histogram = checkedAlloc(sd->histogram, sizeof(uint64_t) * sd->page_capacity * 2);
+            memset(sd->histogram + sd->page_capacity, 0, sizeof(uint64_t) * sd->page_capacity);
+            sd->page_capacity *= 2;
+            PageMap_resize(&sd->map, sd->page_capacity);
+        }
+        id = sd->pages++;
+        PageMap_insert(&sd->map, page, id);
+    } else {
+        int time = sd->last[id];
+        sd->histogram[sd->pages - StackDistance_prefix(sd, time)]++;
+        StackDistance_add(sd, time, -1);
+        sd->owner[time] = -1;
+    }
+    sd->last[id] = sd->now;
+    sd->owner[sd->now] = id;
+    StackDistance_add(sd, sd->now, 1);
+    sd->now++;
+}
+
+// LRU 在 frames 个页框下的命中次数
+uint64_t StackDistance_hits(const struct StackDistance *sd, int frames) {
+    uint64_t hits = 0;
+    int d;
+    for (d = 0; d < frames && d < sd->pages; d++) {
+        hits += sd->histogram[d];
+    }
+    return hits;
+}
+
+// 一遍扫描轨迹, 输出各页框数下 LRU 的命中率; curve_path 不为 NULL 时把 1 到不同页数的整条曲线写成 CSV
+int stackDistanceTrace(const struct Trace *trace, int page_shift, const int frame_counts[], int count,
+                       const char *curve_path) {
+    struct StackDistance sd;
+    StackDistance_init(&sd);
+    double start = nowSeconds();
+    size_t released = 0;
+    size_t release_at = TRACE_RELEASE_BYTES / sizeof(uint64_t);
+    size_t i;
+    for (i = 0; i < trace->count; i++) {
+        StackDistance_access(&sd, trace->addresses[i] >> page_shift);
+        if (i >= release_at) {
+            release_at = Trace_release(trace, i, &released);
+        }
+    }
+    double seconds = nowSeconds() - start;
+    printf("栈距离: %d 个不同的页, 用时 %.3f 秒, 每秒 %.1f M 次访问\n", sd.pages, seconds,
+           trace->count / (seconds > 0 ? seconds : 1e-9) / 1e6);
+    for (i = 0; i < (size_t)count; i++) {
+        uint64_t hits = StackDistance_hits(&sd, frame_counts[i]);
+        printf("页框 %d LRU算法 命中率: %.4f%%, 缺页 %llu 次\n", frame_counts[i],
+               trace->count > 0 ? (double)hits * 100 / trace->count : 0.0, (unsigned long long)(trace->count - hits));
+    }
+    if (curve_path != NULL) {
+        FILE *file = fopen(curve_path, "w");
+        if (file == NULL) {
+            perror(curve_path);
+            StackDistance_free(&sd);
+            return 1;
+        }
+        fprintf(file, "frames,hits,miss_ratio\n");
+        uint64_t hits = 0;
+        int d;
+        for (d = 0; d < sd.pages; d++) {
+            hits += sd.histogram[d];
+            fprintf(file, "%d,%llu,%.6f\n", d + 1, (unsigned long long)hits,
+                    1 - (double)hits / (trace->count > 0 ? trace->count : 1));
+        }
+        fclose(file);
+    }
+    StackDistance_free(&sd);
+    return 0;
+}
+
+// 对每个页框数分别用 LRU 和/或 Clock 回放轨迹; stack 为 true 时改为一遍栈距离分析
+int replayTrace(const char *path, uint64_t page_size, const int frame_counts[], int count, bool lru, bool clock,
+                bool stack, const char *curve_path) {
+    struct Trace trace;
+    if (!Trace_open(&trace, path)) {
+        return 1;
+    }
+    int page_shift = 0;
+    while ((1ULL << page_shift) < page_size) {
+        page_shift++;
+    }
+    printf("%zu 次访问, 页大小 %llu\n", trace.count, (unsigned long long)page_size);
+    if (stack) {
+        int result = stackDistanceTrace(&trace, page_shift, frame_counts, count, curve_path);
+        Trace_close(&trace);
+        return result;
+    }
+    int i;
+    for (i = 0; i < count; i++) {
+        int algorithm;
+        for (algorithm = 0; algorithm < 2; algorithm++) {
+            if (!(algorithm == 0 ? lru : clock)) {
+                continue;
+            }
+            double start = nowSeconds();
+            uint64_t hits = algorithm == 0 ? Trace_LRU(&trace, page_shift, frame_counts[i])
+                                           : Trace_Clock(&trace, page_shift, frame_counts[i]);
+            double seconds = nowSeconds() - start;
+            printf("页框 %d %s算法 命中率: %.4f%%, 缺页 %llu 次, 用时 %.3f 秒, 每秒 %.1f M 次访问\n", frame_counts[i],
+                   algorithm == 0 ? "LRU" : "Clock", trace.count > 0 ? (double)hits * 100 / trace.count : 0.0,
+                   (unsigned long long)(trace.count - hits), seconds,
+                   trace.count / (seconds > 0 ? seconds : 1e-9) / 1e6);
+        }
+    }
+    Trace_close(&trace);
+    return 0;
+}
+
+// 生成 n 个地址的轨迹: 多数访问顺序前进 8 字节, 每次以 1/16 的概率跳到
+// working_set 个页中随机一页的随机位置, 地址分布在 64 位空间的高处
+int writeTrace(const char *path, uint64_t n, unsigned seed, uint64_t working_set, uint64_t page_size) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        perror(path);
+        return 1;
+    }
+    uint64_t buffer[4096];
+    uint64_t state = seed * 0x9E3779B97F4A7C15ULL + 1;
+    uint64_t base = 0x7F0000000000ULL;
+    uint64_t address = base;
+    uint64_t i;
+    int length = 0;
+    for (i = 0; i < n; i++) {
+        // xorshift64*
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        uint64_t r = state * 0x2545F4914F6CDD1DULL;
+        if ((r & 15) == 0) {
+            address = base + (r >> 32) % working_set * page_size + (r >> 4 & (page_size - 1) & ~7ULL);
+        } else {
+            address += 8;
+        }
+        buffer[length++] = address;
+        if (length == 4096) {
+            fwrite(buffer, sizeof(uint64_t), length, file);
+            length = 0;
+        }
+    }
+    fwrite(buffer, sizeof(uint64_t), length, file);
+    if (fclose(file) != 0) {
+        perror(path);
+        return 1;
+    }
+    return 0;
+}
+
+// 解析逗号分隔的页框数列表, 每个在 1 到 TRACE_MAX_FRAMES 之间, 最多 max 个
+bool parseList(const char *s, int list[], int max, int *count) {
+    *count = 0;
+    while (*s != '\0') {
+        char *end;
+        long v = strtol(s, &end, 10);
+        if (end == s || v <= 0 || v > TRACE_MAX_FRAMES || *count == max || (*end != ',' && *end != '\0')) {
+            return false;
+        }
+        list[(*count)++] = (int)v;
+        s = *end == ',' ? end + 1 : end;
+    }
+    return *count > 0;
+}
+
+// trace 轨迹文件 [-p 页大小] [-f 页框数,...] [-a lru|clock|both|stack] [-o 曲线文件]
+int traceMain(int argc, char *argv[]) {
+    uint64_t page_size = 4096;
+    int frame_counts[64] = {64, 256, 1024, 4096};
+    int count = 4;
+    const char *algorithm = "both";
+    const char *curve_path = NULL;
+    bool ok = argc >= 3;
+    int i;
+    for (i = 3; ok && i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-p") == 0) {
+            page_size = strtoull(argv[i + 1], NULL, 10);
+            ok = page_size > 0 && (page_size & (page_size - 1)) == 0;
+        } else if (strcmp(argv[i], "-f") == 0) {
+            ok = parseList(argv[i + 1], frame_counts, 64, &count);
+        } else if (strcmp(argv[i], "-a") == 0) {
+            algorithm = argv[i + 1];
+            ok = strcmp(algorithm, "lru") == 0 || strcmp(algorithm, "clock") == 0 || strcmp(algorithm, "both") == 0 ||
+                 strcmp(algorithm, "stack") == 0;
+        } else if (strcmp(argv[i], "-o") == 0) {
+            curve_path = argv[i + 1];
+        } else {
+            break;
+        }
+    }
+    bool stack = strcmp(algorithm, "stack") == 0;
+    if (!ok || i != argc || (curve_path != NULL && !stack)) {
+        printf("用法: %s trace 轨迹文件 [-p 页大小(2 的幂)] [-f 页框数,页框数,...] [-a lru|clock|both|stack]\n"
+               "       [-o 缺页率曲线文件, 只用于 stack]\n"
+               "页框数在 1 到 %d 之间\n", argv[0], TRACE_MAX_FRAMES);
+        return 1;
+    }
+    return replayTrace(argv[2], page_size, frame_counts, count, strcmp(algorithm, "clock") != 0,
+                       strcmp(algorithm, "lru") != 0, stack, curve_path);
+}
+
+// --check [轮数]: 用多串随机访问核对栈距离得到的 LRU 命中次数与逐页模拟的 LRU_simulate 是否一致
+int checkMain(int argc, char *argv[]) {
+    int rounds = argc > 2 ? atoi(argv[2]) : 1000;
+    if (rounds <= 0) {
+        printf("用法: %s --check [轮数]\n", argv[0]);
+        return 1;
+    }
+    initializeInstructions();
+    int round;
+    for (round = 0; round < rounds; round++) {
+        srand(round);
+        int pages[OUTER_MEMORY_SIZE];
+        generateReferences(pages);
+        struct StackDistance sd;
+        StackDistance_init(&sd);
+        int i;
+        for (i = 0; i < OUTER_MEMORY_SIZE; i++) {
+            StackDistance_access(&sd, pages[i]);
+        }
+        int memory_pages;
+        for (memory_pages = 1; memory_pages <= MAX_MEMORY; memory_pages++) {
+            int expected = LRU_simulate(pages, memory_pages);
+            int hits = (int)StackDistance_hits(&sd, memory_pages);
+            if (hits != expected) {
+                printf("种子 %d, 内存 %d pages: 栈距离 %d 次命中, LRU_simulate %d 次命中\n", round, memory_pages,
+                       hits, expected);
+                StackDistance_free(&sd);
+                return 1;
+            }
+        }
+        StackDistance_free(&sd);
+    }
+    printf("%d 串访问, 内存 1 到 %d pages, 栈距离与 LRU_simulate 的命中次数全部一致\n", rounds, MAX_MEMORY);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1 && strcmp(argv[1], "--check") == 0) {
+        return checkMain(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "trace") == 0) {
+        return traceMain(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "gen-trace") == 0) {
+        if (argc < 4) {
+            printf("用法: %s gen-trace 轨迹文件 访问次数 [种子] [工作集页数] [页大小]\n", argv[0]);
+            return 1;
+        }
+        uint64_t page_size = argc > 6 ? strtoull(argv[6], NULL, 10) : 4096;
+        uint64_t working_set = argc > 5 ? strtoull(argv[5], NULL, 10) : 4096;
+        if (page_size < 8 || (page_size & (page_size - 1)) != 0 || working_set == 0) {
+            printf("页大小必须是不小于 8 的 2 的幂, 工作集页数必须为正数\n");
+            return 1;
+        }
+        return writeTrace(argv[2], strtoull(argv[3], NULL, 10), argc > 4 ? (unsigned)atoi(argv[4]) : 1,
+                          working_set, page_size);
+    }
     srand(time(NULL));
     initializeInstructions();
+    // 所有内存大小都用同一串访问; LRU 一遍栈距离分析就得到所有大小的命中次数
+    int pages[OUTER_MEMORY_SIZE];
+    generateReferences(pages);
+    struct StackDistance sd;
+    StackDistance_init(&sd);
+    int i;
+    for (i = 0; i < OUTER_MEMORY_SIZE; i++) {
+        StackDistance_access(&sd, pages[i]);
+    }
     int memory_pages;
     for (memory_pages = 4; memory_pages <= 40; memory_pages++) {
         printf("\n内存大小: %d pages\n", memory_pages);
         
-        int lru_hits = LRU_simulate(memory_pages);
+        int lru_hits = (int)StackDistance_hits(&sd, memory_pages);
         printf("LRU算法 ");
         printHitRate(lru_hits, OUTER_MEMORY_SIZE);
         
-        int clock_hits = Clock_simulate(memory_pages);
+        int clock_hits = Clock_simulate(pages, memory_pages);
         printf("Clock算法 ");
         printHitRate(clock_hits, OUTER_MEMORY_SIZE);
     }
+    StackDistance_free(&sd);
     return 0;
 }
\ No newline at end of file